@@ -0,0 +1,128 @@
+// Benchmark runner, a program of its own: built from the sources of this
+// directory and every source of search-server except main.cpp.
+//
+//   benchmark [--out results.json] [--baseline baseline.json]
+//             [--tolerance 0.1] [--documents 1000,10000] [--threads 1,4]
+//             [--queries 1000] [--repetitions 3]
+//   benchmark --micro
+//
+// Writes the results as JSON to --out, or to stdout. With --baseline, also
+// compares them against a saved run and exits with 1 when any benchmark got
+// slower by more than the tolerance. --micro runs the side-by-side
+// micro-benchmarks instead and prints their timings.
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../benchmark_suite.h"
+#include "micro_benchmarks.h"
+
+using namespace std;
+
+namespace {
+
+vector<int> ParseIntList(const string &text) {
+  vector<int> values;
+  size_t begin = 0;
+  while (begin <= text.size()) {
+    const size_t end = min(text.find(',', begin), text.size());
+    values.push_back(stoi(text.substr(begin, end - begin)));
+    begin = end + 1;
+  }
+  return values;
+}
+
+void PrintUsage() {
+  cerr << "Usage: benchmark [--out FILE] [--baseline FILE] [--tolerance X]"s
+          " [--documents N,...] [--threads N,...] [--queries N]"s
+          " [--repetitions N]"s
+       << endl
+       << "       benchmark --micro"s << endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc == 2 && argv[1] == "--micro"sv) {
+    RunMicroBenchmarks();
+    return 0;
+  }
+
+  BenchmarkConfig config;
+  string out_path;
+  string baseline_path;
+  double tolerance = 0.1;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const string_view option = argv[i];
+      if (i + 1 == argc) {
+        throw invalid_argument("Missing value of "s + string(option));
+      }
+      const string value = argv[++i];
+      if (option == "--out"sv) {
+        out_path = value;
+      } else if (option == "--baseline"sv) {
+        baseline_path = value;
+      } else if (option == "--tolerance"sv) {
+        tolerance = stod(value);
+      } else if (option == "--documents"sv) {
+        config.document_counts = ParseIntList(value);
+      } else if (option == "--threads"sv) {
+        config.thread_counts = ParseIntList(value);
+      } else if (option == "--queries"sv) {
+        config.query_count = stoi(value);
+      } else if (option == "--repetitions"sv) {
+        config.repetitions = stoi(value);
+      } else {
+        throw invalid_argument("Unknown option "s + string(option));
+      }
+    }
+  } catch (const exception &e) {
+    cerr << e.what() << endl;
+    PrintUsage();
+    return 2;
+  }
+
+  try {
+    vector<BenchmarkResult> baseline;
+    if (!baseline_path.empty()) {
+      ifstream input(baseline_path);
+      if (!input) {
+        throw runtime_error("Cannot open "s + baseline_path);
+      }
+      baseline = ReadBenchmarkJson(input);
+    }
+
+    const vector<BenchmarkResult> results = RunBenchmarks(config);
+    PrintBenchmarkResults(cerr, results);
+    if (out_path.empty()) {
+      WriteBenchmarkJson(cout, results);
+    } else {
+      ofstream output(out_path);
+      WriteBenchmarkJson(output, results);
+      if (!output) {
+        throw runtime_error("Cannot write "s + out_path);
+      }
+    }
+
+    if (baseline_path.empty()) {
+      return 0;
+    }
+    const auto comparisons = CompareBenchmarks(baseline, results, tolerance);
+    PrintBenchmarkComparison(cerr, comparisons);
+    for (const auto &comparison : comparisons) {
+      if (comparison.regression) {
+        return 1;
+      }
+    }
+    return 0;
+  } catch (const exception &e) {
+    cerr << e.what() << endl;
+    return 2;
+  }
+}
@@ -0,0 +1,503 @@
+#include "micro_benchmarks.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <execution>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <set>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "../benchmark_suite.h"
+#include "../test_example_functions.h"
+
+using namespace std;
+
+namespace {
+
+// The corpus of most benchmarks here: document_count documents of up to 70
+// words over a dictionary of 1'000 words, and query_count queries of up to
+// words_per_query words.
+BenchmarkCorpus MakeCorpus(int query_count = 100, int words_per_query = 70,
+                           int document_count = 10'000) {
+  BenchmarkConfig config;
+  config.dictionary_size = 1'000;
+  config.query_count = query_count;
+  config.words_per_query = words_per_query;
+  return MakeBenchmarkCorpus(config, document_count);
+}
+
+vector<NewDocument> MakeBatch(const BenchmarkCorpus &corpus) {
+  vector<NewDocument> batch;
+  for (size_t i = 0; i < corpus.documents.size(); ++i) {
+    batch.push_back({static_cast<int>(i), corpus.documents[i],
+                     DocumentStatus::ACTUAL, {1, 2, 3}});
+  }
+  return batch;
+}
+
+void BenchmarkFind() {
+  const BenchmarkCorpus corpus = MakeCorpus();
+  const SearchServer search_server = MakeBenchmarkServer(corpus);
+  const auto &queries = corpus.queries;
+  {
+    LOG_DURATION("|");
+    TEST_POLICY(seq);
+  }
+  {
+    LOG_DURATION("||");
+    TEST_POLICY(par);
+  }
+
+  // The same parallel queries issued by a growing number of client threads;
+  // with contention-free accumulation the wall time should keep falling
+  // until the cores are saturated.
+  const size_t max_thread_count = max(1u, thread::hardware_concurrency()) * 2;
+  for (size_t thread_count = 1; thread_count <= max_thread_count;
+       thread_count *= 2) {
+    vector<double> total_relevances(thread_count);
+    {
+      LOG_DURATION("|| x"s + to_string(thread_count));
+      vector<thread> threads;
+      for (size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t] {
+          for (size_t i = t; i < queries.size(); i += thread_count) {
+            for (const auto &document :
+                 search_server.FindTopDocuments(execution::par, queries[i])) {
+              total_relevances[t] += document.relevance;
+            }
+          }
+        });
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+    }
+    cout << accumulate(total_relevances.begin(), total_relevances.end(), 0.0)
+         << endl;
+  }
+}
+
+void BenchmarkPostingCompression() {
+  const BenchmarkCorpus corpus = MakeCorpus();
+
+  InvertedIndex index;
+  for (size_t i = 0; i < corpus.documents.size(); ++i) {
+    const auto words = SplitIntoWords(corpus.documents[i]);
+    map<string_view, double> word_freqs;
+    for (const auto word : words) {
+      word_freqs[word] += 1.0 / words.size();
+    }
+    for (const auto [word, term_freq] : word_freqs) {
+      index.AddPosting(word, i, term_freq);
+    }
+  }
+
+  vector<const InvertedIndex::PostingList *> plain;
+  vector<CompressedPostingList> compressed;
+  size_t posting_count = 0;
+  size_t plain_bytes = 0;
+  size_t compressed_bytes = 0;
+  for (const auto &word : corpus.dictionary) {
+    const auto *postings = index.FindPostings(word);
+    if (postings == nullptr) {
+      continue;
+    }
+    plain.push_back(postings);
+    compressed.emplace_back(*postings);
+    posting_count += postings->size();
+    plain_bytes += postings->capacity() * sizeof(Posting);
+    compressed_bytes += compressed.back().GetByteSize();
+  }
+  cout << "bytes per posting: plain "s << plain_bytes * 1.0 / posting_count
+       << ", compressed "s << compressed_bytes * 1.0 / posting_count << endl;
+
+  const int rounds = 50;
+  double plain_sum = 0;
+  {
+    LOG_DURATION("plain scan"s);
+    for (int round = 0; round < rounds; ++round) {
+      for (const auto *postings : plain) {
+        for (const auto [ordinal, term_freq] : *postings) {
+          plain_sum += ordinal * term_freq;
+        }
+      }
+    }
+  }
+  double compressed_sum = 0;
+  {
+    LOG_DURATION("compressed scan ("s + GetPostingDecoderName() + ")"s);
+    for (int round = 0; round < rounds; ++round) {
+      for (const auto &postings : compressed) {
+        postings.GetView().ForEach([&compressed_sum](int ordinal,
+                                                     double term_freq) {
+          compressed_sum += ordinal * term_freq;
+        });
+      }
+    }
+  }
+  ASSERT_EQUAL(plain_sum, compressed_sum);
+}
+
+void BenchmarkMaxScore() {
+  const BenchmarkCorpus corpus = MakeCorpus();
+  const SearchServer search_server = MakeBenchmarkServer(corpus);
+  const auto &queries = corpus.queries;
+  {
+    LOG_DURATION("exhaustive");
+    TEST_POLICY(seq);
+  }
+  {
+    LOG_DURATION("max score");
+    Test("max_score_retrieval", search_server, queries, max_score_retrieval);
+  }
+}
+
+void BenchmarkAddDocuments() {
+  const BenchmarkCorpus corpus = MakeCorpus();
+  const vector<NewDocument> batch = MakeBatch(corpus);
+
+  SearchServer one_by_one(corpus.stop_words);
+  {
+    LOG_DURATION("AddDocument loop"s);
+    for (const auto &document : batch) {
+      one_by_one.AddDocument(document.id, document.text, document.status,
+                             document.ratings);
+    }
+  }
+  SearchServer bulk(corpus.stop_words);
+  {
+    LOG_DURATION("AddDocuments"s);
+    bulk.AddDocuments(batch);
+  }
+  ASSERT_EQUAL(one_by_one.GetDocumentCount(), bulk.GetDocumentCount());
+}
+
+void BenchmarkRemoveDocuments() {
+  const BenchmarkCorpus corpus = MakeCorpus();
+  const vector<NewDocument> batch = MakeBatch(corpus);
+  vector<int> removed_ids;
+  for (int id = 0; id < static_cast<int>(batch.size()); id += 2) {
+    removed_ids.push_back(id);
+  }
+
+  SearchServer one_by_one(corpus.stop_words);
+  one_by_one.AddDocuments(batch);
+  {
+    LOG_DURATION("RemoveDocument(par) loop"s);
+    for (const int id : removed_ids) {
+      one_by_one.RemoveDocument(execution::par, id);
+    }
+  }
+  SearchServer bulk(corpus.stop_words);
+  bulk.AddDocuments(batch);
+  {
+    LOG_DURATION("RemoveDocuments"s);
+    bulk.RemoveDocuments(removed_ids);
+  }
+  ASSERT_EQUAL(one_by_one.GetDocumentCount(), bulk.GetDocumentCount());
+}
+
+void BenchmarkSnapshot() {
+  const BenchmarkCorpus corpus = MakeCorpus();
+  const SearchServer search_server = [&corpus] {
+    LOG_DURATION("index from text"s);
+    return MakeBenchmarkServer(corpus);
+  }();
+  stringstream snapshot;
+  search_server.SaveSnapshot(snapshot);
+  {
+    LOG_DURATION("index from snapshot"s);
+    const auto loaded = SearchServer::LoadSnapshot(snapshot);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), loaded.GetDocumentCount());
+  }
+  const string path = "snapshot_performance.idx"s;
+  MappedSearchServer::WriteIndex(search_server, path);
+  {
+    LOG_DURATION("index from mapped file"s);
+    const MappedSearchServer mapped(path);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), mapped.GetDocumentCount());
+  }
+  remove(path.c_str());
+}
+
+void BenchmarkMutationLog() {
+  const BenchmarkCorpus corpus = MakeCorpus();
+  const string log_path = "mutation_log_performance.log"s;
+  {
+    SearchServer search_server(corpus.stop_words);
+    LOG_DURATION("ingest without log"s);
+    AddBenchmarkDocuments(search_server, corpus);
+  }
+  remove(log_path.c_str());
+  {
+    SearchServer search_server(corpus.stop_words);
+    MutationLog log(log_path);
+    search_server.SetMutationLog(&log);
+    LOG_DURATION("ingest with group commit"s);
+    AddBenchmarkDocuments(search_server, corpus);
+    log.Sync();
+  }
+  remove(log_path.c_str());
+  {
+    SearchServer search_server(corpus.stop_words);
+    MutationLog log(log_path);
+    search_server.SetMutationLog(&log);
+    LOG_DURATION("ingest with fsync per document"s);
+    for (size_t i = 0; i < corpus.documents.size(); ++i) {
+      search_server.AddDocument(i, corpus.documents[i], DocumentStatus::ACTUAL,
+                                {1, 2, 3});
+      log.Sync();
+    }
+  }
+  remove(log_path.c_str());
+}
+
+void BenchmarkConcurrentSearchServer() {
+  const BenchmarkCorpus corpus = MakeCorpus(2'000, 7, 4'000);
+  const auto &texts = corpus.documents;
+  ConcurrentSearchServer search_server(corpus.stop_words);
+  for (size_t i = 0; i < texts.size() / 2; ++i) {
+    search_server.AddDocument(i, texts[i], DocumentStatus::ACTUAL, {1, 2, 3});
+  }
+
+  const auto run_queries = [&](const string &name) {
+    double total_relevance = 0;
+    LOG_DURATION(name);
+    for (const auto &query : corpus.queries) {
+      for (const auto &document : search_server.FindTopDocuments(query)) {
+        total_relevance += document.relevance;
+      }
+    }
+    return total_relevance;
+  };
+  run_queries("queries while idle"s);
+  thread writer([&] {
+    for (size_t i = texts.size() / 2; i < texts.size(); ++i) {
+      search_server.AddDocument(i, texts[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+  });
+  run_queries("queries during ingestion"s);
+  writer.join();
+}
+
+void BenchmarkTokenizer() {
+  const BenchmarkCorpus corpus = MakeCorpus();
+  size_t word_count = 0;
+  {
+    LOG_DURATION("split byte by byte"s);
+    size_t first_invalid;
+    for (const auto &document : corpus.documents) {
+      word_count += SplitIntoWordsByBytes(document, first_invalid).size();
+    }
+  }
+  {
+    LOG_DURATION("tokenize ("s + GetTokenizerName() + ")"s);
+    vector<string_view> words;
+    for (const auto &document : corpus.documents) {
+      words.clear();
+      TokenizeWords(document, words);
+      word_count -= words.size();
+    }
+  }
+  ASSERT_EQUAL(word_count, 0u);
+}
+
+void BenchmarkStopWords() {
+  const BenchmarkCorpus corpus = MakeCorpus();
+  const set<string, less<>> tree(corpus.dictionary.begin(),
+                                 corpus.dictionary.begin() + 150);
+  const StopWordSet hashed(tree);
+  vector<string_view> words;
+  for (const auto &document : corpus.documents) {
+    TokenizeWords(document, words);
+  }
+  size_t stop_word_count = 0;
+  {
+    LOG_DURATION("stop words in std::set"s);
+    for (const string_view word : words) {
+      stop_word_count += tree.count(word);
+    }
+  }
+  {
+    LOG_DURATION("stop words in StopWordSet"s);
+    for (const string_view word : words) {
+      stop_word_count -= hashed.Contains(word);
+    }
+  }
+  ASSERT_EQUAL(stop_word_count, 0u);
+}
+
+void BenchmarkCorpusLoader() {
+  const BenchmarkCorpus corpus = MakeCorpus();
+  const string path = "corpus_loader_performance.tsv"s;
+  {
+    ofstream output(path, ios::binary);
+    for (size_t i = 0; i < corpus.documents.size(); ++i) {
+      output << i << "\tACTUAL\t1 2 3\t"s << corpus.documents[i] << '\n';
+    }
+  }
+  SearchServer by_lines(corpus.stop_words);
+  {
+    LOG_DURATION("corpus by getline and AddDocument"s);
+    ifstream input(path, ios::binary);
+    string line;
+    while (getline(input, line)) {
+      istringstream fields(line);
+      int id;
+      string status, ratings, text;
+      fields >> id;
+      fields.ignore();
+      getline(fields, status, '\t');
+      getline(fields, ratings, '\t');
+      getline(fields, text);
+      istringstream rating_stream(ratings);
+      by_lines.AddDocument(id, text, DocumentStatus::ACTUAL,
+                           vector<int>(istream_iterator<int>(rating_stream),
+                                       istream_iterator<int>()));
+    }
+  }
+  SearchServer loaded(corpus.stop_words);
+  {
+    LOG_DURATION("corpus by LoadCorpus"s);
+    LoadCorpus(path, loaded);
+  }
+  ASSERT_EQUAL(by_lines.GetDocumentCount(), loaded.GetDocumentCount());
+  remove(path.c_str());
+}
+
+void BenchmarkLatencyRecording() {
+  const BenchmarkCorpus corpus = MakeCorpus(5'000, 3);
+  const SearchServer search_server = MakeBenchmarkServer(corpus);
+
+  size_t found = 0;
+  const auto search = [&] {
+    for (const auto &query : corpus.queries) {
+      found += search_server.FindTopDocuments(query).size();
+    }
+  };
+  {
+    LOG_DURATION("queries, latency recording off"s);
+    search();
+  }
+  SetLatencyRecording(true);
+  {
+    LOG_DURATION("queries, latency recording on"s);
+    search();
+  }
+  SetLatencyRecording(false);
+  ASSERT(found > 0);
+}
+
+void BenchmarkBatchQueries() {
+  const BenchmarkCorpus corpus = MakeCorpus();
+  const SearchServer search_server = MakeBenchmarkServer(corpus);
+
+  // A micro-batch drawn from a small pool of popular terms and queries.
+  mt19937 generator;
+  const vector<string> popular(corpus.dictionary.begin(),
+                               corpus.dictionary.begin() + 60);
+  const auto pool = GenerateQueries(generator, popular, 150, 8);
+  vector<string> queries;
+  uniform_int_distribution<size_t> pick(0, pool.size() - 1);
+  for (int i = 0; i < 400; ++i) {
+    queries.push_back(pool[pick(generator)]);
+  }
+
+  double total_relevance = 0;
+  {
+    LOG_DURATION("query by query"s);
+    vector<vector<Document>> results(queries.size());
+    transform(execution::par, queries.begin(), queries.end(), results.begin(),
+              [&search_server](const string &query) {
+                return search_server.FindTopDocuments(query);
+              });
+    for (const auto &documents : results) {
+      for (const auto &document : documents) {
+        total_relevance += document.relevance;
+      }
+    }
+  }
+  double batch_relevance = 0;
+  {
+    LOG_DURATION("batch"s);
+    for (const auto &documents : ProcessQueries(search_server, queries)) {
+      for (const auto &document : documents) {
+        batch_relevance += document.relevance;
+      }
+    }
+  }
+  ASSERT_EQUAL(total_relevance, batch_relevance);
+}
+
+template <typename Lock>
+void RunConcurrentMapContention(const string &lock_name, size_t key_count) {
+  const size_t max_thread_count = max(1u, thread::hardware_concurrency()) * 2;
+  for (size_t thread_count = 1; thread_count <= max_thread_count;
+       thread_count *= 2) {
+    ConcurrentMap<int, int, hash<int>, equal_to<int>, Lock> counters(
+        thread_count * 4);
+    {
+      LOG_DURATION(lock_name + " keys="s + to_string(key_count) + " x"s +
+                   to_string(thread_count));
+      vector<thread> threads;
+      for (size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t] {
+          mt19937 generator(t);
+          uniform_int_distribution<int> key(0, key_count - 1);
+          for (size_t i = 0; i < 400'000 / thread_count; ++i) {
+            // one write per four lookups
+            const int k = key(generator);
+            if (i % 4 == 0) {
+              counters[k].ref_to_value += 1;
+            } else {
+              counters.Find(k);
+            }
+          }
+        });
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+    }
+  }
+}
+
+void BenchmarkConcurrentMap() {
+  // Few keys means heavy contention on the same buckets, many keys spreads
+  // the threads over the whole map.
+  for (size_t key_count : {16, 100'000}) {
+    RunConcurrentMapContention<mutex>("mutex"s, key_count);
+    RunConcurrentMapContention<shared_mutex>("shared_mutex"s, key_count);
+    RunConcurrentMapContention<SpinLock>("spin"s, key_count);
+  }
+}
+
+} // namespace
+
+void RunMicroBenchmarks() {
+  BenchmarkFind();
+  BenchmarkPostingCompression();
+  BenchmarkMaxScore();
+  BenchmarkConcurrentMap();
+  BenchmarkBatchQueries();
+  BenchmarkAddDocuments();
+  BenchmarkRemoveDocuments();
+  BenchmarkSnapshot();
+  BenchmarkMutationLog();
+  BenchmarkConcurrentSearchServer();
+  BenchmarkTokenizer();
+  BenchmarkStopWords();
+  BenchmarkCorpusLoader();
+  BenchmarkLatencyRecording();
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// Side-by-side timings of alternative implementations, e.g. the plain and
+// the compressed posting scan, printed with LOG_DURATION. Where both ways
+// compute a result, the benchmark checks that they agree.
+void RunMicroBenchmarks();
@@ -0,0 +1,469 @@
+#include "benchmark_suite.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <execution>
+#include <iomanip>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "search_server.h"
+#include "text_generator.h"
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+// Results of the timed calls end up here, so that none of them is optimized
+// away.
+atomic<size_t> benchmark_sink = 0;
+
+// The fastest of the repetitions; prepare() runs untimed before each one and
+// its result is handed to operation.
+template <typename Prepare, typename Operation>
+double MeasureBest(int repetitions, Prepare prepare, Operation operation) {
+  double best = numeric_limits<double>::max();
+  for (int i = 0; i < max(repetitions, 1); ++i) {
+    auto state = prepare();
+    const auto start = Clock::now();
+    operation(state);
+    best = min(best,
+               chrono::duration<double>(Clock::now() - start).count());
+  }
+  return best;
+}
+
+// Calls operation(i) for i in [0, count), in contiguous slices, one slice
+// per thread.
+template <typename Operation>
+void RunOnThreads(int thread_count, int count, Operation operation) {
+  const auto run_slice = [&operation](int begin, int end) {
+    size_t sink = 0;
+    for (int i = begin; i < end; ++i) {
+      sink += operation(i);
+    }
+    benchmark_sink += sink;
+  };
+  if (thread_count <= 1) {
+    run_slice(0, count);
+    return;
+  }
+  vector<thread> threads;
+  threads.reserve(thread_count);
+  for (int t = 0; t < thread_count; ++t) {
+    threads.emplace_back(run_slice, count * t / thread_count,
+                         count * (t + 1) / thread_count);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+// RemoveDuplicates reports every removed document to std::cout.
+class SilencedOutput {
+public:
+  SilencedOutput() : saved_(cout.rdbuf(sink_.rdbuf())) {}
+  ~SilencedOutput() { cout.rdbuf(saved_); }
+
+private:
+  ostringstream sink_;
+  streambuf *saved_;
+};
+
+void RunCorpusBenchmarks(const BenchmarkConfig &config, int document_count,
+                         vector<BenchmarkResult> &results) {
+  const BenchmarkCorpus corpus = MakeBenchmarkCorpus(config, document_count);
+  const int query_count = static_cast<int>(corpus.queries.size());
+  const auto add_result = [&](string name, int thread_count,
+                              int operation_count, double seconds) {
+    results.push_back({move(name), document_count, thread_count,
+                       operation_count, seconds});
+  };
+  const auto no_state = [] { return 0; };
+
+  add_result("AddDocument"s, 1, document_count,
+             MeasureBest(config.repetitions, no_state, [&](int) {
+               benchmark_sink += MakeBenchmarkServer(corpus).GetDocumentCount();
+             }));
+
+  const SearchServer server = MakeBenchmarkServer(corpus);
+  const auto match_document = [&](const auto &policy) {
+    return [&server, &corpus, document_count, &policy](int i) {
+      const auto [words, status] = server.MatchDocument(
+          policy, corpus.queries[i], i % document_count);
+      return words.size();
+    };
+  };
+  const auto find_top_documents = [&](const auto &policy) {
+    return [&server, &corpus, &policy](int i) {
+      return server.FindTopDocuments(policy, corpus.queries[i]).size();
+    };
+  };
+  for (const int thread_count : config.thread_counts) {
+    const auto measure = [&](string name, auto operation) {
+      add_result(move(name), thread_count, query_count,
+                 MeasureBest(config.repetitions, no_state, [&](int) {
+                   RunOnThreads(thread_count, query_count, operation);
+                 }));
+    };
+    measure("FindTopDocuments/seq"s, find_top_documents(execution::seq));
+    measure("FindTopDocuments/par"s, find_top_documents(execution::par));
+    measure("MatchDocument/seq"s, match_document(execution::seq));
+    measure("MatchDocument/par"s, match_document(execution::par));
+  }
+
+  add_result("ProcessQueries"s, 1, query_count,
+             MeasureBest(config.repetitions, no_state, [&](int) {
+               benchmark_sink += ProcessQueries(server, corpus.queries).size();
+             }));
+
+  const auto copy_server = [&server] { return server; };
+  add_result("RemoveDocument"s, 1, document_count,
+             MeasureBest(config.repetitions, copy_server,
+                         [&](SearchServer &copy) {
+                           for (int id = 0; id < document_count; ++id) {
+                             copy.RemoveDocument(id);
+                           }
+                         }));
+  add_result("RemoveDuplicates"s, 1, document_count,
+             MeasureBest(config.repetitions, copy_server,
+                         [&](SearchServer &copy) {
+                           const SilencedOutput silenced;
+                           RemoveDuplicates(copy);
+                           benchmark_sink += copy.GetDocumentCount();
+                         }));
+}
+
+void WriteJsonString(ostream &output, string_view text) {
+  output << '"';
+  for (const char c : text) {
+    if (c == '"' || c == '\\') {
+      output << '\\' << c;
+    } else if (c == '\n') {
+      output << "\\n"sv;
+    } else if (c == '\t') {
+      output << "\\t"sv;
+    } else {
+      output << c;
+    }
+  }
+  output << '"';
+}
+
+// Just enough JSON for the benchmark files.
+class JsonReader {
+public:
+  explicit JsonReader(string text) : text_(move(text)) {}
+
+  void Expect(char c) {
+    if (Peek() != c) {
+      throw invalid_argument("Expected '"s + c + "' at offset "s +
+                             to_string(pos_));
+    }
+    ++pos_;
+  }
+
+  // Skips c if it comes next.
+  bool Consume(char c) {
+    SkipWhitespace();
+    if (pos_ < text_.size() && text_[pos_] == c) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  void ExpectEnd() {
+    SkipWhitespace();
+    if (pos_ != text_.size()) {
+      throw invalid_argument("Trailing data at offset "s + to_string(pos_));
+    }
+  }
+
+  string ReadString() {
+    Expect('"');
+    string result;
+    while (true) {
+      if (pos_ >= text_.size()) {
+        throw invalid_argument("Unterminated string"s);
+      }
+      char c = text_[pos_++];
+      if (c == '"') {
+        return result;
+      }
+      if (c == '\\') {
+        if (pos_ >= text_.size()) {
+          throw invalid_argument("Unterminated string"s);
+        }
+        static const string_view ESCAPES = "\"\"\\\\//b\bf\fn\nr\rt\t"sv;
+        const size_t escape = ESCAPES.find(text_[pos_++]);
+        if (escape == string_view::npos || escape % 2 != 0) {
+          throw invalid_argument("Unsupported escape at offset "s +
+                                 to_string(pos_ - 1));
+        }
+        c = ESCAPES[escape + 1];
+      }
+      result.push_back(c);
+    }
+  }
+
+  double ReadNumber() {
+    SkipWhitespace();
+    const char *begin = text_.c_str() + pos_;
+    char *end = nullptr;
+    const double value = strtod(begin, &end);
+    if (end == begin) {
+      throw invalid_argument("Expected a number at offset "s +
+                             to_string(pos_));
+    }
+    pos_ += end - begin;
+    return value;
+  }
+
+  void SkipValue() {
+    const char c = Peek();
+    if (c == '{' || c == '[') {
+      const char close = c == '{' ? '}' : ']';
+      ++pos_;
+      if (Consume(close)) {
+        return;
+      }
+      do {
+        if (c == '{') {
+          ReadString();
+          Expect(':');
+        }
+        SkipValue();
+      } while (Consume(','));
+      Expect(close);
+    } else if (c == '"') {
+      ReadString();
+    } else if (c == 't' || c == 'f' || c == 'n') {
+      for (const string_view literal : {"true"sv, "false"sv, "null"sv}) {
+        if (string_view(text_).substr(pos_, literal.size()) == literal) {
+          pos_ += literal.size();
+          return;
+        }
+      }
+      throw invalid_argument("Unknown literal at offset "s + to_string(pos_));
+    } else {
+      ReadNumber();
+    }
+  }
+
+private:
+  string text_;
+  size_t pos_ = 0;
+
+  void SkipWhitespace() {
+    while (pos_ < text_.size() && isspace(static_cast<unsigned char>(text_[pos_]))) {
+      ++pos_;
+    }
+  }
+
+  char Peek() {
+    SkipWhitespace();
+    if (pos_ >= text_.size()) {
+      throw invalid_argument("Unexpected end of benchmark results"s);
+    }
+    return text_[pos_];
+  }
+};
+
+// Calls read_member(key) for every member of an object; read_member reads
+// the value.
+template <typename MemberReader>
+void ReadJsonObject(JsonReader &reader, MemberReader read_member) {
+  reader.Expect('{');
+  if (reader.Consume('}')) {
+    return;
+  }
+  do {
+    const string key = reader.ReadString();
+    reader.Expect(':');
+    read_member(key);
+  } while (reader.Consume(','));
+  reader.Expect('}');
+}
+
+BenchmarkResult ReadResult(JsonReader &reader) {
+  BenchmarkResult result;
+  bool has_name = false;
+  ReadJsonObject(reader, [&](const string &key) {
+    if (key == "name"sv) {
+      result.name = reader.ReadString();
+      has_name = true;
+    } else if (key == "documents"sv) {
+      result.document_count = static_cast<int>(reader.ReadNumber());
+    } else if (key == "threads"sv) {
+      result.thread_count = static_cast<int>(reader.ReadNumber());
+    } else if (key == "operations"sv) {
+      result.operation_count = static_cast<int>(reader.ReadNumber());
+    } else if (key == "seconds"sv) {
+      result.seconds = reader.ReadNumber();
+    } else {
+      reader.SkipValue();
+    }
+  });
+  if (!has_name) {
+    throw invalid_argument("Benchmark result without a name"s);
+  }
+  return result;
+}
+
+} // namespace
+
+BenchmarkCorpus MakeBenchmarkCorpus(const BenchmarkConfig &config,
+                                    int document_count) {
+  mt19937 generator(config.seed);
+  BenchmarkCorpus corpus;
+  corpus.dictionary = GenerateDictionary(generator, config.dictionary_size,
+                                         config.max_word_length);
+  for (size_t i = 0; i < min<size_t>(corpus.dictionary.size(), 5); ++i) {
+    corpus.stop_words += corpus.dictionary[i] + ' ';
+  }
+  corpus.documents = GenerateQueries(generator, corpus.dictionary,
+                                     document_count, config.words_per_document);
+  for (size_t i = 9; i < corpus.documents.size(); i += 10) {
+    corpus.documents[i] = corpus.documents[i - 1];
+  }
+  corpus.queries = GenerateQueries(generator, corpus.dictionary,
+                                   config.query_count, config.words_per_query);
+  return corpus;
+}
+
+void AddBenchmarkDocuments(SearchServer &server, const BenchmarkCorpus &corpus) {
+  for (int id = 0; id < static_cast<int>(corpus.documents.size()); ++id) {
+    server.AddDocument(id, corpus.documents[id], DocumentStatus::ACTUAL,
+                       {1, 2, 3});
+  }
+}
+
+SearchServer MakeBenchmarkServer(const BenchmarkCorpus &corpus) {
+  SearchServer server(corpus.stop_words);
+  AddBenchmarkDocuments(server, corpus);
+  return server;
+}
+
+string BenchmarkResult::GetKey() const {
+  return name + " docs="s + to_string(document_count) + " threads="s +
+         to_string(thread_count);
+}
+
+double BenchmarkResult::GetNanosecondsPerOperation() const {
+  return operation_count > 0 ? seconds * 1e9 / operation_count : 0;
+}
+
+vector<BenchmarkResult> RunBenchmarks(const BenchmarkConfig &config) {
+  vector<BenchmarkResult> results;
+  for (const int document_count : config.document_counts) {
+    RunCorpusBenchmarks(config, max(document_count, 1), results);
+  }
+  return results;
+}
+
+void WriteBenchmarkJson(ostream &output,
+                        const vector<BenchmarkResult> &results) {
+  const auto precision = output.precision(9);
+  output << "{\n  \"benchmarks\": ["sv;
+  bool first = true;
+  for (const auto &result : results) {
+    output << (first ? "\n    {"sv : ",\n    {"sv) << "\"name\": "sv;
+    WriteJsonString(output, result.name);
+    output << ", \"documents\": "sv << result.document_count
+           << ", \"threads\": "sv << result.thread_count
+           << ", \"operations\": "sv << result.operation_count
+           << ", \"seconds\": "sv << result.seconds
+           << ", \"ns_per_op\": "sv << result.GetNanosecondsPerOperation()
+           << '}';
+    first = false;
+  }
+  output << "\n  ]\n}\n"sv;
+  output.precision(precision);
+}
+
+vector<BenchmarkResult> ReadBenchmarkJson(istream &input) {
+  JsonReader reader(string{istreambuf_iterator<char>(input),
+                           istreambuf_iterator<char>()});
+  vector<BenchmarkResult> results;
+  ReadJsonObject(reader, [&](const string &key) {
+    if (key != "benchmarks"sv) {
+      reader.SkipValue();
+      return;
+    }
+    reader.Expect('[');
+    if (reader.Consume(']')) {
+      return;
+    }
+    do {
+      results.push_back(ReadResult(reader));
+    } while (reader.Consume(','));
+    reader.Expect(']');
+  });
+  reader.ExpectEnd();
+  return results;
+}
+
+vector<BenchmarkComparison>
+CompareBenchmarks(const vector<BenchmarkResult> &baseline,
+                  const vector<BenchmarkResult> &current, double tolerance) {
+  map<string, const BenchmarkResult *> baseline_by_key;
+  for (const auto &result : baseline) {
+    baseline_by_key[result.GetKey()] = &result;
+  }
+  vector<BenchmarkComparison> comparisons;
+  for (const auto &result : current) {
+    const auto it = baseline_by_key.find(result.GetKey());
+    if (it == baseline_by_key.end()) {
+      continue;
+    }
+    BenchmarkComparison comparison;
+    comparison.key = it->first;
+    comparison.baseline_ns = it->second->GetNanosecondsPerOperation();
+    comparison.current_ns = result.GetNanosecondsPerOperation();
+    comparison.ratio = comparison.baseline_ns > 0
+                           ? comparison.current_ns / comparison.baseline_ns
+                           : 1;
+    comparison.regression =
+        comparison.current_ns > comparison.baseline_ns * (1 + tolerance);
+    comparisons.push_back(move(comparison));
+  }
+  return comparisons;
+}
+
+void PrintBenchmarkResults(ostream &output,
+                           const vector<BenchmarkResult> &results) {
+  const auto precision = output.precision();
+  for (const auto &result : results) {
+    output << result.GetKey() << ": "s << fixed << setprecision(1)
+           << result.GetNanosecondsPerOperation() << " ns/op"s
+           << defaultfloat << endl;
+  }
+  output.precision(precision);
+}
+
+void PrintBenchmarkComparison(ostream &output,
+                              const vector<BenchmarkComparison> &comparisons) {
+  const auto precision = output.precision();
+  for (const auto &comparison : comparisons) {
+    output << comparison.key << ": "s << fixed << setprecision(1)
+           << comparison.baseline_ns << " -> "s << comparison.current_ns
+           << " ns/op ("s << showpos << (comparison.ratio - 1) * 100
+           << noshowpos << "%)"s << defaultfloat
+           << (comparison.regression ? " REGRESSION"s : ""s) << endl;
+  }
+  output.precision(precision);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "search_server.h"
+
+// Synthetic corpora for the benchmarks: document_count documents of 1 to
+// words_per_document words drawn from a dictionary of GenerateDictionary,
+// with every tenth document repeating the one before it, so that
+// RemoveDuplicates has work to do.
+struct BenchmarkConfig {
+  std::vector<int> document_counts = {1'000, 10'000};
+  // Caller threads that share the read-only benchmarks. Mutations run on one
+  // thread only, as SearchServer requires.
+  std::vector<int> thread_counts = {1, 4};
+  int dictionary_size = 2'000;
+  int max_word_length = 10;
+  int words_per_document = 70;
+  int query_count = 1'000;
+  int words_per_query = 7;
+  // Every benchmark keeps the fastest of its repetitions.
+  int repetitions = 3;
+  uint32_t seed = 42;
+};
+
+struct BenchmarkResult {
+  std::string name;  // operation and policy, e.g. "FindTopDocuments/par"
+  int document_count = 0;
+  int thread_count = 1;
+  int operation_count = 0;
+  double seconds = 0;
+
+  // Identifies the same measurement across runs.
+  std::string GetKey() const;
+  double GetNanosecondsPerOperation() const;
+};
+
+// Corpus of one size: its dictionary and stop words (the first five
+// dictionary words), the documents and config.query_count queries of 1 to
+// config.words_per_query words.
+struct BenchmarkCorpus {
+  std::vector<std::string> dictionary;
+  std::string stop_words;
+  std::vector<std::string> documents;
+  std::vector<std::string> queries;
+};
+
+BenchmarkCorpus MakeBenchmarkCorpus(const BenchmarkConfig &config,
+                                    int document_count);
+// Adds the documents with their indices as ids, ACTUAL and rated {1, 2, 3}.
+void AddBenchmarkDocuments(SearchServer &server, const BenchmarkCorpus &corpus);
+SearchServer MakeBenchmarkServer(const BenchmarkCorpus &corpus);
+
+// Runs AddDocument, FindTopDocuments (seq/par), MatchDocument (seq/par),
+// RemoveDocument, ProcessQueries and RemoveDuplicates on a corpus of every
+// size, the read-only ones for every thread count.
+std::vector<BenchmarkResult> RunBenchmarks(const BenchmarkConfig &config);
+
+// {"benchmarks": [{"name": ..., "documents": ..., "threads": ...,
+//                  "operations": ..., "seconds": ..., "ns_per_op": ...}]}
+void WriteBenchmarkJson(std::ostream &output,
+                        const std::vector<BenchmarkResult> &results);
+// Reads what WriteBenchmarkJson writes; unknown keys are skipped. Throws
+// std::invalid_argument on malformed input.
+std::vector<BenchmarkResult> ReadBenchmarkJson(std::istream &input);
+
+struct BenchmarkComparison {
+  std::string key;
+  double baseline_ns = 0;
+  double current_ns = 0;
+  double ratio = 0;  // current to baseline time per operation
+  bool regression = false;
+};
+
+// Pairs the results by key; a result is a regression when its time per
+// operation exceeds the baseline by more than tolerance (0.1 is 10%).
+// Results missing from either side are left out.
+std::vector<BenchmarkComparison>
+CompareBenchmarks(const std::vector<BenchmarkResult> &baseline,
+                  const std::vector<BenchmarkResult> &current,
+                  double tolerance);
+
+void PrintBenchmarkResults(std::ostream &output,
+                           const std::vector<BenchmarkResult> &results);
+void PrintBenchmarkComparison(std::ostream &output,
+                              const std::vector<BenchmarkComparison> &comparisons);
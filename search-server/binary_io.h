@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// Raw reads and writes for the binary index files. Values are stored in
+// host byte order; file headers carry a marker so that a file written on a
+// machine with the other byte order is rejected instead of misread.
+inline constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+template <typename T>
+void WriteArray(std::ostream &output, const T *data, size_t count) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  output.write(reinterpret_cast<const char *>(data), sizeof(T) * count);
+}
+
+template <typename T> void WriteValue(std::ostream &output, const T &value) {
+  WriteArray(output, &value, 1);
+}
+
+template <typename T>
+void ReadArray(std::istream &input, T *data, size_t count) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  if (!input.read(reinterpret_cast<char *>(data), sizeof(T) * count)) {
+    throw std::runtime_error("Unexpected end of index file");
+  }
+}
+
+template <typename T> T ReadValue(std::istream &input) {
+  T value;
+  ReadArray(input, &value, 1);
+  return value;
+}
+
+inline void WriteString(std::ostream &output, std::string_view text) {
+  WriteValue(output, static_cast<uint32_t>(text.size()));
+  WriteArray(output, text.data(), text.size());
+}
+
+// Strings longer than max_size, e.g. the bytes known to be left in the
+// file, are rejected before they are allocated.
+inline std::string ReadString(std::istream &input,
+                              uint64_t max_size = UINT32_MAX) {
+  const auto size = ReadValue<uint32_t>(input);
+  if (size > max_size) {
+    throw std::runtime_error("Unexpected end of index file");
+  }
+  std::string text(size, '\0');
+  ReadArray(input, text.data(), text.size());
+  return text;
+}
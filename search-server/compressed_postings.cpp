@@ -0,0 +1,404 @@
+#include "compressed_postings.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "cpu_features.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||           \
+    defined(_M_IX86)
+#define POSTINGS_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define POSTINGS_TARGET(x) __attribute__((target(x)))
+#else
+#define POSTINGS_TARGET(x)
+#endif
+
+using namespace std;
+
+namespace {
+
+using DecodeDeltasFunction = void (*)(const uint8_t *deltas, uint8_t width,
+                                      size_t count, int base, int *ordinals);
+
+template <int Width> uint32_t LoadDelta(const uint8_t *deltas, size_t i) {
+  if constexpr (Width == 1) {
+    return deltas[i];
+  } else if constexpr (Width == 2) {
+    uint16_t delta;
+    memcpy(&delta, deltas + 2 * i, sizeof(delta));
+    return delta;
+  } else {
+    uint32_t delta;
+    memcpy(&delta, deltas + 4 * i, sizeof(delta));
+    return delta;
+  }
+}
+
+template <int Width>
+void DecodeDeltasTail(const uint8_t *deltas, size_t begin, size_t count,
+                      int value, int *ordinals) {
+  for (size_t i = begin; i < count; ++i) {
+    value += static_cast<int>(LoadDelta<Width>(deltas, i));
+    ordinals[i] = value;
+  }
+}
+
+void DecodeDeltasScalar(const uint8_t *deltas, uint8_t width, size_t count,
+                        int base, int *ordinals) {
+  switch (width) {
+  case 1:
+    DecodeDeltasTail<1>(deltas, 0, count, base, ordinals);
+    break;
+  case 2:
+    DecodeDeltasTail<2>(deltas, 0, count, base, ordinals);
+    break;
+  default:
+    DecodeDeltasTail<4>(deltas, 0, count, base, ordinals);
+  }
+}
+
+#ifdef POSTINGS_X86
+
+template <int Width>
+POSTINGS_TARGET("sse4.1")
+void DecodeDeltasSse41Impl(const uint8_t *deltas, size_t count, int base,
+                           int *ordinals) {
+  __m128i prev = _mm_set1_epi32(base);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i values;
+    if constexpr (Width == 1) {
+      int packed;
+      memcpy(&packed, deltas + i, sizeof(packed));
+      values = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed));
+    } else if constexpr (Width == 2) {
+      values = _mm_cvtepu16_epi32(
+          _mm_loadl_epi64(reinterpret_cast<const __m128i *>(deltas + 2 * i)));
+    } else {
+      values =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(deltas + 4 * i));
+    }
+    // In-register prefix sum of the four deltas.
+    values = _mm_add_epi32(values, _mm_slli_si128(values, 4));
+    values = _mm_add_epi32(values, _mm_slli_si128(values, 8));
+    values = _mm_add_epi32(values, prev);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(ordinals + i), values);
+    prev = _mm_shuffle_epi32(values, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+  DecodeDeltasTail<Width>(deltas, i, count, _mm_cvtsi128_si32(prev),
+                          ordinals);
+}
+
+void DecodeDeltasSse41(const uint8_t *deltas, uint8_t width, size_t count,
+                       int base, int *ordinals) {
+  switch (width) {
+  case 1:
+    DecodeDeltasSse41Impl<1>(deltas, count, base, ordinals);
+    break;
+  case 2:
+    DecodeDeltasSse41Impl<2>(deltas, count, base, ordinals);
+    break;
+  default:
+    DecodeDeltasSse41Impl<4>(deltas, count, base, ordinals);
+  }
+}
+
+template <int Width>
+POSTINGS_TARGET("avx2")
+void DecodeDeltasAvx2Impl(const uint8_t *deltas, size_t count, int base,
+                          int *ordinals) {
+  const __m256i low_lane_last = _mm256_setr_epi32(0, 0, 0, 0, 3, 3, 3, 3);
+  const __m256i last = _mm256_set1_epi32(7);
+  __m256i prev = _mm256_set1_epi32(base);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i values;
+    if constexpr (Width == 1) {
+      values = _mm256_cvtepu8_epi32(
+          _mm_loadl_epi64(reinterpret_cast<const __m128i *>(deltas + i)));
+    } else if constexpr (Width == 2) {
+      values = _mm256_cvtepu16_epi32(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(deltas + 2 * i)));
+    } else {
+      values = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(deltas + 4 * i));
+    }
+    // Prefix sums inside each 128-bit lane, then carry the low lane total
+    // into the high lane.
+    values = _mm256_add_epi32(values, _mm256_slli_si256(values, 4));
+    values = _mm256_add_epi32(values, _mm256_slli_si256(values, 8));
+    const __m256i carry =
+        _mm256_blend_epi32(_mm256_setzero_si256(),
+                           _mm256_permutevar8x32_epi32(values, low_lane_last),
+                           0xF0);
+    values = _mm256_add_epi32(values, carry);
+    values = _mm256_add_epi32(values, prev);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(ordinals + i), values);
+    prev = _mm256_permutevar8x32_epi32(values, last);
+  }
+  DecodeDeltasTail<Width>(deltas, i, count,
+                          _mm_cvtsi128_si32(_mm256_castsi256_si128(prev)),
+                          ordinals);
+}
+
+void DecodeDeltasAvx2(const uint8_t *deltas, uint8_t width, size_t count,
+                      int base, int *ordinals) {
+  switch (width) {
+  case 1:
+    DecodeDeltasAvx2Impl<1>(deltas, count, base, ordinals);
+    break;
+  case 2:
+    DecodeDeltasAvx2Impl<2>(deltas, count, base, ordinals);
+    break;
+  default:
+    DecodeDeltasAvx2Impl<4>(deltas, count, base, ordinals);
+  }
+}
+
+#endif
+
+struct Decoder {
+  DecodeDeltasFunction decode;
+  const char *name;
+};
+
+Decoder SelectDecoder() {
+#ifdef POSTINGS_X86
+  const CpuFeatures &features = GetCpuFeatures();
+  if (features.avx2) {
+    return {DecodeDeltasAvx2, "avx2"};
+  }
+  if (features.sse41) {
+    return {DecodeDeltasSse41, "sse4.1"};
+  }
+#endif
+  return {DecodeDeltasScalar, "scalar"};
+}
+
+const Decoder &GetDecoder() {
+  static const Decoder decoder = SelectDecoder();
+  return decoder;
+}
+
+uint8_t GetByteWidth(uint32_t max_value) {
+  if (max_value <= 0xFF) {
+    return 1;
+  }
+  if (max_value <= 0xFFFF) {
+    return 2;
+  }
+  return 4;
+}
+
+uint32_t LoadValue(const uint8_t *values, uint8_t width, size_t i) {
+  switch (width) {
+  case 1:
+    return LoadDelta<1>(values, i);
+  case 2:
+    return LoadDelta<2>(values, i);
+  default:
+    return LoadDelta<4>(values, i);
+  }
+}
+
+template <int Width>
+void DecodeTermFreqs(const uint8_t *codes, size_t count,
+                     const double *distinct_term_freqs, double *term_freqs) {
+  for (size_t i = 0; i < count; ++i) {
+    term_freqs[i] = distinct_term_freqs[LoadDelta<Width>(codes, i)];
+  }
+}
+
+void AppendValue(vector<uint8_t> &values, uint32_t value, uint8_t width) {
+  uint8_t bytes[4];
+  memcpy(bytes, &value, sizeof(value));
+  values.insert(values.end(), bytes, bytes + width);
+}
+
+} // namespace
+
+CompressedPostingView::CompressedPostingView(
+    const CompressedPostingBlock *blocks, size_t block_count,
+    const uint8_t *deltas, size_t delta_bytes, const uint8_t *codes,
+    size_t code_bytes, const double *term_freqs, size_t term_freq_count)
+    : blocks_(blocks), block_count_(block_count), deltas_(deltas),
+      delta_bytes_(delta_bytes), codes_(codes), code_bytes_(code_bytes),
+      term_freqs_(term_freqs), term_freq_count_(term_freq_count) {
+  for (size_t block = 0; block < block_count_; ++block) {
+    size_ += blocks_[block].count;
+  }
+}
+
+size_t CompressedPostingView::size() const { return size_; }
+
+bool CompressedPostingView::empty() const { return size_ == 0; }
+
+size_t CompressedPostingView::GetBlockCount() const { return block_count_; }
+
+int CompressedPostingView::GetBlockLastOrdinal(size_t block) const {
+  return blocks_[block].last_ordinal;
+}
+
+size_t CompressedPostingView::DecodeBlock(size_t block, int *ordinals,
+                                          double *term_freqs) const {
+  const CompressedPostingBlock &header = blocks_[block];
+  GetDecoder().decode(deltas_ + header.delta_offset, header.delta_width,
+                      header.count, header.base, ordinals);
+  const uint8_t *codes = codes_ + header.code_offset;
+  switch (header.code_width) {
+  case 1:
+    DecodeTermFreqs<1>(codes, header.count, term_freqs_, term_freqs);
+    break;
+  case 2:
+    DecodeTermFreqs<2>(codes, header.count, term_freqs_, term_freqs);
+    break;
+  default:
+    DecodeTermFreqs<4>(codes, header.count, term_freqs_, term_freqs);
+  }
+  return header.count;
+}
+
+InvertedIndex::PostingList CompressedPostingView::Decode() const {
+  InvertedIndex::PostingList postings;
+  postings.reserve(size_);
+  ForEach([&postings](int ordinal, double term_freq) {
+    postings.push_back({ordinal, term_freq});
+  });
+  return postings;
+}
+
+bool CompressedPostingView::Contains(int ordinal) const {
+  const CompressedPostingBlock *end = blocks_ + block_count_;
+  const CompressedPostingBlock *block = lower_bound(
+      blocks_, end, ordinal,
+      [](const CompressedPostingBlock &block, int value) {
+        return block.last_ordinal < value;
+      });
+  if (block == end) {
+    return false;
+  }
+  int ordinals[BLOCK_SIZE];
+  GetDecoder().decode(deltas_ + block->delta_offset, block->delta_width,
+                      block->count, block->base, ordinals);
+  return binary_search(ordinals, ordinals + block->count, ordinal);
+}
+
+bool CompressedPostingView::IsWellFormed(size_t ordinal_count) const {
+  const auto fits = [](uint32_t offset, size_t count, uint8_t width,
+                       size_t bytes) {
+    return (width == 1 || width == 2 || width == 4) && offset <= bytes &&
+           count * width <= bytes - offset;
+  };
+  int64_t previous = -1;
+  for (size_t block = 0; block < block_count_; ++block) {
+    const CompressedPostingBlock &header = blocks_[block];
+    if (header.count == 0 || header.count > BLOCK_SIZE ||
+        header.base != max<int64_t>(previous, 0) ||
+        !fits(header.delta_offset, header.count, header.delta_width,
+              delta_bytes_) ||
+        !fits(header.code_offset, header.count, header.code_width,
+              code_bytes_)) {
+      return false;
+    }
+    int64_t ordinal = header.base;
+    for (size_t i = 0; i < header.count; ++i) {
+      ordinal += LoadValue(deltas_ + header.delta_offset, header.delta_width, i);
+      if (ordinal <= previous || ordinal >= static_cast<int64_t>(ordinal_count) ||
+          LoadValue(codes_ + header.code_offset, header.code_width, i) >=
+              term_freq_count_) {
+        return false;
+      }
+      previous = ordinal;
+    }
+    if (header.last_ordinal != ordinal) {
+      return false;
+    }
+  }
+  return true;
+}
+
+CompressedPostingList::CompressedPostingList(
+    const InvertedIndex::PostingList &postings)
+    : size_(postings.size()) {
+  for (const auto [ordinal, term_freq] : postings) {
+    term_freqs_.push_back(term_freq);
+  }
+  sort(term_freqs_.begin(), term_freqs_.end());
+  term_freqs_.erase(unique(term_freqs_.begin(), term_freqs_.end()),
+                    term_freqs_.end());
+  term_freqs_.shrink_to_fit();
+
+  blocks_.reserve((postings.size() + BLOCK_SIZE - 1) / BLOCK_SIZE);
+  int prev = 0;
+  vector<uint32_t> codes(BLOCK_SIZE);
+  for (size_t begin = 0; begin < postings.size(); begin += BLOCK_SIZE) {
+    const size_t end = min(begin + BLOCK_SIZE, postings.size());
+    uint32_t max_delta = 0;
+    uint32_t max_code = 0;
+    int last = prev;
+    for (size_t i = begin; i < end; ++i) {
+      max_delta = max(max_delta, static_cast<uint32_t>(postings[i].ordinal - last));
+      last = postings[i].ordinal;
+      codes[i - begin] = static_cast<uint32_t>(
+          lower_bound(term_freqs_.begin(), term_freqs_.end(),
+                      postings[i].term_freq) -
+          term_freqs_.begin());
+      max_code = max(max_code, codes[i - begin]);
+    }
+
+    const CompressedPostingBlock block{prev,
+                                       last,
+                                       static_cast<uint32_t>(deltas_.size()),
+                                       static_cast<uint32_t>(codes_.size()),
+                                       static_cast<uint16_t>(end - begin),
+                                       GetByteWidth(max_delta),
+                                       GetByteWidth(max_code)};
+    for (size_t i = begin; i < end; ++i) {
+      AppendValue(deltas_, static_cast<uint32_t>(postings[i].ordinal - prev),
+                  block.delta_width);
+      prev = postings[i].ordinal;
+      AppendValue(codes_, codes[i - begin], block.code_width);
+    }
+    blocks_.push_back(block);
+  }
+  deltas_.shrink_to_fit();
+  codes_.shrink_to_fit();
+}
+
+CompressedPostingView CompressedPostingList::GetView() const {
+  return CompressedPostingView(blocks_.data(), blocks_.size(), deltas_.data(),
+                               deltas_.size(), codes_.data(), codes_.size(),
+                               term_freqs_.data(), term_freqs_.size());
+}
+
+size_t CompressedPostingList::size() const { return size_; }
+
+bool CompressedPostingList::empty() const { return size_ == 0; }
+
+size_t CompressedPostingList::GetByteSize() const {
+  return blocks_.capacity() * sizeof(CompressedPostingBlock) +
+         deltas_.capacity() + codes_.capacity() +
+         term_freqs_.capacity() * sizeof(double);
+}
+
+const vector<CompressedPostingBlock> &CompressedPostingList::GetBlocks() const {
+  return blocks_;
+}
+
+const vector<uint8_t> &CompressedPostingList::GetDeltas() const {
+  return deltas_;
+}
+
+const vector<uint8_t> &CompressedPostingList::GetCodes() const {
+  return codes_;
+}
+
+const vector<double> &CompressedPostingList::GetTermFreqs() const {
+  return term_freqs_;
+}
+
+const char *GetPostingDecoderName() { return GetDecoder().name; }
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "inverted_index.h"
+
+// Header of one block of a compressed posting list. Blocks are plain data so
+// that a mapped index file can store them as they are.
+struct CompressedPostingBlock {
+  int32_t base;          // ordinal the first delta is relative to
+  int32_t last_ordinal;
+  uint32_t delta_offset; // in bytes, into the deltas of the list
+  uint32_t code_offset;  // in bytes, into the term frequency codes
+  uint16_t count;
+  uint8_t delta_width;
+  uint8_t code_width;
+};
+
+// Read-only, compact form of a posting list over arrays it does not own,
+// e.g. in a mapped file. Postings are cut into blocks of BLOCK_SIZE; every
+// block stores the ordinal deltas with the narrowest byte width (1, 2 or 4)
+// that fits them. Term frequencies are coded losslessly: the list keeps
+// each distinct term frequency once, and a block stores the index of every
+// posting's one in the same narrowest width. Blocks are independent, so a
+// scan can skip a block using its last ordinal without decoding it.
+class CompressedPostingView {
+public:
+  static constexpr size_t BLOCK_SIZE = 128;
+
+  CompressedPostingView() = default;
+  CompressedPostingView(const CompressedPostingBlock *blocks,
+                        size_t block_count, const uint8_t *deltas,
+                        size_t delta_bytes, const uint8_t *codes,
+                        size_t code_bytes, const double *term_freqs,
+                        size_t term_freq_count);
+
+  size_t size() const;
+  bool empty() const;
+  size_t GetBlockCount() const;
+  int GetBlockLastOrdinal(size_t block) const;
+
+  // Decodes one block into arrays of at least BLOCK_SIZE elements and
+  // returns the number of postings written.
+  size_t DecodeBlock(size_t block, int *ordinals, double *term_freqs) const;
+  InvertedIndex::PostingList Decode() const;
+  bool Contains(int ordinal) const;
+
+  // Whether the blocks stay within the arrays and decode to strictly
+  // ascending ordinals below ordinal_count, for data read from a file.
+  bool IsWellFormed(size_t ordinal_count) const;
+
+  template <typename Callback> void ForEach(Callback callback) const;
+
+private:
+  const CompressedPostingBlock *blocks_ = nullptr;
+  size_t block_count_ = 0;
+  const uint8_t *deltas_ = nullptr;
+  size_t delta_bytes_ = 0;
+  const uint8_t *codes_ = nullptr;
+  size_t code_bytes_ = 0;
+  const double *term_freqs_ = nullptr;
+  size_t term_freq_count_ = 0;
+  size_t size_ = 0;
+};
+
+// Compressed copy of an in-memory posting list.
+class CompressedPostingList {
+public:
+  static constexpr size_t BLOCK_SIZE = CompressedPostingView::BLOCK_SIZE;
+
+  CompressedPostingList() = default;
+  explicit CompressedPostingList(const InvertedIndex::PostingList &postings);
+
+  // Views the arrays of this list, so it is invalidated by moving the list.
+  CompressedPostingView GetView() const;
+
+  size_t size() const;
+  bool empty() const;
+  // Heap bytes used by the encoded postings and block headers.
+  size_t GetByteSize() const;
+
+  const std::vector<CompressedPostingBlock> &GetBlocks() const;
+  const std::vector<uint8_t> &GetDeltas() const;
+  const std::vector<uint8_t> &GetCodes() const;
+  const std::vector<double> &GetTermFreqs() const;
+
+private:
+  std::vector<CompressedPostingBlock> blocks_;
+  std::vector<uint8_t> deltas_;
+  std::vector<uint8_t> codes_;
+  // Distinct term frequencies, in ascending order.
+  std::vector<double> term_freqs_;
+  size_t size_ = 0;
+};
+
+// Name of the delta decoding kernel picked for this CPU: "avx2", "sse4.1"
+// or "scalar".
+const char *GetPostingDecoderName();
+
+template <typename Callback>
+void CompressedPostingView::ForEach(Callback callback) const {
+  int ordinals[BLOCK_SIZE];
+  double term_freqs[BLOCK_SIZE];
+  for (size_t block = 0; block < block_count_; ++block) {
+    const size_t count = DecodeBlock(block, ordinals, term_freqs);
+    for (size_t i = 0; i < count; ++i) {
+      callback(ordinals[i], term_freqs[i]);
+    }
+  }
+}
@@ -1,55 +1,322 @@
 #pragma once
 
 #include <algorithm>
-#include <cstdlib>
-#include <future>
+#include <atomic>
+#include <cstdint>
+#include <execution>
+#include <functional>
 #include <map>
+#include <mutex>
 #include <numeric>
-#include <random>
-#include <string>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
-#include <mutex>
-#include <string>
 
-
-template <typename Key, typename Value> class ConcurrentMap {
+// Test-and-test-and-set lock for buckets whose critical sections are a few
+// instructions long; spinning there is cheaper than parking the thread.
+class SpinLock {
 public:
-    static_assert(std::is_integral_v<Key>,
-        "ConcurrentMap supports only integer keys");
+    void lock() {
+        while (true) {
+            if (!locked_.exchange(true, std::memory_order_acquire)) {
+                return;
+            }
+            for (int spin = 0; locked_.load(std::memory_order_relaxed); ++spin) {
+                if (spin >= 64) {
+                    std::this_thread::yield();
+                    spin = 0;
+                }
+            }
+        }
+    }
+
+    bool try_lock() {
+        return !locked_.load(std::memory_order_relaxed) &&
+               !locked_.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock() { locked_.store(false, std::memory_order_release); }
 
-    struct Bucket {
-        std::map<Key, Value> map_bucket;
-        std::mutex mutex_bucket;
+private:
+    std::atomic<bool> locked_{false};
+};
+
+// Hash map split into independently locked buckets. Each bucket is a small
+// open-addressing (linear probing) table and is padded to its own cache line,
+// so threads working on different buckets never share a line. Lock may be
+// std::mutex, SpinLock or a shared mutex; with the latter, lookups and
+// snapshots take the bucket in shared mode.
+template <typename Key, typename Value, typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>,
+          typename Lock = std::shared_mutex>
+class ConcurrentMap {
+private:
+    template <typename L, typename = void>
+    struct IsSharedLockable : std::false_type {};
+    template <typename L>
+    struct IsSharedLockable<
+        L, std::void_t<decltype(std::declval<L &>().lock_shared())>>
+        : std::true_type {};
+
+    using WriteGuard = std::unique_lock<Lock>;
+    using ReadGuard = std::conditional_t<IsSharedLockable<Lock>::value,
+                                         std::shared_lock<Lock>,
+                                         std::unique_lock<Lock>>;
+
+    struct Slot {
+        size_t hash = 0;
+        std::optional<std::pair<Key, Value>> entry;
+    };
+
+    struct alignas(64) Bucket {
+        mutable Lock lock;
+        std::vector<Slot> slots;  // capacity is zero or a power of two
+        size_t size = 0;
     };
 
+public:
     struct Access {
-        std::lock_guard<std::mutex> guard;
-        Value& ref_to_value;
+        WriteGuard guard;
+        Value &ref_to_value;
 
-        Access(Bucket& bucket, const Key& key)
-            : guard(bucket.mutex_bucket), ref_to_value(bucket.map_bucket[key]) {}
+        Access(WriteGuard guard, Value &value)
+            : guard(std::move(guard)), ref_to_value(value) {}
     };
 
-    explicit ConcurrentMap(size_t bucket_count)
-        : buckets(bucket_count) {}
+    explicit ConcurrentMap(size_t bucket_count, const Hash &hash = Hash(),
+                           const KeyEqual &key_equal = KeyEqual())
+        : buckets_(std::max<size_t>(bucket_count, 1)), hash_(hash),
+          key_equal_(key_equal) {}
 
-    Access operator[](const Key& key) {
-        size_t bucket_index = static_cast<size_t>(key) % buckets.size();
-        return Access(buckets[bucket_index], key);
+    // Locks the bucket of key for writing and returns its value, inserting a
+    // default-constructed one if the key is absent.
+    Access operator[](const Key &key) {
+        const size_t hash = GetHash(key);
+        Bucket &bucket = GetBucket(hash);
+        WriteGuard guard(bucket.lock);
+        return Access(std::move(guard), FindOrInsert(bucket, hash, key));
     }
 
-    std::map<Key, Value> BuildOrdinaryMap() {
+    std::optional<Value> Find(const Key &key) const {
+        const size_t hash = GetHash(key);
+        const Bucket &bucket = GetBucket(hash);
+        ReadGuard guard(bucket.lock);
+        const size_t slot = FindSlot(bucket, hash, key);
+        if (slot == NOT_FOUND) {
+            return std::nullopt;
+        }
+        return bucket.slots[slot].entry->second;
+    }
+
+    bool Erase(const Key &key) {
+        const size_t hash = GetHash(key);
+        Bucket &bucket = GetBucket(hash);
+        WriteGuard guard(bucket.lock);
+        const size_t slot = FindSlot(bucket, hash, key);
+        if (slot == NOT_FOUND) {
+            return false;
+        }
+        EraseSlot(bucket, slot);
+        return true;
+    }
+
+    size_t size() const {
+        size_t result = 0;
+        for (const Bucket &bucket : buckets_) {
+            ReadGuard guard(bucket.lock);
+            result += bucket.size;
+        }
+        return result;
+    }
+
+    size_t GetBucketCount() const { return buckets_.size(); }
+
+    // Copies all entries, reading the buckets in parallel. Every bucket is
+    // copied atomically, but writers may run between buckets.
+    template <typename ExecutionPolicy>
+    std::vector<std::pair<Key, Value>> BuildSnapshot(ExecutionPolicy policy) const {
+        std::vector<std::vector<std::pair<Key, Value>>> parts(buckets_.size());
+        std::transform(policy, buckets_.begin(), buckets_.end(), parts.begin(),
+            [](const Bucket &bucket) { return CopyBucket(bucket); });
+
+        std::vector<size_t> offsets(parts.size() + 1, 0);
+        for (size_t i = 0; i < parts.size(); ++i) {
+            offsets[i + 1] = offsets[i] + parts[i].size();
+        }
+        std::vector<std::pair<Key, Value>> snapshot(offsets.back());
+        std::vector<size_t> indices(parts.size());
+        std::iota(indices.begin(), indices.end(), 0);
+        std::for_each(policy, indices.begin(), indices.end(), [&](size_t i) {
+            std::move(parts[i].begin(), parts[i].end(),
+                      snapshot.begin() + offsets[i]);
+        });
+        return snapshot;
+    }
+
+    std::vector<std::pair<Key, Value>> BuildSnapshot() const {
+        return BuildSnapshot(std::execution::seq);
+    }
 
+    template <typename ExecutionPolicy>
+    std::map<Key, Value> BuildOrdinaryMap(ExecutionPolicy policy) const {
+        auto snapshot = BuildSnapshot(policy);
+        std::sort(policy, snapshot.begin(), snapshot.end(),
+            [](const auto &lhs, const auto &rhs) { return lhs.first < rhs.first; });
         std::map<Key, Value> result;
-        for (size_t i = 0; i < buckets.size(); ++i) {
-            std::lock_guard<std::mutex> quard(buckets[i].mutex_bucket);
-            result.insert(buckets[i].map_bucket.begin(), buckets[i].map_bucket.end());
+        for (auto &entry : snapshot) {
+            result.emplace_hint(result.end(), std::move(entry));
         }
         return result;
     }
 
+    std::map<Key, Value> BuildOrdinaryMap() const {
+        return BuildOrdinaryMap(std::execution::seq);
+    }
+
+    // Folds other into this map: absent keys are copied, present ones are
+    // combined with combine(Value &target, const Value &source). Buckets of
+    // other are processed in parallel; no two locks are held at once, so
+    // concurrent merges in both directions cannot deadlock.
+    template <typename ExecutionPolicy, typename Combine>
+    void Merge(ExecutionPolicy policy, const ConcurrentMap &other,
+               Combine combine) {
+        std::for_each(policy, other.buckets_.begin(), other.buckets_.end(),
+            [&](const Bucket &source) {
+                for (const auto &[key, value] : CopyBucket(source)) {
+                    const size_t hash = GetHash(key);
+                    Bucket &bucket = GetBucket(hash);
+                    WriteGuard guard(bucket.lock);
+                    const size_t slot = FindSlot(bucket, hash, key);
+                    if (slot == NOT_FOUND) {
+                        InsertNew(bucket, hash, key, value);
+                    } else {
+                        combine(bucket.slots[slot].entry->second, value);
+                    }
+                }
+            });
+    }
+
 private:
-    std::vector<Bucket> buckets;
- };
+    static constexpr size_t NOT_FOUND = static_cast<size_t>(-1);
+    static constexpr size_t MIN_CAPACITY = 8;
+
+    std::vector<Bucket> buckets_;
+    Hash hash_;
+    KeyEqual key_equal_;
+
+    size_t GetHash(const Key &key) const {
+        // std::hash of integers is the identity; mix the bits so that both
+        // the bucket index and the probe start are well distributed.
+        uint64_t x = static_cast<uint64_t>(hash_(key));
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return static_cast<size_t>(x);
+    }
+
+    Bucket &GetBucket(size_t hash) { return buckets_[hash % buckets_.size()]; }
+    const Bucket &GetBucket(size_t hash) const {
+        return buckets_[hash % buckets_.size()];
+    }
+
+    // The low bits choose the bucket, so probing starts from the high ones.
+    // Shifts are expressed in halves of size_t to stay defined on 32-bit
+    // targets.
+    static size_t GetHomeSlot(const Bucket &bucket, size_t hash) {
+        constexpr size_t HALF_BITS = sizeof(size_t) * 4;
+        return (hash >> HALF_BITS ^ hash >> HALF_BITS / 2) &
+               (bucket.slots.size() - 1);
+    }
 
+    size_t FindSlot(const Bucket &bucket, size_t hash, const Key &key) const {
+        if (bucket.size == 0) {
+            return NOT_FOUND;
+        }
+        const size_t mask = bucket.slots.size() - 1;
+        for (size_t i = GetHomeSlot(bucket, hash);; i = (i + 1) & mask) {
+            const Slot &slot = bucket.slots[i];
+            if (!slot.entry) {
+                return NOT_FOUND;
+            }
+            if (slot.hash == hash && key_equal_(slot.entry->first, key)) {
+                return i;
+            }
+        }
+    }
 
+    Value &FindOrInsert(Bucket &bucket, size_t hash, const Key &key) {
+        const size_t slot = FindSlot(bucket, hash, key);
+        if (slot != NOT_FOUND) {
+            return bucket.slots[slot].entry->second;
+        }
+        return InsertNew(bucket, hash, key, Value());
+    }
+
+    Value &InsertNew(Bucket &bucket, size_t hash, const Key &key, Value value) {
+        // Keep the load factor at or below 3/4.
+        if ((bucket.size + 1) * 4 > bucket.slots.size() * 3) {
+            Rehash(bucket, std::max(MIN_CAPACITY, bucket.slots.size() * 2));
+        }
+        const size_t index = PlaceSlot(bucket, hash);
+        Slot &slot = bucket.slots[index];
+        slot.hash = hash;
+        slot.entry.emplace(key, std::move(value));
+        ++bucket.size;
+        return slot.entry->second;
+    }
+
+    static size_t PlaceSlot(const Bucket &bucket, size_t hash) {
+        const size_t mask = bucket.slots.size() - 1;
+        size_t i = GetHomeSlot(bucket, hash);
+        while (bucket.slots[i].entry) {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+
+    static void Rehash(Bucket &bucket, size_t capacity) {
+        std::vector<Slot> old_slots(capacity);
+        old_slots.swap(bucket.slots);
+        for (Slot &slot : old_slots) {
+            if (slot.entry) {
+                bucket.slots[PlaceSlot(bucket, slot.hash)] = std::move(slot);
+            }
+        }
+    }
+
+    // Backward-shift deletion: entries after the hole that may live in it
+    // are moved back, so lookups never need tombstones.
+    static void EraseSlot(Bucket &bucket, size_t hole) {
+        const size_t mask = bucket.slots.size() - 1;
+        for (size_t i = (hole + 1) & mask; bucket.slots[i].entry;
+             i = (i + 1) & mask) {
+            const size_t home = GetHomeSlot(bucket, bucket.slots[i].hash);
+            // Whether home lies cyclically in (hole, i].
+            const bool stays = hole <= i ? hole < home && home <= i
+                                         : hole < home || home <= i;
+            if (!stays) {
+                bucket.slots[hole] = std::move(bucket.slots[i]);
+                hole = i;
+            }
+        }
+        bucket.slots[hole].entry.reset();
+        --bucket.size;
+    }
+
+    static std::vector<std::pair<Key, Value>> CopyBucket(const Bucket &bucket) {
+        ReadGuard guard(bucket.lock);
+        std::vector<std::pair<Key, Value>> entries;
+        entries.reserve(bucket.size);
+        for (const Slot &slot : bucket.slots) {
+            if (slot.entry) {
+                entries.push_back(*slot.entry);
+            }
+        }
+        return entries;
+    }
+};
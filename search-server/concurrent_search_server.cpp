@@ -0,0 +1,137 @@
+#include "concurrent_search_server.h"
+
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <typeinfo>
+
+using namespace std;
+
+namespace {
+
+// Type and message of the exception, empty if there is none.
+string DescribeError(const exception_ptr &error) {
+  if (!error) {
+    return {};
+  }
+  try {
+    rethrow_exception(error);
+  } catch (const exception &e) {
+    return typeid(e).name() + ": "s + e.what();
+  } catch (...) {
+    return "unknown exception"s;
+  }
+}
+
+} // namespace
+
+ConcurrentSearchServer::ConcurrentSearchServer(const string_view &stop_words_text)
+    : replicas_{SearchServer(stop_words_text), SearchServer(stop_words_text)} {}
+
+ConcurrentSearchServer::ConcurrentSearchServer(const string &stop_words_text)
+    : ConcurrentSearchServer(string_view(stop_words_text)) {}
+
+ConcurrentSearchServer::ReadHandle::ReadHandle(ReadHandle &&other) noexcept
+    : slot_(other.slot_), server_(other.server_) {
+  other.slot_ = nullptr;
+}
+
+ConcurrentSearchServer::ReadHandle::~ReadHandle() {
+  if (slot_ != nullptr) {
+    slot_->store(IDLE, memory_order_release);
+  }
+}
+
+ConcurrentSearchServer::ReadHandle ConcurrentSearchServer::Pin() const {
+  // Threads start probing at different slots, so concurrent readers rarely
+  // meet on one.
+  thread_local const size_t home =
+      hash<thread::id>()(this_thread::get_id()) % READER_SLOT_COUNT;
+  size_t i = home;
+  int replica = published_.load();
+  while (true) {
+    int expected = IDLE;
+    if (reader_slots_[i].replica.compare_exchange_strong(expected, replica)) {
+      break;
+    }
+    i = (i + 1) % READER_SLOT_COUNT;
+    if (i == home) {
+      this_thread::yield();
+    }
+  }
+  // The writer that published another replica in the meantime may not have
+  // seen this slot; pin again until the announcement is current.
+  auto &slot = reader_slots_[i].replica;
+  for (int published = published_.load(); published != replica;
+       published = published_.load()) {
+    replica = published;
+    slot.store(replica);
+  }
+  return ReadHandle(&slot, &replicas_[replica]);
+}
+
+vector<Document>
+ConcurrentSearchServer::FindTopDocuments(string_view raw_query,
+                                         DocumentStatus status,
+                                         size_t max_result_count) const {
+  return Pin()->FindTopDocuments(raw_query, status, max_result_count);
+}
+
+vector<Document>
+ConcurrentSearchServer::FindTopDocuments(string_view raw_query) const {
+  return Pin()->FindTopDocuments(raw_query);
+}
+
+SearchServer::OwnedMatchedResult
+ConcurrentSearchServer::MatchDocument(string_view raw_query,
+                                      int document_id) const {
+  const auto version = Pin();
+  const auto [words, status] = version->MatchDocument(raw_query, document_id);
+  return {vector<string>(words.begin(), words.end()), status};
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+  return Pin()->GetDocumentCount();
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, string_view document,
+                                         DocumentStatus status,
+                                         const vector<int> &ratings) {
+  Write([&](SearchServer &server) {
+    server.AddDocument(document_id, document, status, ratings);
+  });
+}
+
+void ConcurrentSearchServer::AddDocuments(const vector<NewDocument> &documents) {
+  Write([&](SearchServer &server) { server.AddDocuments(documents); });
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+  Write([&](SearchServer &server) { server.RemoveDocument(document_id); });
+}
+
+void ConcurrentSearchServer::RemoveDocuments(const vector<int> &document_ids) {
+  Write([&](SearchServer &server) { server.RemoveDocuments(document_ids); });
+}
+
+void ConcurrentSearchServer::WaitForReaders(int replica) const {
+  for (const ReaderSlot &slot : reader_slots_) {
+    while (slot.replica.load() == replica) {
+      this_thread::yield();
+    }
+  }
+}
+
+void ConcurrentSearchServer::CheckNotDiverged() const {
+  if (diverged_) {
+    throw runtime_error("Replicas of ConcurrentSearchServer have diverged"s);
+  }
+}
+
+void ConcurrentSearchServer::CompareOutcomes(const exception_ptr &standby_error,
+                                             const exception_ptr &error) {
+  if (DescribeError(standby_error) != DescribeError(error)) {
+    diverged_ = true;
+    CheckNotDiverged();
+  }
+}
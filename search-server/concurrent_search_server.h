@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+// SearchServer that serves queries while it is being modified. Two replicas
+// of the index are kept: readers pin the published one without locking,
+// writers change the other one, publish it atomically, wait until the
+// readers of the previous version drain and then apply the same change to
+// it. Readers never wait for writers; writers are serialized and wait only
+// for readers that pinned the version they are about to reuse. The price is
+// twice the memory and every mutation being applied twice.
+class ConcurrentSearchServer {
+public:
+  template <typename StringContainer>
+  explicit ConcurrentSearchServer(const StringContainer &stop_words);
+  explicit ConcurrentSearchServer(const std::string_view &stop_words_text);
+  explicit ConcurrentSearchServer(const std::string &stop_words_text);
+
+  ConcurrentSearchServer(const ConcurrentSearchServer &) = delete;
+  ConcurrentSearchServer &operator=(const ConcurrentSearchServer &) = delete;
+
+  // A pinned index version; it does not change while the handle lives.
+  // Writers cannot finish while a handle to the version they replace lives,
+  // so handles are meant to be short-lived.
+  class ReadHandle {
+  public:
+    ReadHandle(ReadHandle &&other) noexcept;
+    ReadHandle &operator=(ReadHandle &&) = delete;
+    ~ReadHandle();
+
+    const SearchServer &operator*() const { return *server_; }
+    const SearchServer *operator->() const { return server_; }
+
+  private:
+    friend class ConcurrentSearchServer;
+
+    ReadHandle(std::atomic<int> *slot, const SearchServer *server)
+        : slot_(slot), server_(server) {}
+
+    std::atomic<int> *slot_;
+    const SearchServer *server_;
+  };
+
+  ReadHandle Pin() const;
+
+  template <typename DocumentPredicate>
+  std::vector<Document>
+  FindTopDocuments(std::string_view raw_query,
+                   DocumentPredicate document_predicate,
+                   size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+  std::vector<Document>
+  FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                   size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+  std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+  // The words are copied: a writer may free the terms of the pinned
+  // version as soon as the call returns.
+  SearchServer::OwnedMatchedResult MatchDocument(std::string_view raw_query,
+                                                 int document_id) const;
+  int GetDocumentCount() const;
+
+  // Same results and exceptions as the SearchServer methods; a change
+  // becomes visible to readers atomically. If the two replicas end a change
+  // differently (one throws, e.g. std::bad_alloc, and the other does not,
+  // or they throw different errors), they no longer hold the same index:
+  // the server then refuses that and every later change with
+  // std::runtime_error, while readers keep the published replica.
+  void AddDocument(int document_id, std::string_view document,
+                   DocumentStatus status, const std::vector<int> &ratings);
+  void AddDocuments(const std::vector<NewDocument> &documents);
+  void RemoveDocument(int document_id);
+  void RemoveDocuments(const std::vector<int> &document_ids);
+
+private:
+  static constexpr int READER_SLOT_COUNT = 128;
+  static constexpr int IDLE = -1;
+
+  // Each slot holds the replica pinned by one reader, or IDLE.
+  struct alignas(64) ReaderSlot {
+    std::atomic<int> replica{IDLE};
+  };
+
+  SearchServer replicas_[2];
+  std::atomic<int> published_{0};
+  mutable ReaderSlot reader_slots_[READER_SLOT_COUNT];
+  std::mutex writer_mutex_;
+  // Set once the replicas have diverged; guarded by writer_mutex_.
+  bool diverged_ = false;
+
+  template <typename Mutation> void Write(Mutation mutation);
+  void WaitForReaders(int replica) const;
+  void CheckNotDiverged() const;
+  // Marks the server diverged and throws unless both replicas ended the
+  // change the same way.
+  void CompareOutcomes(const std::exception_ptr &standby_error,
+                       const std::exception_ptr &error);
+};
+
+template <typename StringContainer>
+ConcurrentSearchServer::ConcurrentSearchServer(const StringContainer &stop_words)
+    : replicas_{SearchServer(stop_words), SearchServer(stop_words)} {}
+
+template <typename DocumentPredicate>
+std::vector<Document> ConcurrentSearchServer::FindTopDocuments(
+    std::string_view raw_query, DocumentPredicate document_predicate,
+    size_t max_result_count) const {
+  return Pin()->FindTopDocuments(raw_query, document_predicate,
+                                 max_result_count);
+}
+
+template <typename Mutation>
+void ConcurrentSearchServer::Write(Mutation mutation) {
+  std::lock_guard guard(writer_mutex_);
+  CheckNotDiverged();
+  const int published = published_.load();
+  const int standby = 1 - published;
+
+  // A rejected change may still have been applied in part (AddDocuments
+  // keeps the documents before the rejected one), so both replicas go
+  // through it and the exception is rethrown afterwards.
+  std::exception_ptr standby_error;
+  try {
+    mutation(replicas_[standby]);
+  } catch (...) {
+    standby_error = std::current_exception();
+  }
+  published_.store(standby);
+  WaitForReaders(published);
+  std::exception_ptr error;
+  try {
+    mutation(replicas_[published]);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  CompareOutcomes(standby_error, error);
+  if (standby_error) {
+    std::rethrow_exception(standby_error);
+  }
+}
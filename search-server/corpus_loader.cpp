@@ -0,0 +1,252 @@
+#include "corpus_loader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <exception>
+#include <execution>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "mapped_file.h"
+
+using namespace std;
+
+namespace {
+
+struct Chunk {
+  size_t begin;
+  size_t end;
+};
+
+// Parsed documents of one chunk; on a malformed line, the documents before
+// it and the error. The documents are tokenized by the parser as well.
+struct ParsedChunk {
+  vector<NewDocument> documents;
+  SearchServer::TokenizedBatch tokenized;
+  exception_ptr error;
+};
+
+vector<Chunk> SplitIntoChunks(string_view data, size_t chunk_size) {
+  vector<Chunk> chunks;
+  size_t begin = 0;
+  while (begin < data.size()) {
+    size_t end = min(data.size(), begin + max<size_t>(chunk_size, 1));
+    if (end < data.size()) {
+      const size_t line_end = data.find('\n', end - 1);
+      end = line_end == string_view::npos ? data.size() : line_end + 1;
+    }
+    chunks.push_back({begin, end});
+    begin = end;
+  }
+  return chunks;
+}
+
+string_view NextField(string_view &line) {
+  const size_t tab = line.find('\t');
+  if (tab == string_view::npos) {
+    throw invalid_argument("missing field");
+  }
+  const string_view field = line.substr(0, tab);
+  line.remove_prefix(tab + 1);
+  return field;
+}
+
+int ParseInt(string_view text) {
+  int value = 0;
+  const auto [end, error] =
+      from_chars(text.data(), text.data() + text.size(), value);
+  if (error != errc() || end != text.data() + text.size()) {
+    throw invalid_argument("not an integer");
+  }
+  return value;
+}
+
+DocumentStatus ParseStatus(string_view text) {
+  static const pair<string_view, DocumentStatus> STATUSES[] = {
+      {"ACTUAL"sv, DocumentStatus::ACTUAL},
+      {"IRRELEVANT"sv, DocumentStatus::IRRELEVANT},
+      {"BANNED"sv, DocumentStatus::BANNED},
+      {"REMOVED"sv, DocumentStatus::REMOVED},
+  };
+  for (const auto &[name, status] : STATUSES) {
+    if (text == name) {
+      return status;
+    }
+  }
+  const int number = ParseInt(text);
+  if (number < 0 || number > static_cast<int>(DocumentStatus::REMOVED)) {
+    throw invalid_argument("unknown status");
+  }
+  return static_cast<DocumentStatus>(number);
+}
+
+NewDocument ParseLine(string_view line) {
+  NewDocument document;
+  document.id = ParseInt(NextField(line));
+  document.status = ParseStatus(NextField(line));
+  string_view ratings = NextField(line);
+  while (!ratings.empty()) {
+    const size_t space = min(ratings.find(' '), ratings.size());
+    if (space > 0) {
+      document.ratings.push_back(ParseInt(ratings.substr(0, space)));
+    }
+    ratings.remove_prefix(min(space + 1, ratings.size()));
+  }
+  document.text = line;
+  return document;
+}
+
+ParsedChunk ParseChunk(string_view data, Chunk chunk) {
+  ParsedChunk result;
+  size_t begin = chunk.begin;
+  while (begin < chunk.end) {
+    size_t end = data.find('\n', begin);
+    end = end == string_view::npos || end > chunk.end ? chunk.end : end;
+    string_view line = data.substr(begin, end - begin);
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    if (!line.empty()) {
+      try {
+        result.documents.push_back(ParseLine(line));
+      } catch (const invalid_argument &error) {
+        // Line numbers are only counted on this path.
+        const size_t line_number =
+            count(data.begin(), data.begin() + begin, '\n') + 1;
+        result.error = make_exception_ptr(
+            runtime_error("Malformed corpus line "s + to_string(line_number) +
+                          ": "s + error.what()));
+        return result;
+      }
+    }
+    begin = end + 1;
+  }
+  return result;
+}
+
+} // namespace
+
+size_t LoadCorpus(const string &path, SearchServer &server,
+                  const CorpusLoadOptions &options) {
+  const MappedFile file(path);
+  const string_view data(file.data(), file.size());
+  const vector<Chunk> chunks = SplitIntoChunks(data, options.chunk_size);
+  const size_t max_pending = max<size_t>(options.max_pending_chunks, 1);
+  const size_t parser_count =
+      min(chunks.size(),
+          options.parser_count > 0
+              ? options.parser_count
+              : max<size_t>(thread::hardware_concurrency(), 1));
+
+  mutex pipeline_mutex;
+  condition_variable chunk_parsed;
+  condition_variable chunk_indexed;
+  map<size_t, ParsedChunk> parsed;
+  size_t next_to_index = 0;
+  bool stopping = false;
+  // First failure of a parser thread other than a malformed line, e.g.
+  // bad_alloc; it stops the pipeline and is rethrown by the calling thread.
+  exception_ptr parser_error;
+  atomic<size_t> next_to_parse = 0;
+
+  const auto parse_chunks = [&] {
+    while (true) {
+      const size_t i = next_to_parse++;
+      if (i >= chunks.size()) {
+        return;
+      }
+      {
+        unique_lock lock(pipeline_mutex);
+        chunk_indexed.wait(lock, [&] {
+          return stopping || i < next_to_index + max_pending;
+        });
+        if (stopping) {
+          return;
+        }
+      }
+      // Let the kernel read the following chunks while this one is parsed.
+      if (i + parser_count < chunks.size()) {
+        const Chunk &ahead = chunks[i + parser_count];
+        file.Prefetch(ahead.begin, ahead.end - ahead.begin);
+      }
+      ParsedChunk chunk = ParseChunk(data, chunks[i]);
+      // Tokenizing reads only the stop words, so it runs here while the
+      // calling thread indexes earlier chunks.
+      chunk.tokenized =
+          server.TokenizeDocuments(execution::seq, chunk.documents);
+      {
+        lock_guard guard(pipeline_mutex);
+        parsed.emplace(i, move(chunk));
+      }
+      chunk_parsed.notify_one();
+    }
+  };
+  const auto parse = [&] {
+    try {
+      parse_chunks();
+    } catch (...) {
+      {
+        lock_guard guard(pipeline_mutex);
+        if (!parser_error) {
+          parser_error = current_exception();
+        }
+        stopping = true;
+      }
+      chunk_indexed.notify_all();
+      chunk_parsed.notify_all();
+    }
+  };
+
+  if (!chunks.empty()) {
+    file.Prefetch(chunks.front().begin, chunks.front().end);
+  }
+  vector<thread> parsers;
+  for (size_t i = 0; i < parser_count; ++i) {
+    parsers.emplace_back(parse);
+  }
+  const auto stop_parsers = [&] {
+    {
+      lock_guard guard(pipeline_mutex);
+      stopping = true;
+    }
+    chunk_indexed.notify_all();
+    for (auto &parser : parsers) {
+      parser.join();
+    }
+  };
+
+  size_t document_count = 0;
+  try {
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      ParsedChunk chunk;
+      {
+        unique_lock lock(pipeline_mutex);
+        chunk_parsed.wait(lock,
+                          [&] { return parser_error || parsed.count(i) > 0; });
+        if (parser_error) {
+          rethrow_exception(parser_error);
+        }
+        auto it = parsed.find(i);
+        chunk = move(it->second);
+        parsed.erase(it);
+        next_to_index = i + 1;
+      }
+      chunk_indexed.notify_all();
+      server.AddDocuments(chunk.documents, chunk.tokenized);
+      document_count += chunk.documents.size();
+      if (chunk.error) {
+        rethrow_exception(chunk.error);
+      }
+    }
+  } catch (...) {
+    stop_parsers();
+    throw;
+  }
+  stop_parsers();
+  return document_count;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "search_server.h"
+
+struct CorpusLoadOptions {
+  // Bytes of the file parsed as one batch; cut at line ends.
+  size_t chunk_size = 4 << 20;
+  // Parsed batches allowed to wait for the indexer. Parsers stop when the
+  // indexer falls this far behind, which bounds the memory in flight.
+  size_t max_pending_chunks = 4;
+  // 0 stands for the number of hardware threads.
+  size_t parser_count = 0;
+};
+
+// Adds the documents of a corpus file to server, one per line:
+//   id <TAB> status <TAB> ratings <TAB> text
+// status is a DocumentStatus name (ACTUAL, IRRELEVANT, BANNED, REMOVED) or
+// number, ratings are space-separated integers and may be empty. Empty lines
+// are skipped; CRLF line ends are accepted.
+//
+// The file is memory-mapped and cut into chunks. Parser threads turn chunks
+// into batches of NewDocument whose texts point into the mapping, so a text
+// is never copied, and tokenize them; the calling thread indexes the
+// tokenized batches in file order with AddDocuments. Returns the number of
+// documents added.
+//
+// Documents before a malformed line (std::runtime_error naming the line) or
+// a rejected document (std::invalid_argument from AddDocuments) are added.
+// Any other failure of a parser thread stops the pipeline and is rethrown
+// here once the parsers are joined.
+size_t LoadCorpus(const std::string &path, SearchServer &server,
+                  const CorpusLoadOptions &options = {});
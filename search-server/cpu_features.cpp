@@ -0,0 +1,47 @@
+#include "cpu_features.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||           \
+    defined(_M_IX86)
+#define CPU_FEATURES_X86 1
+#if defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+
+CpuFeatures DetectCpuFeatures() {
+  CpuFeatures features;
+#ifdef CPU_FEATURES_X86
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  const int max_leaf = info[0];
+  __cpuid(info, 1);
+  features.sse2 = (info[3] & (1 << 26)) != 0;
+  features.sse41 = (info[2] & (1 << 19)) != 0;
+  // AVX registers are usable only if the OS saves them on context switches.
+  const bool os_saves_ymm = (info[2] & (1 << 27)) != 0 &&
+                            (info[2] & (1 << 28)) != 0 &&
+                            (_xgetbv(0) & 6) == 6;
+  if (max_leaf >= 7 && os_saves_ymm) {
+    __cpuidex(info, 7, 0);
+    features.avx2 = (info[1] & (1 << 5)) != 0;
+  }
+#else
+  __builtin_cpu_init();
+  features.sse2 = __builtin_cpu_supports("sse2");
+  features.sse41 = __builtin_cpu_supports("sse4.1");
+  features.avx2 = __builtin_cpu_supports("avx2");
+#endif
+#endif
+  return features;
+}
+
+} // namespace
+
+const CpuFeatures &GetCpuFeatures() {
+  static const CpuFeatures features = DetectCpuFeatures();
+  return features;
+}
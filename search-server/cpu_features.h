@@ -0,0 +1,12 @@
+#pragma once
+
+// Instruction set extensions the CPU and the operating system support, for
+// picking SIMD kernels at run time. All false on non-x86 targets.
+struct CpuFeatures {
+  bool sse2 = false;
+  bool sse41 = false;
+  bool avx2 = false;
+};
+
+// Detected on the first call; later calls return the same result.
+const CpuFeatures &GetCpuFeatures();
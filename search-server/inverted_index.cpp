@@ -0,0 +1,216 @@
+#include "inverted_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <numeric>
+
+using namespace std;
+
+string_view InvertedIndex::AddPosting(string_view word, int ordinal,
+                                      double term_freq) {
+  auto it = word_to_postings_.find(word);
+  if (word_to_postings_.end() == it) {
+    it = word_to_postings_.emplace(string(word), TermEntry()).first;
+  }
+  auto &entry = it->second;
+  auto &postings = entry.postings;
+  // Fresh ordinals are handed out in ascending order, so appending is the
+  // common case and keeps the list sorted without shifting.
+  if (postings.empty() || postings.back().ordinal < ordinal) {
+    postings.push_back({ordinal, term_freq});
+  } else {
+    auto pos = postings.begin() + (LowerBound(postings, ordinal) -
+                                   postings.cbegin());
+    if (postings.end() != pos && pos->ordinal == ordinal) {
+      const double old_term_freq = pos->term_freq;
+      pos->term_freq = term_freq;
+      if (old_term_freq == entry.max_term_freq) {
+        RefreshMaxTermFreq(entry);
+      }
+    } else {
+      postings.insert(pos, {ordinal, term_freq});
+    }
+  }
+  entry.max_term_freq = max(entry.max_term_freq, term_freq);
+  return it->first;
+}
+
+string_view InvertedIndex::AddPostings(string_view word,
+                                       const PostingList &postings) {
+  auto it = word_to_postings_.find(word);
+  if (word_to_postings_.end() == it) {
+    it = word_to_postings_.emplace(string(word), TermEntry()).first;
+  }
+  auto &entry = it->second;
+  const size_t old_size = entry.postings.size();
+  entry.postings.insert(entry.postings.end(), postings.begin(), postings.end());
+  // Recycled ordinals may be lower than the ones already listed.
+  if (old_size > 0 && !postings.empty() &&
+      entry.postings[old_size - 1].ordinal > postings.front().ordinal) {
+    inplace_merge(entry.postings.begin(), entry.postings.begin() + old_size,
+                  entry.postings.end(),
+                  [](const Posting &lhs, const Posting &rhs) {
+                    return lhs.ordinal < rhs.ordinal;
+                  });
+  }
+  for (const auto [_, term_freq] : postings) {
+    entry.max_term_freq = max(entry.max_term_freq, term_freq);
+  }
+  return it->first;
+}
+
+void InvertedIndex::RemovePosting(string_view word, int ordinal) {
+  auto it = word_to_postings_.find(word);
+  if (word_to_postings_.end() == it) {
+    return;
+  }
+  auto &entry = it->second;
+  auto &postings = entry.postings;
+  auto pos = postings.begin() +
+             (LowerBound(postings, ordinal) - postings.cbegin());
+  if (postings.end() != pos && pos->ordinal == ordinal) {
+    const double term_freq = pos->term_freq;
+    postings.erase(pos);
+    if (term_freq == entry.max_term_freq) {
+      RefreshMaxTermFreq(entry);
+    }
+  }
+  if (postings.empty()) {
+    word_to_postings_.erase(it);
+  }
+}
+
+void InvertedIndex::RemovePostings(vector<TermRemoval> removals) {
+  vector<decltype(word_to_postings_)::iterator> terms(removals.size());
+  transform(execution::par, removals.begin(), removals.end(), terms.begin(),
+            [this](const TermRemoval &removal) {
+              return word_to_postings_.find(removal.word);
+            });
+
+  vector<size_t> indices(removals.size());
+  iota(indices.begin(), indices.end(), 0);
+  for_each(execution::par, indices.begin(), indices.end(), [&](size_t i) {
+    if (word_to_postings_.end() == terms[i]) {
+      return;
+    }
+    auto &ordinals = removals[i].ordinals;
+    sort(ordinals.begin(), ordinals.end());
+    auto &entry = terms[i]->second;
+    bool removed_max = false;
+    auto removed = ordinals.begin();
+    auto kept = remove_if(
+        entry.postings.begin(), entry.postings.end(),
+        [&](const Posting &posting) {
+          while (ordinals.end() != removed && *removed < posting.ordinal) {
+            ++removed;
+          }
+          if (ordinals.end() == removed || *removed != posting.ordinal) {
+            return false;
+          }
+          removed_max |= posting.term_freq == entry.max_term_freq;
+          return true;
+        });
+    entry.postings.erase(kept, entry.postings.end());
+    if (removed_max) {
+      RefreshMaxTermFreq(entry);
+    }
+  });
+
+  // Erasing rebalances the tree, so it is done by one thread.
+  for (auto term : terms) {
+    if (word_to_postings_.end() != term && term->second.postings.empty()) {
+      word_to_postings_.erase(term);
+    }
+  }
+}
+
+const InvertedIndex::PostingList *
+InvertedIndex::FindPostings(string_view word) const {
+  auto it = word_to_postings_.find(word);
+  return word_to_postings_.end() == it ? nullptr : &it->second.postings;
+}
+
+InvertedIndex::TermStats InvertedIndex::FindTermStats(string_view word) const {
+  auto it = word_to_postings_.find(word);
+  if (word_to_postings_.end() == it) {
+    return {};
+  }
+  return {&it->second.postings, GetInverseDocumentFreq(it->second),
+          it->second.max_term_freq};
+}
+
+string_view InvertedIndex::FindTerm(string_view word) const {
+  auto it = word_to_postings_.find(word);
+  return word_to_postings_.end() == it ? string_view() : it->first;
+}
+
+bool InvertedIndex::Contains(string_view word, int ordinal) const {
+  const auto *postings = FindPostings(word);
+  return postings != nullptr && Contains(*postings, ordinal);
+}
+
+size_t InvertedIndex::GetDocumentFreq(string_view word) const {
+  const auto *postings = FindPostings(word);
+  return postings == nullptr ? 0 : postings->size();
+}
+
+double InvertedIndex::GetInverseDocumentFreq(string_view word) const {
+  auto it = word_to_postings_.find(word);
+  return word_to_postings_.end() == it ? 0.0
+                                        : GetInverseDocumentFreq(it->second);
+}
+
+size_t InvertedIndex::GetTermCount() const { return word_to_postings_.size(); }
+
+void InvertedIndex::SetDocumentCount(int document_count) {
+  document_count_ = document_count;
+  ++epoch_;
+}
+
+double InvertedIndex::GetInverseDocumentFreq(const TermEntry &entry) const {
+  if (entry.epoch.load(memory_order_acquire) == epoch_) {
+    return entry.inverse_document_freq.load(memory_order_relaxed);
+  }
+  // Concurrent readers may both get here; they store the same value.
+  const double inverse_document_freq =
+      log(document_count_ * 1.0 / entry.postings.size());
+  entry.inverse_document_freq.store(inverse_document_freq,
+                                    memory_order_relaxed);
+  entry.epoch.store(epoch_, memory_order_release);
+  return inverse_document_freq;
+}
+
+void InvertedIndex::RefreshMaxTermFreq(TermEntry &entry) {
+  entry.max_term_freq = 0.0;
+  for (const auto [_, term_freq] : entry.postings) {
+    entry.max_term_freq = max(entry.max_term_freq, term_freq);
+  }
+}
+
+InvertedIndex::TermEntry::TermEntry(const TermEntry &other)
+    : postings(other.postings), max_term_freq(other.max_term_freq),
+      inverse_document_freq(other.inverse_document_freq.load()),
+      epoch(other.epoch.load()) {}
+
+InvertedIndex::TermEntry &
+InvertedIndex::TermEntry::operator=(const TermEntry &other) {
+  postings = other.postings;
+  max_term_freq = other.max_term_freq;
+  inverse_document_freq = other.inverse_document_freq.load();
+  epoch = other.epoch.load();
+  return *this;
+}
+
+bool InvertedIndex::Contains(const PostingList &postings, int ordinal) {
+  auto pos = LowerBound(postings, ordinal);
+  return postings.end() != pos && pos->ordinal == ordinal;
+}
+
+InvertedIndex::PostingList::const_iterator
+InvertedIndex::LowerBound(const PostingList &postings, int ordinal) {
+  return lower_bound(postings.begin(), postings.end(), ordinal,
+                     [](const Posting &posting, int value) {
+                       return posting.ordinal < value;
+                     });
+}
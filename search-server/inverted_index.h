@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct Posting {
+  int ordinal;
+  double term_freq;
+};
+
+// Term -> contiguous posting list sorted by document ordinal. The index owns
+// the term strings, so views returned by it stay valid while the term has at
+// least one posting.
+class InvertedIndex {
+public:
+  using PostingList = std::vector<Posting>;
+
+  struct TermStats {
+    const PostingList *postings = nullptr;
+    double inverse_document_freq = 0.0;
+    // Largest term frequency in postings, bounds the term's contribution.
+    double max_term_freq = 0.0;
+  };
+
+  // Inserts (or overwrites) the posting of a document ordinal for word and
+  // returns the index-owned view of the word.
+  std::string_view AddPosting(std::string_view word, int ordinal,
+                              double term_freq);
+  // Adds postings of ordinals the word has none of yet; postings must be
+  // sorted by ordinal. Returns the index-owned view of the word.
+  std::string_view AddPostings(std::string_view word,
+                               const PostingList &postings);
+  // Drops the posting and forgets the term once its list becomes empty.
+  void RemovePosting(std::string_view word, int ordinal);
+
+  struct TermRemoval {
+    std::string_view word;
+    std::vector<int> ordinals;
+  };
+  // Drops the postings of many ordinals, touching each listed word's list
+  // once. Words must be distinct: their lists are then disjoint and are
+  // updated in parallel without locking. Emptied terms are forgotten
+  // afterwards, so views of them must not be used past the call.
+  void RemovePostings(std::vector<TermRemoval> removals);
+
+  const PostingList *FindPostings(std::string_view word) const;
+  // One lookup for both the postings and the IDF; postings is null if the
+  // word is unknown.
+  TermStats FindTermStats(std::string_view word) const;
+  // Returns the index-owned view of word or an empty view if it is unknown.
+  std::string_view FindTerm(std::string_view word) const;
+  bool Contains(std::string_view word, int ordinal) const;
+
+  size_t GetDocumentFreq(std::string_view word) const;
+  double GetInverseDocumentFreq(std::string_view word) const;
+  size_t GetTermCount() const;
+  // Calls callback(word, postings) for every term in word order.
+  template <typename Callback> void ForEachTerm(Callback callback) const;
+
+  // Must be called after every document insertion or removal. Cached IDF
+  // values are stamped with the epoch they were computed in and are lazily
+  // recomputed by the first query that sees them outdated.
+  void SetDocumentCount(int document_count);
+
+  static bool Contains(const PostingList &postings, int ordinal);
+
+private:
+  struct TermEntry {
+    PostingList postings;
+    double max_term_freq = 0.0;
+    mutable std::atomic<double> inverse_document_freq{0.0};
+    mutable std::atomic<uint64_t> epoch{0};
+
+    TermEntry() = default;
+    TermEntry(const TermEntry &other);
+    TermEntry &operator=(const TermEntry &other);
+  };
+
+  std::map<std::string, TermEntry, std::less<>> word_to_postings_;
+  int document_count_ = 0;
+  uint64_t epoch_ = 1;
+
+  double GetInverseDocumentFreq(const TermEntry &entry) const;
+  static void RefreshMaxTermFreq(TermEntry &entry);
+
+  static PostingList::const_iterator LowerBound(const PostingList &postings,
+                                                int ordinal);
+};
+
+template <typename Callback>
+void InvertedIndex::ForEachTerm(Callback callback) const {
+  for (const auto &[word, entry] : word_to_postings_) {
+    callback(std::string_view(word), entry.postings);
+  }
+}
@@ -0,0 +1,243 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+int FloorLog2(uint64_t value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return static_cast<int>(index);
+#else
+  return 63 - __builtin_clzll(value);
+#endif
+}
+
+// Histograms of one thread, allocated on the first record of each metric.
+struct ThreadHistograms {
+  array<atomic<LatencyHistogram *>, LatencyMetric::MAX_COUNT> histograms{};
+
+  ~ThreadHistograms() {
+    for (auto &histogram : histograms) {
+      delete histogram.load(memory_order_relaxed);
+    }
+  }
+};
+
+struct MergedHistogram {
+  LatencyHistogram::Counts counts{};
+  uint64_t max = 0;
+};
+
+LatencySnapshot MakeSnapshot(const MergedHistogram &merged) {
+  LatencySnapshot snapshot;
+  for (const uint64_t count : merged.counts) {
+    snapshot.count += count;
+  }
+  snapshot.max = merged.max;
+  const auto percentile = [&](double fraction) {
+    const uint64_t rank = max<uint64_t>(
+        static_cast<uint64_t>(ceil(fraction * snapshot.count)), 1);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < merged.counts.size(); ++bucket) {
+      seen += merged.counts[bucket];
+      if (seen >= rank) {
+        return min(LatencyHistogram::GetBucketUpperBound(bucket), merged.max);
+      }
+    }
+    return merged.max;
+  };
+  if (snapshot.count > 0) {
+    snapshot.p50 = percentile(0.5);
+    snapshot.p90 = percentile(0.9);
+    snapshot.p99 = percentile(0.99);
+  }
+  return snapshot;
+}
+
+// Names of the metrics and the histograms of every thread. Threads register
+// once, on their first record; when a thread exits, its counts move into
+// the histograms of finished threads.
+class LatencyRegistry {
+public:
+  size_t Register(string_view name) {
+    lock_guard guard(mutex_);
+    if (const auto it = ids_.find(name); it != ids_.end()) {
+      return it->second;
+    }
+    if (ids_.size() == LatencyMetric::MAX_COUNT) {
+      throw out_of_range("Too many latency metrics"s);
+    }
+    return ids_.emplace(string(name), ids_.size()).first->second;
+  }
+
+  void Attach(ThreadHistograms *thread) {
+    lock_guard guard(mutex_);
+    threads_.insert(thread);
+  }
+
+  void Detach(ThreadHistograms *thread) {
+    lock_guard guard(mutex_);
+    for (size_t id = 0; id < LatencyMetric::MAX_COUNT; ++id) {
+      if (const auto *histogram = thread->histograms[id].load(memory_order_acquire)) {
+        histogram->AddTo(finished_[id].counts, finished_[id].max);
+      }
+    }
+    threads_.erase(thread);
+  }
+
+  LatencySnapshot GetSnapshot(string_view name) const {
+    lock_guard guard(mutex_);
+    const auto it = ids_.find(name);
+    return it == ids_.end() ? LatencySnapshot{} : MakeSnapshot(Merge(it->second));
+  }
+
+  map<string, LatencySnapshot> GetSnapshots() const {
+    lock_guard guard(mutex_);
+    map<string, LatencySnapshot> snapshots;
+    for (const auto &[name, id] : ids_) {
+      snapshots.emplace(name, MakeSnapshot(Merge(id)));
+    }
+    return snapshots;
+  }
+
+  void Reset() {
+    lock_guard guard(mutex_);
+    for (ThreadHistograms *thread : threads_) {
+      for (auto &histogram : thread->histograms) {
+        if (auto *live = histogram.load(memory_order_acquire)) {
+          live->Reset();
+        }
+      }
+    }
+    fill(finished_.begin(), finished_.end(), MergedHistogram{});
+  }
+
+private:
+  mutable mutex mutex_;
+  map<string, size_t, less<>> ids_;
+  set<ThreadHistograms *> threads_;
+  vector<MergedHistogram> finished_ =
+      vector<MergedHistogram>(LatencyMetric::MAX_COUNT);
+
+  MergedHistogram Merge(size_t id) const {
+    MergedHistogram merged = finished_[id];
+    for (const ThreadHistograms *thread : threads_) {
+      if (const auto *histogram = thread->histograms[id].load(memory_order_acquire)) {
+        histogram->AddTo(merged.counts, merged.max);
+      }
+    }
+    return merged;
+  }
+};
+
+LatencyRegistry &GetRegistry() {
+  // Never destroyed: threads may still exit during static destruction.
+  static auto *registry = new LatencyRegistry;
+  return *registry;
+}
+
+class ThreadSlot {
+public:
+  ThreadHistograms &Get() {
+    if (!histograms_) {
+      histograms_ = make_unique<ThreadHistograms>();
+      GetRegistry().Attach(histograms_.get());
+    }
+    return *histograms_;
+  }
+
+  ~ThreadSlot() {
+    if (histograms_) {
+      GetRegistry().Detach(histograms_.get());
+    }
+  }
+
+private:
+  unique_ptr<ThreadHistograms> histograms_;
+};
+
+thread_local ThreadSlot thread_slot;
+
+} // namespace
+
+size_t LatencyHistogram::GetBucket(uint64_t nanoseconds) {
+  if (nanoseconds < SUB_BUCKET_COUNT) {
+    return static_cast<size_t>(nanoseconds);
+  }
+  const int shift = FloorLog2(nanoseconds) - static_cast<int>(SUB_BUCKET_BITS);
+  return SUB_BUCKET_COUNT * (shift + 1) +
+         static_cast<size_t>((nanoseconds >> shift) - SUB_BUCKET_COUNT);
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(size_t bucket) {
+  if (bucket < SUB_BUCKET_COUNT) {
+    return bucket;
+  }
+  const size_t shift = bucket / SUB_BUCKET_COUNT - 1;
+  const uint64_t lower = (SUB_BUCKET_COUNT + bucket % SUB_BUCKET_COUNT)
+                         << shift;
+  return lower + ((uint64_t{1} << shift) - 1);
+}
+
+void LatencyHistogram::Record(uint64_t nanoseconds) {
+  auto &count = counts_[GetBucket(nanoseconds)];
+  count.store(count.load(memory_order_relaxed) + 1, memory_order_relaxed);
+  if (nanoseconds > max_.load(memory_order_relaxed)) {
+    max_.store(nanoseconds, memory_order_relaxed);
+  }
+}
+
+void LatencyHistogram::AddTo(Counts &counts, uint64_t &max) const {
+  for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+    counts[bucket] += counts_[bucket].load(memory_order_relaxed);
+  }
+  max = std::max(max, max_.load(memory_order_relaxed));
+}
+
+void LatencyHistogram::Reset() {
+  for (auto &count : counts_) {
+    count.store(0, memory_order_relaxed);
+  }
+  max_.store(0, memory_order_relaxed);
+}
+
+LatencyMetric::LatencyMetric(string_view name)
+    : id_(GetRegistry().Register(name)) {}
+
+void SetLatencyRecording(bool enabled) {
+  latency_detail::recording_enabled.store(enabled, memory_order_relaxed);
+}
+
+void RecordLatency(const LatencyMetric &metric, chrono::nanoseconds duration) {
+  auto &slot = thread_slot.Get().histograms[metric.GetId()];
+  LatencyHistogram *histogram = slot.load(memory_order_relaxed);
+  if (histogram == nullptr) {
+    histogram = new LatencyHistogram;
+    slot.store(histogram, memory_order_release);
+  }
+  histogram->Record(static_cast<uint64_t>(max<int64_t>(duration.count(), 0)));
+}
+
+LatencySnapshot GetLatencySnapshot(string_view name) {
+  return GetRegistry().GetSnapshot(name);
+}
+
+map<string, LatencySnapshot> GetLatencySnapshots() {
+  return GetRegistry().GetSnapshots();
+}
+
+void ResetLatencyHistograms() { GetRegistry().Reset(); }
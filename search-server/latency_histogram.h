@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+// Latencies of one operation merged over all threads, in nanoseconds.
+// Percentiles are bucket upper bounds, at most 12.5% above the true value.
+struct LatencySnapshot {
+  uint64_t count = 0;
+  uint64_t p50 = 0;
+  uint64_t p90 = 0;
+  uint64_t p99 = 0;
+  uint64_t max = 0;
+};
+
+// Counts of latencies in log-linear buckets: exact below 8 ns, then eight
+// buckets per power of two. A histogram has a single writer, so recording
+// is a relaxed load and store of one counter, with no locked instruction;
+// any thread may read it meanwhile.
+class LatencyHistogram {
+public:
+  static constexpr size_t SUB_BUCKET_BITS = 3;
+  static constexpr size_t SUB_BUCKET_COUNT = size_t{1} << SUB_BUCKET_BITS;
+  static constexpr size_t BUCKET_COUNT =
+      SUB_BUCKET_COUNT * (64 - SUB_BUCKET_BITS + 1);
+
+  using Counts = std::array<uint64_t, BUCKET_COUNT>;
+
+  static size_t GetBucket(uint64_t nanoseconds);
+  // The largest latency that falls into bucket.
+  static uint64_t GetBucketUpperBound(size_t bucket);
+
+  // Only the owning thread records.
+  void Record(uint64_t nanoseconds);
+  // Adds the counts and the maximum recorded so far.
+  void AddTo(Counts &counts, uint64_t &max) const;
+  void Reset();
+
+private:
+  std::array<std::atomic<uint64_t>, BUCKET_COUNT> counts_{};
+  std::atomic<uint64_t> max_ = 0;
+};
+
+// A named operation to record latencies of, e.g. "parse" or "score".
+// Metrics of the same name share their histograms. Registering takes a lock,
+// so a metric is best kept in a static:
+//   static const LatencyMetric PARSE("parse"s);
+class LatencyMetric {
+public:
+  static constexpr size_t MAX_COUNT = 64;
+
+  // Throws std::out_of_range when MAX_COUNT names are taken.
+  explicit LatencyMetric(std::string_view name);
+
+  size_t GetId() const { return id_; }
+
+private:
+  size_t id_;
+};
+
+namespace latency_detail {
+inline std::atomic<bool> recording_enabled = false;
+}
+
+// Off by default; ScopedLatency then neither reads the clock nor records.
+void SetLatencyRecording(bool enabled);
+
+inline bool IsLatencyRecordingEnabled() {
+  return latency_detail::recording_enabled.load(std::memory_order_relaxed);
+}
+
+// Records into the calling thread's histogram of metric, whether or not
+// recording is enabled.
+void RecordLatency(const LatencyMetric &metric, std::chrono::nanoseconds duration);
+
+// Records the lifetime of the scope when recording is enabled at its start.
+class ScopedLatency {
+public:
+  explicit ScopedLatency(const LatencyMetric &metric)
+      : metric_(metric), enabled_(IsLatencyRecordingEnabled()) {
+    if (enabled_) {
+      start_time_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~ScopedLatency() {
+    if (enabled_) {
+      RecordLatency(metric_, std::chrono::steady_clock::now() - start_time_);
+    }
+  }
+
+  ScopedLatency(const ScopedLatency &) = delete;
+  ScopedLatency &operator=(const ScopedLatency &) = delete;
+
+private:
+  const LatencyMetric &metric_;
+  const bool enabled_;
+  std::chrono::steady_clock::time_point start_time_;
+};
+
+// Merges the histograms of all threads, including the finished ones.
+// An unknown name gives an empty snapshot.
+LatencySnapshot GetLatencySnapshot(std::string_view name);
+// Snapshots of every registered metric, by name.
+std::map<std::string, LatencySnapshot> GetLatencySnapshots();
+// Empties every histogram. Latencies recorded meanwhile may survive it, so
+// it is best called with recording disabled.
+void ResetLatencyHistograms();
@@ -1,11 +1,46 @@
 #include "log_duration.h"
 
+#include <atomic>
+#include <map>
+#include <stdexcept>
+
 using namespace std;
 using Clock = std::chrono::steady_clock;
 
+static atomic<LogDuration::Output> log_duration_output =
+    LogDuration::Output::PRINT;
+
+namespace {
+
+// The metric of name, registered once per thread and name so that later
+// scopes take no lock. Only registered metrics are cached, which bounds the
+// cache by LatencyMetric::MAX_COUNT; empty if every metric id is taken.
+optional<LatencyMetric> FindMetric(const string &name) {
+  thread_local map<string, LatencyMetric, less<>> metrics;
+  if (const auto it = metrics.find(name); it != metrics.end()) {
+    return it->second;
+  }
+  try {
+    return metrics.emplace(name, LatencyMetric(name)).first->second;
+  } catch (const out_of_range &) {
+    return nullopt;
+  }
+}
+
+} // namespace
+
 LogDuration::LogDuration(string _operation_name, ostream &_out_stream)
     : start_time_(Clock::now()), operation_name(_operation_name),
-      out_stream(_out_stream) {}
+      out_stream(_out_stream) {
+  if (log_duration_output.load(memory_order_relaxed) == Output::RECORD) {
+    if (IsLatencyRecordingEnabled()) {
+      metric_ = FindMetric(operation_name);
+      print_ = !metric_;
+    } else {
+      print_ = false;
+    }
+  }
+}
 
 LogDuration::~LogDuration() {
   using namespace std::chrono;
@@ -13,6 +48,22 @@ LogDuration::~LogDuration() {
 
   const auto end_time = Clock::now();
   const auto dur = end_time - start_time_;
+  if (metric_) {
+    try {
+      RecordLatency(*metric_, dur);
+    } catch (...) {
+      // The first record of a thread allocates; without memory the sample
+      // is dropped.
+    }
+    return;
+  }
+  if (!print_) {
+    return;
+  }
   std::cerr << operation_name << ": "s
             << duration_cast<milliseconds>(dur).count() << " ms"s << std::endl;
-}
\ No newline at end of file
+}
+
+void LogDuration::SetOutput(Output output) {
+  log_duration_output.store(output, memory_order_relaxed);
+}
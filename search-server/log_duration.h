@@ -1,25 +1,45 @@
 #pragma once
 #include <chrono>
 #include <iostream>
+#include <optional>
 #include <string>
 
+#include "latency_histogram.h"
+
 #define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
 #define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
 #define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
 #define LOG_DURATION(x) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
 #define LOG_DURATION_STREAM(x, s) LogDuration UNIQUE_VAR_NAME_PROFILE(x, s)
+// Records the scope into the latency histogram named x, a name that does not
+// change between passes; does nothing while latency recording is disabled.
+#define LOG_LATENCY(x)                                                         \
+  static const LatencyMetric PROFILE_CONCAT(profileMetric, __LINE__)(x);       \
+  ScopedLatency UNIQUE_VAR_NAME_PROFILE(PROFILE_CONCAT(profileMetric, __LINE__))
 
 class LogDuration {
 public:
+  // PRINT writes every duration to the stream; RECORD puts it into the
+  // latency histogram named after the operation instead, while latency
+  // recording is enabled. A duration whose operation gets no histogram
+  // because all LatencyMetric::MAX_COUNT names are taken is printed.
+  enum class Output { PRINT, RECORD };
+
   LogDuration(std::string _operation_name,
               std::ostream &_out_stream = std::cerr);
 
   ~LogDuration();
 
+  // Applies to every LogDuration; PRINT by default.
+  static void SetOutput(Output output);
+
 private:
   const std::chrono::steady_clock::time_point start_time_ =
       std::chrono::steady_clock::now();
   const std::string operation_name;
   std::ostream &out_stream;
+  // Looked up when the scope starts, so the destructor neither locks nor
+  // throws.
+  std::optional<LatencyMetric> metric_;
+  bool print_ = true;
 };
-#pragma once
\ No newline at end of file
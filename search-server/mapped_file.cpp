@@ -0,0 +1,152 @@
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const string &path) {
+  file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_ == INVALID_HANDLE_VALUE) {
+    file_ = nullptr;
+    throw runtime_error("Cannot open "s + path);
+  }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file_, &file_size)) {
+    CloseHandle(file_);
+    throw runtime_error("Cannot get the size of "s + path);
+  }
+  size_ = static_cast<size_t>(file_size.QuadPart);
+  if (size_ == 0) {
+    return;
+  }
+  mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping_ != nullptr) {
+    data_ = static_cast<const char *>(
+        MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+  }
+  if (data_ == nullptr) {
+    if (mapping_ != nullptr) {
+      CloseHandle(mapping_);
+    }
+    CloseHandle(file_);
+    throw runtime_error("Cannot map "s + path);
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_ != nullptr) {
+    CloseHandle(mapping_);
+  }
+  if (file_ != nullptr) {
+    CloseHandle(file_);
+  }
+}
+
+void MappedFile::Prefetch(size_t offset, size_t length) const {
+  // Read-ahead of mapped views is left to the system.
+}
+
+void SyncToDisk(const string &path) {
+  const HANDLE file =
+      CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw runtime_error("Cannot open "s + path);
+  }
+  const bool synced = FlushFileBuffers(file);
+  CloseHandle(file);
+  if (!synced) {
+    throw runtime_error("Cannot sync "s + path);
+  }
+}
+
+// Renames are made durable by the file system itself.
+void SyncDirectory(const string &) {}
+
+#else
+
+MappedFile::MappedFile(const string &path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw runtime_error("Cannot open "s + path);
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    close(fd);
+    throw runtime_error("Cannot get the size of "s + path);
+  }
+  size_ = static_cast<size_t>(file_stat.st_size);
+  if (size_ > 0) {
+    void *data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      throw runtime_error("Cannot map "s + path);
+    }
+    data_ = static_cast<const char *>(data);
+  }
+  // The mapping keeps the file referenced.
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    munmap(const_cast<char *>(data_), size_);
+  }
+}
+
+void MappedFile::Prefetch(size_t offset, size_t length) const {
+  if (offset >= size_) {
+    return;
+  }
+  // madvise wants a page-aligned start.
+  const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  const size_t begin = offset / page_size * page_size;
+  const size_t end = min(size_, offset + length);
+  madvise(const_cast<char *>(data_) + begin, end - begin, MADV_WILLNEED);
+}
+
+void SyncToDisk(const string &path) {
+  const int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw runtime_error("Cannot open "s + path);
+  }
+  const bool synced = fsync(fd) == 0;
+  close(fd);
+  if (!synced) {
+    throw runtime_error("Cannot sync "s + path);
+  }
+}
+
+void SyncDirectory(const string &path) {
+  const auto directory = filesystem::path(path).parent_path();
+  const int fd = open(directory.empty() ? "." : directory.c_str(),
+                      O_RDONLY | O_CLOEXEC);
+  if (fd >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+}
+
+#endif
+
+const char *MappedFile::data() const { return data_; }
+
+size_t MappedFile::size() const { return size_; }
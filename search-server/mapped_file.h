@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only shared memory mapping of a whole file. Processes mapping the
+// same file share its page cache pages.
+class MappedFile {
+public:
+  // Throws std::runtime_error if the file cannot be opened or mapped.
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *data() const;
+  size_t size() const;
+
+  // Hints that the bytes [offset, offset + length) are about to be read, so
+  // the kernel can start reading them ahead. Does nothing where unsupported.
+  void Prefetch(size_t offset, size_t length) const;
+
+private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  void *file_ = nullptr;
+  void *mapping_ = nullptr;
+#endif
+};
+
+// Flushes the written contents of the file at path to the disk, so that a
+// rename of it that follows cannot expose a partly written file. Throws
+// std::runtime_error on failure.
+void SyncToDisk(const std::string &path);
+
+// Makes a rename inside the directory of path durable. Best effort: does
+// nothing where the file system does not need it or the directory cannot be
+// opened.
+void SyncDirectory(const std::string &path);
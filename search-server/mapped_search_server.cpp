@@ -0,0 +1,440 @@
+#include "mapped_search_server.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include "binary_io.h"
+
+using namespace std;
+
+namespace {
+
+constexpr uint32_t MAPPED_INDEX_MAGIC = 0x4D534958;  // "XISM" on disk
+constexpr uint32_t MAPPED_INDEX_VERSION = 2;
+// Sections start at this alignment so they can be used in place.
+constexpr uint64_t SECTION_ALIGNMENT = 16;
+
+static_assert(sizeof(CompressedPostingBlock) == 20 &&
+                  alignof(CompressedPostingBlock) == 4,
+              "Blocks are stored in the file in their in-memory layout");
+
+uint64_t AlignUp(uint64_t offset) {
+  return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT *
+         SECTION_ALIGNMENT;
+}
+
+void WritePadding(ostream &output, uint64_t &offset) {
+  static const char zeros[SECTION_ALIGNMENT] = {};
+  const uint64_t aligned = AlignUp(offset);
+  output.write(zeros, aligned - offset);
+  offset = aligned;
+}
+
+template <typename T>
+void WriteSection(ostream &output, uint64_t &offset, const vector<T> &items) {
+  WriteArray(output, items.data(), items.size());
+  offset += items.size() * sizeof(T);
+  WritePadding(output, offset);
+}
+
+// A name next to path that no other writer picks.
+string MakeTempPath(const string &path) {
+  static atomic<uint64_t> counter = 0;
+  random_device random;
+  return path + ".tmp."s + to_string(random()) + "."s +
+         to_string(hash<thread::id>()(this_thread::get_id())) + "."s +
+         to_string(counter++);
+}
+
+} // namespace
+
+struct MappedSearchServer::Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t byte_order;
+  int32_t document_count;
+  uint64_t ordinal_count;
+  uint64_t term_count;
+  uint64_t stop_word_count;
+  uint64_t block_count;
+  uint64_t delta_bytes;
+  uint64_t code_bytes;
+  uint64_t term_freq_count;
+  uint64_t string_pool_size;
+  // Section offsets from the start of the file.
+  uint64_t ids_offset;
+  uint64_t ratings_offset;
+  uint64_t statuses_offset;
+  uint64_t id_index_offset;
+  uint64_t terms_offset;
+  uint64_t blocks_offset;
+  uint64_t deltas_offset;
+  uint64_t codes_offset;
+  uint64_t term_freqs_offset;
+  uint64_t stop_words_offset;
+  uint64_t strings_offset;
+  uint64_t file_size;
+};
+
+void MappedSearchServer::WriteIndex(const SearchServer &search_server,
+                                    const string &path) {
+  const size_t ordinal_count = search_server.ordinal_to_id_.size();
+  vector<int32_t> ids(ordinal_count, -1);
+  vector<IdRecord> id_index;
+  for (const auto [document_id, ordinal] : search_server.id_to_ordinal_) {
+    ids[ordinal] = document_id;
+    id_index.push_back({document_id, ordinal});
+  }
+  vector<int32_t> ratings(search_server.ratings_.begin(),
+                          search_server.ratings_.end());
+  vector<uint8_t> statuses(ordinal_count);
+  transform(search_server.statuses_.begin(), search_server.statuses_.end(),
+            statuses.begin(),
+            [](DocumentStatus status) { return static_cast<uint8_t>(status); });
+
+  string strings;
+  vector<TermRecord> terms;
+  vector<CompressedPostingBlock> blocks;
+  vector<uint8_t> deltas;
+  vector<uint8_t> codes;
+  vector<double> term_freqs;
+  search_server.word_to_document_freqs_.ForEachTerm(
+      [&](string_view word, const InvertedIndex::PostingList &term_postings) {
+        const CompressedPostingList compressed(term_postings);
+        terms.push_back({strings.size(), blocks.size(), deltas.size(),
+                         codes.size(), term_freqs.size(),
+                         static_cast<uint32_t>(word.size()),
+                         static_cast<uint32_t>(compressed.size()),
+                         static_cast<uint32_t>(compressed.GetBlocks().size()),
+                         static_cast<uint32_t>(compressed.GetDeltas().size()),
+                         static_cast<uint32_t>(compressed.GetCodes().size()),
+                         static_cast<uint32_t>(
+                             compressed.GetTermFreqs().size())});
+        strings += word;
+        const auto append = [](auto &section, const auto &items) {
+          section.insert(section.end(), items.begin(), items.end());
+        };
+        append(blocks, compressed.GetBlocks());
+        append(deltas, compressed.GetDeltas());
+        append(codes, compressed.GetCodes());
+        append(term_freqs, compressed.GetTermFreqs());
+      });
+  vector<StringRecord> stop_words;
+  for (const auto &word : search_server.stop_words_) {
+    stop_words.push_back({strings.size(), word.size()});
+    strings += word;
+  }
+
+  Header header = {};
+  header.magic = MAPPED_INDEX_MAGIC;
+  header.version = MAPPED_INDEX_VERSION;
+  header.byte_order = BYTE_ORDER_MARK;
+  header.document_count = search_server.GetDocumentCount();
+  header.ordinal_count = ordinal_count;
+  header.term_count = terms.size();
+  header.stop_word_count = stop_words.size();
+  header.block_count = blocks.size();
+  header.delta_bytes = deltas.size();
+  header.code_bytes = codes.size();
+  header.term_freq_count = term_freqs.size();
+  header.string_pool_size = strings.size();
+  uint64_t offset = AlignUp(sizeof(Header));
+  const auto place = [&offset](uint64_t &section, uint64_t bytes) {
+    section = offset;
+    offset = AlignUp(offset + bytes);
+  };
+  place(header.ids_offset, ids.size() * sizeof(int32_t));
+  place(header.ratings_offset, ratings.size() * sizeof(int32_t));
+  place(header.statuses_offset, statuses.size());
+  place(header.id_index_offset, id_index.size() * sizeof(IdRecord));
+  place(header.terms_offset, terms.size() * sizeof(TermRecord));
+  place(header.blocks_offset, blocks.size() * sizeof(CompressedPostingBlock));
+  place(header.deltas_offset, deltas.size());
+  place(header.codes_offset, codes.size());
+  place(header.term_freqs_offset, term_freqs.size() * sizeof(double));
+  place(header.stop_words_offset, stop_words.size() * sizeof(StringRecord));
+  place(header.strings_offset, strings.size());
+  header.file_size = offset;
+
+  // The index is written next to the target, synced and renamed over it,
+  // so processes that have the old file mapped keep reading its inode and a
+  // crash midway leaves the previous index in place. The temporary name is
+  // unique, so concurrent writers do not write into each other's file.
+  const string temp_path = MakeTempPath(path);
+  ofstream output(temp_path, ios::binary | ios::trunc);
+  if (!output) {
+    throw runtime_error("Cannot open "s + temp_path + " for writing"s);
+  }
+  offset = 0;
+  WriteValue(output, header);
+  offset += sizeof(Header);
+  WritePadding(output, offset);
+  WriteSection(output, offset, ids);
+  WriteSection(output, offset, ratings);
+  WriteSection(output, offset, statuses);
+  WriteSection(output, offset, id_index);
+  WriteSection(output, offset, terms);
+  WriteSection(output, offset, blocks);
+  WriteSection(output, offset, deltas);
+  WriteSection(output, offset, codes);
+  WriteSection(output, offset, term_freqs);
+  WriteSection(output, offset, stop_words);
+  WriteSection(output, offset, vector<char>(strings.begin(), strings.end()));
+  output.close();
+  try {
+    if (!output) {
+      throw runtime_error("Failed to write "s + temp_path);
+    }
+    SyncToDisk(temp_path);
+    filesystem::rename(temp_path, path);
+  } catch (...) {
+    error_code error;
+    filesystem::remove(temp_path, error);
+    throw;
+  }
+  SyncDirectory(path);
+}
+
+MappedSearchServer::MappedSearchServer(const string &path)
+    : file_(path), parser_(ReadStopWords(file_)) {
+  const Header &header = ReadHeader(file_);
+  const char *data = file_.data();
+  ordinal_count_ = header.ordinal_count;
+  document_count_ = header.document_count;
+  term_count_ = header.term_count;
+  ids_ = reinterpret_cast<const int32_t *>(data + header.ids_offset);
+  ratings_ = reinterpret_cast<const int32_t *>(data + header.ratings_offset);
+  statuses_ = reinterpret_cast<const uint8_t *>(data + header.statuses_offset);
+  id_index_ = reinterpret_cast<const IdRecord *>(data + header.id_index_offset);
+  terms_ = reinterpret_cast<const TermRecord *>(data + header.terms_offset);
+  blocks_ = reinterpret_cast<const CompressedPostingBlock *>(
+      data + header.blocks_offset);
+  deltas_ = reinterpret_cast<const uint8_t *>(data + header.deltas_offset);
+  codes_ = reinterpret_cast<const uint8_t *>(data + header.codes_offset);
+  term_freqs_ =
+      reinterpret_cast<const double *>(data + header.term_freqs_offset);
+  strings_ = data + header.strings_offset;
+  header_ = &header;
+  term_checks_ = make_unique<atomic<TermCheck>[]>(term_count_);
+}
+
+const MappedSearchServer::Header &
+MappedSearchServer::ReadHeader(const MappedFile &file) {
+  if (file.size() < sizeof(Header)) {
+    throw runtime_error("Not a mapped index file"s);
+  }
+  const auto &header = *reinterpret_cast<const Header *>(file.data());
+  if (header.magic != MAPPED_INDEX_MAGIC) {
+    throw runtime_error("Not a mapped index file"s);
+  }
+  if (header.version != MAPPED_INDEX_VERSION) {
+    throw runtime_error("Unsupported mapped index version "s +
+                        to_string(header.version));
+  }
+  if (header.byte_order != BYTE_ORDER_MARK) {
+    throw runtime_error("Mapped index has a different byte order"s);
+  }
+  if (header.file_size != file.size()) {
+    throw runtime_error("Truncated mapped index"s);
+  }
+  // Ordinals are ints, and every document has one.
+  if (header.document_count < 0 ||
+      header.ordinal_count > static_cast<uint64_t>(INT32_MAX) ||
+      static_cast<uint64_t>(header.document_count) > header.ordinal_count) {
+    throw runtime_error("Corrupted mapped index"s);
+  }
+  // Sections are laid out in this order, each after the previous one. Counts
+  // are bounded by the file size before they are multiplied.
+  const uint64_t sections[][3] = {
+      {header.ids_offset, header.ordinal_count, sizeof(int32_t)},
+      {header.ratings_offset, header.ordinal_count, sizeof(int32_t)},
+      {header.statuses_offset, header.ordinal_count, 1},
+      {header.id_index_offset, static_cast<uint64_t>(header.document_count),
+       sizeof(IdRecord)},
+      {header.terms_offset, header.term_count, sizeof(TermRecord)},
+      {header.blocks_offset, header.block_count,
+       sizeof(CompressedPostingBlock)},
+      {header.deltas_offset, header.delta_bytes, 1},
+      {header.codes_offset, header.code_bytes, 1},
+      {header.term_freqs_offset, header.term_freq_count, sizeof(double)},
+      {header.stop_words_offset, header.stop_word_count, sizeof(StringRecord)},
+      {header.strings_offset, header.string_pool_size, 1}};
+  uint64_t previous_end = sizeof(Header);
+  for (const auto &[offset, count, item_size] : sections) {
+    if (offset < previous_end || offset % SECTION_ALIGNMENT != 0 ||
+        offset > header.file_size ||
+        count > (header.file_size - offset) / item_size) {
+      throw runtime_error("Corrupted mapped index"s);
+    }
+    previous_end = offset + count * item_size;
+  }
+  return header;
+}
+
+SearchServer MappedSearchServer::ReadStopWords(const MappedFile &file) {
+  const Header &header = ReadHeader(file);
+  const auto *records = reinterpret_cast<const StringRecord *>(
+      file.data() + header.stop_words_offset);
+  const char *strings = file.data() + header.strings_offset;
+  vector<string> stop_words;
+  for (uint64_t i = 0; i < header.stop_word_count; ++i) {
+    const auto [offset, size] = records[i];
+    if (offset > header.string_pool_size ||
+        size > header.string_pool_size - offset) {
+      throw runtime_error("Corrupted mapped index"s);
+    }
+    stop_words.emplace_back(strings + offset, size);
+  }
+  return SearchServer(stop_words);
+}
+
+void MappedSearchServer::CheckPostings(
+    const TermRecord &term, const CompressedPostingView &postings) const {
+  // Threads that read a term at the same time may both check it; they come
+  // to the same result.
+  auto &check = term_checks_[&term - terms_];
+  TermCheck state = check.load(memory_order_acquire);
+  if (state == TermCheck::UNCHECKED) {
+    bool valid = postings.size() == term.posting_count &&
+                 postings.IsWellFormed(ordinal_count_);
+    // Postings only refer to live documents with a known status.
+    if (valid) {
+      postings.ForEach([&](int ordinal, double) {
+        valid = valid && ids_[ordinal] != -1 &&
+                statuses_[ordinal] <=
+                    static_cast<uint8_t>(DocumentStatus::REMOVED);
+      });
+    }
+    state = valid ? TermCheck::VALID : TermCheck::CORRUPTED;
+    check.store(state, memory_order_release);
+  }
+  if (state == TermCheck::CORRUPTED) {
+    throw runtime_error("Corrupted mapped index"s);
+  }
+}
+
+vector<Document>
+MappedSearchServer::FindTopDocuments(string_view raw_query,
+                                     DocumentStatus status,
+                                     size_t max_result_count) const {
+  return FindTopDocuments(raw_query,
+                          SearchServer::StatusPredicate{status},
+                          max_result_count);
+}
+
+vector<Document>
+MappedSearchServer::FindTopDocuments(string_view raw_query) const {
+  return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+SearchServer::MatchedResult
+MappedSearchServer::MatchDocument(string_view raw_query,
+                                  int document_id) const {
+  const auto scratch = parser_.ParseScratchQuery(raw_query);
+  const SearchServer::Query &query = *scratch;
+  const IdRecord *id_end = id_index_ + document_count_;
+  const IdRecord *record = lower_bound(
+      id_index_, id_end, document_id,
+      [](const IdRecord &record, int id) { return record.id < id; });
+  if (id_end == record || record->id != document_id) {
+    throw out_of_range("Unknown document_id"s);
+  }
+  const int ordinal = record->ordinal;
+  if (ordinal < 0 || static_cast<size_t>(ordinal) >= ordinal_count_ ||
+      ids_[ordinal] != document_id ||
+      statuses_[ordinal] > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+    throw runtime_error("Corrupted mapped index"s);
+  }
+  const auto status = static_cast<DocumentStatus>(statuses_[ordinal]);
+
+  const auto contains = [this, ordinal](const TermRecord *term) {
+    return GetPostings(*term).Contains(ordinal);
+  };
+  vector<string_view> matched_words;
+  for (const string_view word : query.minus_words) {
+    const TermRecord *term = FindTerm(word);
+    if (term != nullptr && contains(term)) {
+      return {matched_words, status};
+    }
+  }
+  for (const string_view word : query.plus_words) {
+    const TermRecord *term = FindTerm(word);
+    if (term != nullptr && contains(term)) {
+      matched_words.push_back(GetWord(*term));
+    }
+  }
+  return {matched_words, status};
+}
+
+int MappedSearchServer::GetDocumentCount() const { return document_count_; }
+
+void MappedSearchServer::AddDocument(int, string_view, DocumentStatus,
+                                     const vector<int> &) {
+  throw logic_error(
+      "AddDocument is not supported: a mapped index is read-only"s);
+}
+
+void MappedSearchServer::RemoveDocument(int) {
+  throw logic_error(
+      "RemoveDocument is not supported: a mapped index is read-only"s);
+}
+
+string_view MappedSearchServer::GetWord(const TermRecord &term) const {
+  if (term.word_offset > header_->string_pool_size ||
+      term.word_size > header_->string_pool_size - term.word_offset) {
+    throw runtime_error("Corrupted mapped index"s);
+  }
+  return string_view(strings_ + term.word_offset, term.word_size);
+}
+
+const MappedSearchServer::TermRecord *
+MappedSearchServer::FindTerm(string_view word) const {
+  const TermRecord *end = terms_ + term_count_;
+  const TermRecord *term = lower_bound(
+      terms_, end, word, [this](const TermRecord &term, string_view value) {
+        return GetWord(term) < value;
+      });
+  return end != term && GetWord(*term) == word ? term : nullptr;
+}
+
+CompressedPostingView
+MappedSearchServer::GetPostings(const TermRecord &term) const {
+  const auto within = [](uint64_t offset, uint64_t count, uint64_t total) {
+    return offset <= total && count <= total - offset;
+  };
+  if (!within(term.first_block, term.block_count, header_->block_count) ||
+      !within(term.delta_offset, term.delta_bytes, header_->delta_bytes) ||
+      !within(term.code_offset, term.code_bytes, header_->code_bytes) ||
+      !within(term.first_term_freq, term.term_freq_count,
+              header_->term_freq_count)) {
+    throw runtime_error("Corrupted mapped index"s);
+  }
+  const CompressedPostingView postings(
+      blocks_ + term.first_block, term.block_count, deltas_ + term.delta_offset,
+      term.delta_bytes, codes_ + term.code_offset, term.code_bytes,
+      term_freqs_ + term.first_term_freq, term.term_freq_count);
+  CheckPostings(term, postings);
+  return postings;
+}
+
+OrdinalSet
+MappedSearchServer::CollectMinusDocuments(const SearchServer::Query &query) const {
+  vector<InvertedIndex::PostingList> decoded;
+  for (const string_view word : query.minus_words) {
+    if (const TermRecord *term = FindTerm(word)) {
+      decoded.push_back(GetPostings(*term).Decode());
+    }
+  }
+  vector<const InvertedIndex::PostingList *> lists;
+  for (const auto &postings : decoded) {
+    lists.push_back(&postings);
+  }
+  return OrdinalSet(lists, ordinal_count_);
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "compressed_postings.h"
+#include "mapped_file.h"
+#include "relevance_accumulator.h"
+#include "search_server.h"
+
+// Read-only search server over an index file written by WriteIndex. The
+// file is memory-mapped and its term dictionary, compressed postings and
+// document metadata are used in place, with no deserialization, so worker
+// processes serving one file share a single copy in the page cache. Opening
+// only checks the header and that the sections fit in the file; the records
+// of a term are checked the first time a query reads them, so opening does
+// not depend on the index size. Results are the same as the SearchServer's
+// that wrote the file.
+class MappedSearchServer {
+public:
+  static void WriteIndex(const SearchServer &search_server,
+                         const std::string &path);
+
+  // Throws std::runtime_error if the file is not a compatible index or its
+  // sections do not fit in it. Queries throw std::runtime_error when they
+  // read a record that points outside of the file, breaks its order or
+  // refers to a removed document.
+  explicit MappedSearchServer(const std::string &path);
+
+  template <typename DocumentPredicate>
+  std::vector<Document>
+  FindTopDocuments(std::string_view raw_query,
+                   DocumentPredicate document_predicate,
+                   size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+  std::vector<Document>
+  FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                   size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+  std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+  // Matched words are views into the mapped file.
+  SearchServer::MatchedResult MatchDocument(std::string_view raw_query,
+                                            int document_id) const;
+
+  int GetDocumentCount() const;
+
+  // The index is immutable: these always throw std::logic_error.
+  void AddDocument(int, std::string_view, DocumentStatus,
+                   const std::vector<int> &);
+  void RemoveDocument(int);
+
+private:
+  struct Header;
+  // Offsets are into the sections of all terms: the string pool, blocks,
+  // delta and code bytes and distinct term frequencies.
+  struct TermRecord {
+    uint64_t word_offset;
+    uint64_t first_block;
+    uint64_t delta_offset;
+    uint64_t code_offset;
+    uint64_t first_term_freq;
+    uint32_t word_size;
+    uint32_t posting_count;
+    uint32_t block_count;
+    uint32_t delta_bytes;
+    uint32_t code_bytes;
+    uint32_t term_freq_count;
+  };
+  struct IdRecord {
+    int32_t id;
+    int32_t ordinal;
+  };
+  struct StringRecord {
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  // Results of checking the postings of each term, see CheckPostings.
+  enum class TermCheck : uint8_t { UNCHECKED, VALID, CORRUPTED };
+
+  MappedFile file_;
+  const Header *header_ = nullptr;
+  // Owns no documents; parses queries with the stop words of the file.
+  SearchServer parser_;
+  size_t ordinal_count_ = 0;
+  int document_count_ = 0;
+  const int32_t *ids_ = nullptr;
+  const int32_t *ratings_ = nullptr;
+  const uint8_t *statuses_ = nullptr;
+  const IdRecord *id_index_ = nullptr;
+  const TermRecord *terms_ = nullptr;
+  size_t term_count_ = 0;
+  const CompressedPostingBlock *blocks_ = nullptr;
+  const uint8_t *deltas_ = nullptr;
+  const uint8_t *codes_ = nullptr;
+  const double *term_freqs_ = nullptr;
+  const char *strings_ = nullptr;
+  std::unique_ptr<std::atomic<TermCheck>[]> term_checks_;
+
+  static const Header &ReadHeader(const MappedFile &file);
+  static SearchServer ReadStopWords(const MappedFile &file);
+  void CheckPostings(const TermRecord &term,
+                     const CompressedPostingView &postings) const;
+
+  std::string_view GetWord(const TermRecord &term) const;
+  const TermRecord *FindTerm(std::string_view word) const;
+  CompressedPostingView GetPostings(const TermRecord &term) const;
+  OrdinalSet CollectMinusDocuments(const SearchServer::Query &query) const;
+};
+
+template <typename DocumentPredicate>
+std::vector<Document>
+MappedSearchServer::FindTopDocuments(std::string_view raw_query,
+                                     DocumentPredicate document_predicate,
+                                     size_t max_result_count) const {
+  const auto scratch = parser_.ParseScratchQuery(raw_query);
+  const SearchServer::Query &query = *scratch;
+  const OrdinalSet excluded = CollectMinusDocuments(query);
+
+  // Calls add(ordinal, relevance) for every posting of the plus words that
+  // is scored, in word order.
+  const auto for_each_scored = [&](auto add) {
+    for (const std::string_view word : query.plus_words) {
+      const TermRecord *term = FindTerm(word);
+      if (term == nullptr) {
+        continue;
+      }
+      const double inverse_document_freq =
+          std::log(document_count_ * 1.0 / term->posting_count);
+      GetPostings(*term).ForEach([&](int ordinal, double term_freq) {
+        if (excluded.Contains(ordinal) ||
+            !document_predicate(ids_[ordinal],
+                                static_cast<DocumentStatus>(statuses_[ordinal]),
+                                ratings_[ordinal])) {
+          return;
+        }
+        add(ordinal, term_freq * inverse_document_freq);
+      });
+    }
+  };
+  const auto make_document = [this](size_t ordinal, double relevance) {
+    return Document(ids_[ordinal], relevance, ratings_[ordinal]);
+  };
+
+  // Ordinal order, as in SearchServer, so that ties are broken the same way.
+  std::vector<Document> matched_documents;
+  if (ordinal_count_ <= RelevanceAccumulator::MAX_POOLED_SLOTS) {
+    RelevanceAccumulator relevances(ordinal_count_);
+    for_each_scored([&relevances](int ordinal, double relevance) {
+      relevances.Add(0, ordinal, relevance);
+    });
+    matched_documents = relevances.TakeDocuments(0, make_document);
+  } else {
+    // Dense sums of a large index would not be pooled, so every query would
+    // allocate and zero them; the scored postings are summed instead. The
+    // stable sort keeps the word order, so the sums are the same.
+    std::vector<std::pair<int, double>> scored;
+    for_each_scored([&scored](int ordinal, double relevance) {
+      scored.emplace_back(ordinal, relevance);
+    });
+    std::stable_sort(scored.begin(), scored.end(),
+                     [](const auto &lhs, const auto &rhs) {
+                       return lhs.first < rhs.first;
+                     });
+    for (size_t i = 0; i < scored.size();) {
+      const int ordinal = scored[i].first;
+      double relevance = 0.0;
+      for (; i < scored.size() && scored[i].first == ordinal; ++i) {
+        relevance += scored[i].second;
+      }
+      matched_documents.push_back(make_document(ordinal, relevance));
+    }
+  }
+  SearchServer::SelectTopDocuments(matched_documents, max_result_count);
+  return matched_documents;
+}
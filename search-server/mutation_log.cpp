@@ -0,0 +1,424 @@
+#include "mutation_log.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "binary_io.h"
+#include "mapped_file.h"
+#include "search_server.h"
+
+using namespace std;
+
+// A log is a header followed by records. The header holds the sequence
+// number of the last record dropped by a reset; records after it are
+// numbered consecutively. A record is its payload size, the checksum of the
+// payload and the payload: the record type, its fields and its sequence
+// number. The number closes the payload so that it can be stamped under the
+// lock after the rest of the payload is checksummed.
+static const uint32_t LOG_MAGIC = 0x53534c47;  // "SSLG"
+static const uint32_t LOG_VERSION = 2;
+
+enum class RecordType : uint8_t { ADD_DOCUMENT = 1, REMOVE_DOCUMENT = 2 };
+
+namespace {
+
+#ifdef _WIN32
+int OpenForAppend(const string &path) {
+  return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY,
+               _S_IREAD | _S_IWRITE);
+}
+long long WriteSome(int fd, const char *data, size_t size) {
+  return _write(fd, data, static_cast<unsigned>(size));
+}
+bool SyncFile(int fd) { return _commit(fd) == 0; }
+bool TruncateFile(int fd, long long size) { return _chsize_s(fd, size) == 0; }
+long long GetFileSize(int fd) { return _lseeki64(fd, 0, SEEK_END); }
+void CloseFile(int fd) { _close(fd); }
+#else
+int OpenForAppend(const string &path) {
+  return open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+}
+long long WriteSome(int fd, const char *data, size_t size) {
+  return write(fd, data, size);
+}
+bool SyncFile(int fd) { return fdatasync(fd) == 0; }
+bool TruncateFile(int fd, long long size) { return ftruncate(fd, size) == 0; }
+long long GetFileSize(int fd) { return lseek(fd, 0, SEEK_END); }
+void CloseFile(int fd) { close(fd); }
+#endif
+
+// FNV-1a; enough to tell a torn tail from a complete record. hash continues
+// the checksum of preceding data.
+const uint32_t CHECKSUM_SEED = 2166136261u;
+
+uint32_t Checksum(string_view data, uint32_t hash = CHECKSUM_SEED) {
+  for (const char c : data) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+  }
+  return hash;
+}
+
+template <typename T> void AppendValue(string &buffer, const T &value) {
+  static_assert(is_trivially_copyable_v<T>);
+  buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+string MakeHeader(uint64_t base_sequence) {
+  string header;
+  AppendValue(header, LOG_MAGIC);
+  AppendValue(header, LOG_VERSION);
+  AppendValue(header, BYTE_ORDER_MARK);
+  AppendValue(header, base_sequence);
+  return header;
+}
+
+const size_t HEADER_SIZE = 3 * sizeof(uint32_t) + sizeof(uint64_t);
+
+// Returns the base sequence number of log.
+uint64_t ReadHeader(string_view log) {
+  if (log.size() < HEADER_SIZE ||
+      log.compare(0, HEADER_SIZE - sizeof(uint64_t),
+                  string_view(MakeHeader(0)).substr(
+                      0, HEADER_SIZE - sizeof(uint64_t))) != 0) {
+    throw runtime_error("Not a mutation log or incompatible one"s);
+  }
+  uint64_t base_sequence;
+  memcpy(&base_sequence, log.data() + HEADER_SIZE - sizeof(uint64_t),
+         sizeof(base_sequence));
+  return base_sequence;
+}
+
+string ReadFile(const string &path) {
+  ifstream input(path, ios::binary);
+  if (!input) {
+    throw runtime_error("Cannot open "s + path);
+  }
+  return string((istreambuf_iterator<char>(input)),
+                istreambuf_iterator<char>());
+}
+
+// Wraps a payload into a record in place: the payload must start after
+// RECORD_PREFIX_SIZE reserved bytes.
+const size_t RECORD_PREFIX_SIZE = 2 * sizeof(uint32_t);
+
+void SealRecord(string &record, uint32_t checksum) {
+  const uint32_t size = static_cast<uint32_t>(record.size() - RECORD_PREFIX_SIZE);
+  memcpy(record.data(), &size, sizeof(size));
+  memcpy(record.data() + sizeof(size), &checksum, sizeof(checksum));
+}
+
+struct LogRecord {
+  uint64_t sequence;
+  // The payload without the sequence number.
+  string_view body;
+  // The whole record, as written.
+  string_view data;
+};
+
+// Calls callback(record) for the records of log that follow its header, up
+// to the first torn or corrupt one, and returns the size of that intact
+// prefix of log.
+template <typename Callback>
+size_t ForEachRecord(string_view log, Callback callback) {
+  string_view rest = log.substr(HEADER_SIZE);
+  while (rest.size() >= RECORD_PREFIX_SIZE) {
+    uint32_t size, checksum;
+    memcpy(&size, rest.data(), sizeof(size));
+    memcpy(&checksum, rest.data() + sizeof(size), sizeof(checksum));
+    if (rest.size() - RECORD_PREFIX_SIZE < size || size < sizeof(uint64_t)) {
+      break;
+    }
+    const string_view payload = rest.substr(RECORD_PREFIX_SIZE, size);
+    if (Checksum(payload) != checksum) {
+      break;
+    }
+    LogRecord record;
+    memcpy(&record.sequence, payload.data() + size - sizeof(uint64_t),
+           sizeof(uint64_t));
+    record.body = payload.substr(0, size - sizeof(uint64_t));
+    record.data = rest.substr(0, RECORD_PREFIX_SIZE + size);
+    callback(record);
+    rest.remove_prefix(RECORD_PREFIX_SIZE + size);
+  }
+  return log.size() - rest.size();
+}
+
+}  // namespace
+
+MutationLog::MutationLog(const string &path) : MutationLog(path, Options{}) {}
+
+MutationLog::MutationLog(const string &path, Options options)
+    : options_(options), path_(path) {
+  fd_ = OpenForAppend(path);
+  if (fd_ < 0) {
+    throw runtime_error("Cannot open "s + path + " for writing"s);
+  }
+  try {
+    Recover();
+  } catch (...) {
+    CloseFile(fd_);
+    throw;
+  }
+  flusher_ = thread([this] { FlushLoop(); });
+}
+
+MutationLog::~MutationLog() {
+  {
+    lock_guard guard(mutex_);
+    stopping_ = true;
+  }
+  flush_requested_.notify_one();
+  flusher_.join();
+  CloseFile(fd_);
+}
+
+void MutationLog::Recover() {
+  if (GetFileSize(fd_) == 0) {
+    WriteAndSync(fd_, MakeHeader(0));
+    return;
+  }
+  const string log = ReadFile(path_);
+  last_sequence_ = ReadHeader(log);
+  const size_t intact_size = ForEachRecord(
+      log, [this](const LogRecord &record) { last_sequence_ = record.sequence; });
+  // New records must not land behind a torn one, where Replay stops.
+  if (intact_size < log.size() &&
+      (!TruncateFile(fd_, static_cast<long long>(intact_size)) ||
+       !SyncFile(fd_))) {
+    throw runtime_error("Cannot truncate the mutation log"s);
+  }
+}
+
+uint64_t MutationLog::AppendAddDocument(int document_id, string_view document,
+                                        DocumentStatus status,
+                                        const vector<int> &ratings) {
+  string record(RECORD_PREFIX_SIZE, '\0');
+  record.reserve(RECORD_PREFIX_SIZE + 24 + ratings.size() * sizeof(int) +
+                 document.size());
+  AppendValue(record, RecordType::ADD_DOCUMENT);
+  AppendValue(record, static_cast<int32_t>(document_id));
+  AppendValue(record, static_cast<uint8_t>(status));
+  AppendValue(record, static_cast<uint32_t>(ratings.size()));
+  for (const int rating : ratings) {
+    AppendValue(record, static_cast<int32_t>(rating));
+  }
+  AppendValue(record, static_cast<uint32_t>(document.size()));
+  record.append(document);
+  return Append(record);
+}
+
+uint64_t MutationLog::AppendRemoveDocument(int document_id) {
+  string record(RECORD_PREFIX_SIZE, '\0');
+  AppendValue(record, RecordType::REMOVE_DOCUMENT);
+  AppendValue(record, static_cast<int32_t>(document_id));
+  return Append(record);
+}
+
+uint64_t MutationLog::Append(string &record) {
+  const uint32_t body_checksum =
+      Checksum(string_view(record).substr(RECORD_PREFIX_SIZE));
+  record.reserve(record.size() + sizeof(uint64_t));
+  bool group_full = false;
+  uint64_t sequence = 0;
+  {
+    lock_guard guard(mutex_);
+    if (error_) {
+      rethrow_exception(error_);
+    }
+    sequence = ++last_sequence_;
+    AppendValue(record, sequence);
+    SealRecord(record,
+               Checksum(string_view(record).substr(record.size() -
+                                                   sizeof(uint64_t)),
+                        body_checksum));
+    pending_ += record;
+    ++appended_records_;
+    group_full = ++pending_records_ == options_.group_size;
+  }
+  if (group_full) {
+    flush_requested_.notify_one();
+  }
+  return sequence;
+}
+
+void MutationLog::Sync() {
+  unique_lock lock(mutex_);
+  WaitDurable(lock);
+}
+
+void MutationLog::WaitDurable(unique_lock<mutex> &lock) {
+  const uint64_t target = appended_records_;
+  while (durable_records_ < target && !error_) {
+    sync_requested_ = true;
+    flush_requested_.notify_one();
+    flushed_.wait(lock);
+  }
+  if (error_) {
+    rethrow_exception(error_);
+  }
+}
+
+void MutationLog::Reset(uint64_t sequence) {
+  // Appenders wait on mutex_ until the log is rewritten; records appended
+  // meanwhile are written to the new file by the flusher.
+  unique_lock lock(mutex_);
+  WaitDurable(lock);
+  lock_guard file_guard(file_mutex_);
+  const string log = ReadFile(path_);
+  string kept = MakeHeader(max(sequence, ReadHeader(log)));
+  ForEachRecord(log, [&kept, sequence](const LogRecord &record) {
+    if (record.sequence > sequence) {
+      kept += record.data;
+    }
+  });
+
+  // A crash leaves either the old log or the new one in place; both
+  // replay to the same state on top of the snapshot.
+  const string temp_path = path_ + ".tmp"s;
+  const int temp_fd = OpenForAppend(temp_path);
+  if (temp_fd < 0) {
+    throw runtime_error("Cannot open "s + temp_path + " for writing"s);
+  }
+  try {
+    if (!TruncateFile(temp_fd, 0)) {
+      throw runtime_error("Cannot truncate "s + temp_path);
+    }
+    WriteAndSync(temp_fd, kept);
+  } catch (...) {
+    CloseFile(temp_fd);
+    throw;
+  }
+  CloseFile(temp_fd);
+  CloseFile(fd_);
+  error_code error;
+  filesystem::rename(temp_path, path_, error);
+  fd_ = OpenForAppend(path_);
+  if (error || fd_ < 0) {
+    throw runtime_error("Cannot replace the mutation log"s);
+  }
+  SyncDirectory(path_);
+}
+
+uint64_t MutationLog::GetRecordCount() const {
+  lock_guard guard(mutex_);
+  return appended_records_;
+}
+
+uint64_t MutationLog::GetSyncCount() const {
+  lock_guard guard(mutex_);
+  return sync_count_;
+}
+
+uint64_t MutationLog::GetLastSequence() const {
+  lock_guard guard(mutex_);
+  return last_sequence_;
+}
+
+void MutationLog::FlushLoop() {
+  string batch;
+  unique_lock lock(mutex_);
+  while (true) {
+    flush_requested_.wait_for(lock, options_.group_interval, [this] {
+      return stopping_ || sync_requested_ ||
+             pending_records_ >= options_.group_size;
+    });
+    if (pending_.empty()) {
+      // Whatever a sync waits for is already being written.
+      sync_requested_ = false;
+      if (stopping_) {
+        return;
+      }
+      continue;
+    }
+    // Appenders fill a fresh buffer while this one is written out.
+    batch.swap(pending_);
+    pending_.clear();
+    const uint64_t target = appended_records_;
+    pending_records_ = 0;
+    sync_requested_ = false;
+    lock.unlock();
+
+    exception_ptr error;
+    try {
+      lock_guard file_guard(file_mutex_);
+      WriteAndSync(fd_, batch);
+    } catch (...) {
+      error = current_exception();
+    }
+
+    lock.lock();
+    if (error) {
+      error_ = error;
+    } else {
+      durable_records_ = target;
+      ++sync_count_;
+    }
+    flushed_.notify_all();
+    if (error_) {
+      return;
+    }
+  }
+}
+
+void MutationLog::WriteAndSync(int fd, const string &data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    const long long result =
+        WriteSome(fd, data.data() + written, data.size() - written);
+    if (result < 0) {
+      throw runtime_error("Cannot write the mutation log"s);
+    }
+    written += static_cast<size_t>(result);
+  }
+  if (!SyncFile(fd)) {
+    throw runtime_error("Cannot sync the mutation log"s);
+  }
+}
+
+size_t MutationLog::Replay(const string &path, SearchServer &server) {
+  const string log = ReadFile(path);
+  if (log.empty()) {
+    return 0;  // created, but the header never reached the disk
+  }
+  ReadHeader(log);
+
+  size_t replayed = 0;
+  ForEachRecord(log, [&](const LogRecord &log_record) {
+    if (log_record.sequence <= server.log_sequence_) {
+      return;  // already in the snapshot server was loaded from
+    }
+    istringstream record{string(log_record.body)};
+    const auto type = ReadValue<RecordType>(record);
+    const int document_id = ReadValue<int32_t>(record);
+    if (type == RecordType::ADD_DOCUMENT) {
+      const auto status = static_cast<DocumentStatus>(ReadValue<uint8_t>(record));
+      vector<int> ratings(ReadValue<uint32_t>(record));
+      for (int &rating : ratings) {
+        rating = ReadValue<int32_t>(record);
+      }
+      server.AddDocument(document_id, ReadString(record), status, ratings);
+    } else if (type == RecordType::REMOVE_DOCUMENT) {
+      server.RemoveDocument(document_id);
+    } else {
+      throw runtime_error("Unknown mutation log record"s);
+    }
+    server.log_sequence_ = log_record.sequence;
+    ++replayed;
+  });
+  return replayed;
+}
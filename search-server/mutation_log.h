@@ -0,0 +1,103 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "document.h"
+
+class SearchServer;
+
+// Append-only write-ahead log of document insertions and removals. Appends
+// only encode the record into an in-memory buffer; a background thread
+// writes the buffer out and fsyncs it once per group of records or per time
+// interval, whichever comes first (group commit). Records appended since the
+// last fsync are lost on a crash.
+//
+// Every record carries a sequence number that keeps growing across Reset
+// and reopening. SearchServer remembers the number of the last mutation it
+// logged and stores it in its snapshots, so Replay on a snapshot skips the
+// records the snapshot already holds. A checkpoint is
+//   server.SaveSnapshot(path); log.Reset(server.GetLogSequence());
+// and recovers correctly whichever step a crash interrupts.
+class MutationLog {
+public:
+  struct Options {
+    // Wakes the flusher as soon as this many records are pending.
+    size_t group_size = 1024;
+    // Pending records are never older than this when they are flushed.
+    std::chrono::milliseconds group_interval{10};
+  };
+
+  // Opens path for appending, creating it if needed. A torn record at the
+  // end of an existing log is cut off. Throws std::runtime_error if the file
+  // cannot be opened or is not a compatible log.
+  explicit MutationLog(const std::string &path);
+  MutationLog(const std::string &path, Options options);
+  // Flushes and fsyncs the pending records.
+  ~MutationLog();
+
+  MutationLog(const MutationLog &) = delete;
+  MutationLog &operator=(const MutationLog &) = delete;
+
+  // Both return the sequence number given to the record.
+  uint64_t AppendAddDocument(int document_id, std::string_view document,
+                             DocumentStatus status,
+                             const std::vector<int> &ratings);
+  uint64_t AppendRemoveDocument(int document_id);
+
+  // Blocks until every record appended so far is on disk.
+  void Sync();
+  // Drops the records numbered up to sequence, which a saved snapshot
+  // covers, and keeps the later ones. The log is rewritten into a new file
+  // that replaces the old one atomically.
+  void Reset(uint64_t sequence);
+
+  // Records appended since the log was opened.
+  uint64_t GetRecordCount() const;
+  uint64_t GetSyncCount() const;
+  // Sequence number of the last record appended, or of the last one dropped
+  // by Reset if none was appended since.
+  uint64_t GetLastSequence() const;
+
+  // Applies the records of the log at path that are newer than
+  // server.GetLogSequence() to server in order and returns their count. A
+  // torn or corrupt record ends the log: it and whatever follows it are
+  // ignored. server must not have a log attached.
+  static size_t Replay(const std::string &path, SearchServer &server);
+
+private:
+  Options options_;
+  std::string path_;
+  int fd_ = -1;
+
+  mutable std::mutex mutex_;
+  std::condition_variable flush_requested_;
+  std::condition_variable flushed_;
+  std::string pending_;
+  size_t pending_records_ = 0;
+  uint64_t appended_records_ = 0;
+  uint64_t last_sequence_ = 0;
+  uint64_t durable_records_ = 0;
+  uint64_t sync_count_ = 0;
+  bool sync_requested_ = false;
+  bool stopping_ = false;
+  std::exception_ptr error_;
+
+  // Serializes file writes of the flusher with Reset.
+  std::mutex file_mutex_;
+  std::thread flusher_;
+
+  void Recover();
+  uint64_t Append(std::string &record);
+  void WaitDurable(std::unique_lock<std::mutex> &lock);
+  void FlushLoop();
+  static void WriteAndSync(int fd, const std::string &data);
+};
@@ -0,0 +1,67 @@
+#include "ordinal_set.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+// A bitmap pays one bit per document, a sorted vector 32 bits per posting
+// plus a binary search, so switch once postings cover 1/32 of ordinals.
+const size_t BITMAP_DENSITY_RATIO = 32;
+
+vector<OrdinalSet::PostingRange>
+ToRanges(const vector<const InvertedIndex::PostingList *> &lists) {
+  vector<OrdinalSet::PostingRange> ranges;
+  ranges.reserve(lists.size());
+  for (const auto *postings : lists) {
+    ranges.push_back({postings->data(), postings->data() + postings->size()});
+  }
+  return ranges;
+}
+
+} // namespace
+
+OrdinalSet::OrdinalSet(
+    const vector<const InvertedIndex::PostingList *> &lists,
+    size_t ordinal_count)
+    : OrdinalSet(ToRanges(lists), ordinal_count) {}
+
+OrdinalSet::OrdinalSet(const vector<PostingRange> &ranges,
+                       size_t ordinal_count) {
+  size_t posting_count = 0;
+  for (const auto &[begin, end] : ranges) {
+    posting_count += end - begin;
+  }
+  if (posting_count == 0) {
+    return;
+  }
+
+  if (posting_count * BITMAP_DENSITY_RATIO >= ordinal_count) {
+    bitmap_.assign((ordinal_count + 63) / 64, 0);
+    for (const auto &[begin, end] : ranges) {
+      for (const Posting *posting = begin; posting != end; ++posting) {
+        bitmap_[posting->ordinal >> 6] |= uint64_t(1) << (posting->ordinal & 63);
+      }
+    }
+  } else {
+    sorted_.reserve(posting_count);
+    for (const auto &[begin, end] : ranges) {
+      for (const Posting *posting = begin; posting != end; ++posting) {
+        sorted_.push_back(posting->ordinal);
+      }
+    }
+    if (ranges.size() > 1) {
+      sort(sorted_.begin(), sorted_.end());
+      sorted_.erase(unique(sorted_.begin(), sorted_.end()), sorted_.end());
+    }
+  }
+}
+
+bool OrdinalSet::empty() const { return bitmap_.empty() && sorted_.empty(); }
+
+bool OrdinalSet::IsBitmap() const { return !bitmap_.empty(); }
+
+bool OrdinalSet::ContainsSorted(int ordinal) const {
+  return binary_search(sorted_.begin(), sorted_.end(), ordinal);
+}
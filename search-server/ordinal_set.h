@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "inverted_index.h"
+
+// Set of document ordinals collected from posting lists. Dense sets are kept
+// as a bitmap over all ordinals, sparse ones as a sorted vector, so that a
+// handful of rare words does not cost a bitmap of the whole collection.
+class OrdinalSet {
+public:
+  OrdinalSet() = default;
+  // Posting arrays given as [begin, end) ranges, e.g. stored outside of an
+  // InvertedIndex.
+  using PostingRange = std::pair<const Posting *, const Posting *>;
+
+  OrdinalSet(const std::vector<const InvertedIndex::PostingList *> &lists,
+             size_t ordinal_count);
+  OrdinalSet(const std::vector<PostingRange> &ranges, size_t ordinal_count);
+
+  bool Contains(int ordinal) const {
+    if (!bitmap_.empty()) {
+      return (bitmap_[ordinal >> 6] >> (ordinal & 63)) & 1;
+    }
+    return !sorted_.empty() && ContainsSorted(ordinal);
+  }
+
+  bool empty() const;
+  bool IsBitmap() const;
+
+private:
+  std::vector<uint64_t> bitmap_;
+  std::vector<int> sorted_;
+
+  bool ContainsSorted(int ordinal) const;
+};
@@ -5,22 +5,71 @@
 
 using namespace std;
 
+JoinedDocuments::Iterator::Iterator(QueryResults::const_iterator query,
+                                    QueryResults::const_iterator query_end)
+    : query_(query), query_end_(query_end) {
+  SkipEmptyQueries();
+}
+
+JoinedDocuments::Iterator &JoinedDocuments::Iterator::operator++() {
+  if (++document_ == query_->end()) {
+    ++query_;
+    SkipEmptyQueries();
+  }
+  return *this;
+}
+
+JoinedDocuments::Iterator JoinedDocuments::Iterator::operator++(int) {
+  Iterator previous = *this;
+  ++*this;
+  return previous;
+}
+
+bool JoinedDocuments::Iterator::operator==(const Iterator &other) const {
+  // document_ is only meaningful before the end.
+  return query_ == other.query_ &&
+         (query_ == query_end_ || document_ == other.document_);
+}
+
+void JoinedDocuments::Iterator::SkipEmptyQueries() {
+  while (query_ != query_end_ && query_->empty()) {
+    ++query_;
+  }
+  if (query_ != query_end_) {
+    document_ = query_->begin();
+  }
+}
+
+JoinedDocuments::JoinedDocuments(QueryResults results)
+    : results_(move(results)) {
+  for (const auto &documents : results_) {
+    size_ += documents.size();
+  }
+}
+
+JoinedDocuments::Iterator JoinedDocuments::begin() const {
+  return Iterator(results_.begin(), results_.end());
+}
+
+JoinedDocuments::Iterator JoinedDocuments::end() const {
+  return Iterator(results_.end(), results_.end());
+}
+
+size_t JoinedDocuments::size() const { return size_; }
+
+bool JoinedDocuments::empty() const { return size_ == 0; }
+
+const JoinedDocuments::QueryResults &JoinedDocuments::GetQueryResults() const {
+  return results_;
+}
+
 vector<vector<Document>>
 ProcessQueries(const SearchServer &search_server,
                const vector<string> &queries) {
-  vector<vector<Document>> result(queries.size());
-  transform(execution::par, queries.begin(), queries.end(), result.begin(),
-            [&search_server](std::string_view query) {
-              return search_server.FindTopDocuments(query);
-            });
-  return result;
-}
-
-vector<Document> ProcessQueriesJoined(const SearchServer &search_server,
-                                      const vector<string> &queries) {
-  vector<Document> result;
-  for (auto v : ProcessQueries(search_server, queries)) {
-    result.insert(result.end(), v.begin(), v.end());
-  }
-  return result;
-}
\ No newline at end of file
+  return search_server.FindTopDocumentsBatch(queries);
+}
+
+JoinedDocuments ProcessQueriesJoined(const SearchServer &search_server,
+                                     const vector<string> &queries) {
+  return JoinedDocuments(ProcessQueries(search_server, queries));
+}
@@ -1,15 +1,91 @@
 #pragma once
 
+#include <algorithm>
+#include <execution>
+#include <iterator>
+#include <mutex>
 #include <vector>
 #include <string>
 
 #include "search_server.h"
 
+// Documents of a batch in query order, read in place from the per-query
+// results it owns; nothing is copied or flattened.
+class JoinedDocuments {
+public:
+  using QueryResults = std::vector<std::vector<Document>>;
 
+  class Iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Document;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Document *;
+    using reference = const Document &;
+
+    Iterator() = default;
+    Iterator(QueryResults::const_iterator query,
+             QueryResults::const_iterator query_end);
+
+    reference operator*() const { return *document_; }
+    pointer operator->() const { return &*document_; }
+    Iterator &operator++();
+    Iterator operator++(int);
+
+    bool operator==(const Iterator &other) const;
+    bool operator!=(const Iterator &other) const { return !(*this == other); }
+
+  private:
+    QueryResults::const_iterator query_;
+    QueryResults::const_iterator query_end_;
+    std::vector<Document>::const_iterator document_;
+
+    void SkipEmptyQueries();
+  };
+
+  explicit JoinedDocuments(QueryResults results);
+
+  Iterator begin() const;
+  Iterator end() const;
+  size_t size() const;
+  bool empty() const;
+
+  // Results of every query, in the order the queries were given.
+  const QueryResults &GetQueryResults() const;
+
+private:
+  QueryResults results_;
+  size_t size_ = 0;
+};
+
+// SearchServer::FindTopDocumentsBatch: each posting list is read once per
+// group of up to RelevanceAccumulator::MAX_POOLED_QUERIES distinct queries,
+// so once for the whole batch only when the batch fits in one group.
 std::vector<std::vector<Document>>
 ProcessQueries(const SearchServer &search_server,
                const std::vector<std::string> &queries);
 
-std::vector<Document>
+JoinedDocuments
 ProcessQueriesJoined(const SearchServer &search_server,
-                     const std::vector<std::string> &queries);
\ No newline at end of file
+                     const std::vector<std::string> &queries);
+
+// Runs the queries in parallel and hands each result to
+// consumer(query_index, std::vector<Document>&&) as soon as it is found,
+// without keeping it. Calls are serialized, so consumer does not need to be
+// thread-safe, but they come in completion order.
+template <typename Consumer>
+void ProcessQueriesStreaming(const SearchServer &search_server,
+                             const std::vector<std::string> &queries,
+                             Consumer consumer) {
+  std::vector<size_t> indices(queries.size());
+  for (size_t i = 0; i < indices.size(); ++i) {
+    indices[i] = i;
+  }
+  std::mutex consumer_mutex;
+  std::for_each(std::execution::par, indices.begin(), indices.end(),
+                [&](size_t i) {
+                  auto documents = search_server.FindTopDocuments(queries[i]);
+                  std::lock_guard lock(consumer_mutex);
+                  consumer(i, std::move(documents));
+                });
+}
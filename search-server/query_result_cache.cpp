@@ -0,0 +1,117 @@
+#include "query_result_cache.h"
+
+#include <functional>
+
+using namespace std;
+
+bool QueryResultCache::Key::operator==(const Key &other) const {
+  return plus_words == other.plus_words && minus_words == other.minus_words &&
+         filter.predicate_type == other.filter.predicate_type &&
+         filter.status == other.filter.status &&
+         max_result_count == other.max_result_count;
+}
+
+size_t QueryResultCache::KeyHash::operator()(const Key &key) const {
+  size_t seed = key.filter.predicate_type.hash_code();
+  const auto combine = [&seed](size_t value) {
+    seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+  };
+  combine(hash<int>()(key.filter.status));
+  combine(key.max_result_count);
+  for (const auto &word : key.plus_words) {
+    combine(hash<string>()(word));
+  }
+  // separates "a -b" from "a b"
+  combine(key.minus_words.size());
+  for (const auto &word : key.minus_words) {
+    combine(hash<string>()(word));
+  }
+  return seed;
+}
+
+QueryResultCache::QueryResultCache(size_t capacity) : capacity_(capacity) {}
+
+QueryResultCache::QueryResultCache(const QueryResultCache &other)
+    : capacity_(other.GetCapacity()) {}
+
+QueryResultCache &QueryResultCache::operator=(const QueryResultCache &other) {
+  if (this != &other) {
+    const size_t capacity = other.GetCapacity();
+    lock_guard lock(mutex_);
+    capacity_ = capacity;
+    entries_.clear();
+    index_.clear();
+    stats_ = {};
+  }
+  return *this;
+}
+
+QueryResultCache::Key
+QueryResultCache::MakeKey(const vector<string_view> &plus_words,
+                          const vector<string_view> &minus_words,
+                          Filter filter, size_t max_result_count) {
+  return {vector<string>(plus_words.begin(), plus_words.end()),
+          vector<string>(minus_words.begin(), minus_words.end()), filter,
+          max_result_count};
+}
+
+optional<vector<Document>> QueryResultCache::Find(const Key &key,
+                                                  uint64_t generation) {
+  lock_guard lock(mutex_);
+  SyncGeneration(generation);
+  auto it = index_.find(key);
+  if (index_.end() == it) {
+    ++stats_.misses;
+    return nullopt;
+  }
+  ++stats_.hits;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->documents;
+}
+
+void QueryResultCache::Insert(Key key, uint64_t generation,
+                              vector<Document> documents) {
+  lock_guard lock(mutex_);
+  if (capacity_ == 0) {
+    return;
+  }
+  SyncGeneration(generation);
+  auto it = index_.find(key);
+  if (index_.end() != it) {
+    // Another thread computed the same query meanwhile.
+    it->second->documents = move(documents);
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return;
+  }
+  if (entries_.size() == capacity_) {
+    index_.erase(entries_.back().key);
+    entries_.pop_back();
+    ++stats_.evictions;
+  }
+  entries_.push_front({move(key), move(documents)});
+  index_.emplace(entries_.front().key, entries_.begin());
+}
+
+QueryResultCache::Stats QueryResultCache::GetStats() const {
+  lock_guard lock(mutex_);
+  return stats_;
+}
+
+size_t QueryResultCache::size() const {
+  lock_guard lock(mutex_);
+  return entries_.size();
+}
+
+size_t QueryResultCache::GetCapacity() const {
+  lock_guard lock(mutex_);
+  return capacity_;
+}
+
+void QueryResultCache::SyncGeneration(uint64_t generation) {
+  if (generation != generation_) {
+    stats_.invalidations += entries_.size();
+    entries_.clear();
+    index_.clear();
+    generation_ = generation;
+  }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+
+// Bounded LRU cache of top-document results keyed by a normalized query.
+// Every lookup carries the index generation; when it differs from the one
+// the entries were computed in, the whole cache is dropped. All operations
+// are thread-safe. Copies start out empty with the same capacity.
+class QueryResultCache {
+public:
+  // What the matches were filtered by: the type of the filter, e.g.
+  // DocumentStatus, and its value.
+  struct Filter {
+    std::type_index predicate_type;
+    int status = 0;
+  };
+
+  struct Key {
+    std::vector<std::string> plus_words;
+    std::vector<std::string> minus_words;
+    Filter filter;
+    size_t max_result_count;
+
+    bool operator==(const Key &other) const;
+  };
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    // Entries dropped because documents were added or removed.
+    uint64_t invalidations = 0;
+  };
+
+  explicit QueryResultCache(size_t capacity);
+  QueryResultCache(const QueryResultCache &other);
+  QueryResultCache &operator=(const QueryResultCache &other);
+
+  // plus_words and minus_words must be sorted and unique.
+  static Key MakeKey(const std::vector<std::string_view> &plus_words,
+                     const std::vector<std::string_view> &minus_words,
+                     Filter filter, size_t max_result_count);
+
+  std::optional<std::vector<Document>> Find(const Key &key,
+                                            uint64_t generation);
+  void Insert(Key key, uint64_t generation, std::vector<Document> documents);
+
+  Stats GetStats() const;
+  size_t size() const;
+  size_t GetCapacity() const;
+
+private:
+  struct KeyHash {
+    size_t operator()(const Key &key) const;
+  };
+  struct Entry {
+    Key key;
+    std::vector<Document> documents;
+  };
+
+  mutable std::mutex mutex_;
+  size_t capacity_;
+  uint64_t generation_ = 0;
+  // Most recently used first.
+  std::list<Entry> entries_;
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+  Stats stats_;
+
+  void SyncGeneration(uint64_t generation);
+};
@@ -0,0 +1,57 @@
+#include "relevance_accumulator.h"
+
+#include <algorithm>
+
+using namespace std;
+
+RelevanceAccumulator::RelevanceAccumulator(size_t document_count,
+                                           size_t query_count)
+    : query_count_(query_count) {
+  auto &pool = GetPool();
+  if (pool.empty()) {
+    buffers_ = make_unique<Buffers>();
+  } else {
+    buffers_ = move(pool.back());
+    pool.pop_back();
+  }
+  const size_t slot_count = document_count * query_count;
+  if (buffers_->relevances.size() < slot_count) {
+    buffers_->relevances.resize(slot_count);
+    buffers_->seen.resize(slot_count);
+  }
+  if (buffers_->touched.size() < query_count) {
+    buffers_->touched.resize(query_count);
+  }
+}
+
+RelevanceAccumulator::~RelevanceAccumulator() {
+  // Sums of queries that were not taken, e.g. after an exception.
+  for (size_t query = 0; query < query_count_; ++query) {
+    Clear(query);
+  }
+  if (buffers_->relevances.size() <= MAX_POOLED_SLOTS &&
+      buffers_->touched.size() <= MAX_POOLED_QUERIES) {
+    GetPool().push_back(move(buffers_));
+  }
+}
+
+size_t RelevanceAccumulator::GetCachedDocumentCount(size_t query_count) {
+  constexpr size_t CACHED_SLOTS = size_t{1} << 15;
+  constexpr size_t MIN_DOCUMENT_COUNT = MAX_POOLED_SLOTS / MAX_POOLED_QUERIES;
+  return max(CACHED_SLOTS / max<size_t>(query_count, 1), MIN_DOCUMENT_COUNT);
+}
+
+void RelevanceAccumulator::Clear(size_t query) {
+  auto &touched = buffers_->touched[query];
+  for (const size_t document : touched) {
+    buffers_->relevances[document * query_count_ + query] = 0.0;
+    buffers_->seen[document * query_count_ + query] = false;
+  }
+  touched.clear();
+}
+
+vector<unique_ptr<RelevanceAccumulator::Buffers>> &
+RelevanceAccumulator::GetPool() {
+  thread_local vector<unique_ptr<Buffers>> pool;
+  return pool;
+}
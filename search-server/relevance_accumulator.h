@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "document.h"
+
+// Dense relevance sums of several queries scored together, one slot per
+// document (e.g. a document ordinal) and query. The arrays are taken from
+// a per-thread pool and given back on destruction, so repeated searches
+// allocate nothing; arrays of more than MAX_POOLED_SLOTS slots or
+// MAX_POOLED_QUERIES queries are freed instead, which bounds what an idle
+// thread keeps.
+class RelevanceAccumulator {
+public:
+  // 8 MiB of relevances.
+  static constexpr size_t MAX_POOLED_SLOTS = size_t{1} << 20;
+  static constexpr size_t MAX_POOLED_QUERIES = 4096;
+
+  RelevanceAccumulator(size_t document_count, size_t query_count = 1);
+  ~RelevanceAccumulator();
+
+  RelevanceAccumulator(const RelevanceAccumulator &) = delete;
+  RelevanceAccumulator &operator=(const RelevanceAccumulator &) = delete;
+
+  // How many documents the sums of query_count queries may span to stay in
+  // the CPU cache (about 288 KiB of slots), but at least 256; at most
+  // MAX_POOLED_QUERIES queries are pooled at this size.
+  static size_t GetCachedDocumentCount(size_t query_count);
+
+  void Add(size_t query, size_t document, double relevance) {
+    const size_t slot = document * query_count_ + query;
+    if (!buffers_->seen[slot]) {
+      buffers_->seen[slot] = true;
+      buffers_->touched[query].push_back(document);
+    }
+    buffers_->relevances[slot] += relevance;
+  }
+
+  // Calls make_document(document, relevance) for every document the query
+  // got a sum for, in document order, and returns the results. The sums of
+  // the query are cleared.
+  template <typename MakeDocument>
+  std::vector<Document> TakeDocuments(size_t query, MakeDocument make_document);
+
+private:
+  struct Buffers {
+    std::vector<double> relevances;
+    std::vector<char> seen;
+    std::vector<std::vector<size_t>> touched;
+  };
+
+  static std::vector<std::unique_ptr<Buffers>> &GetPool();
+
+  // Sums of one document are adjacent, as the queries of a group tend to
+  // share terms and are added to together.
+  size_t query_count_;
+  std::unique_ptr<Buffers> buffers_;
+
+  void Clear(size_t query);
+};
+
+template <typename MakeDocument>
+std::vector<Document>
+RelevanceAccumulator::TakeDocuments(size_t query, MakeDocument make_document) {
+  auto &touched = buffers_->touched[query];
+  std::sort(touched.begin(), touched.end());
+  std::vector<Document> documents;
+  documents.reserve(touched.size());
+  for (const size_t document : touched) {
+    documents.push_back(make_document(
+        document, buffers_->relevances[document * query_count_ + query]));
+  }
+  Clear(query);
+  return documents;
+}
@@ -3,13 +3,22 @@
 #include <iostream>
 #include <numeric>
 #include <stdexcept>
+#include <exception>
+#include <unordered_map>
 #include <execution>
 #include <deque>
 #include <future>
 #include <functional>
+#include <thread>
+#include <fstream>
+#include <limits>
 
 
 #include "log_duration.h"
+#include "binary_io.h"
+#include "tokenizer.h"
+#include "mutation_log.h"
+#include "relevance_accumulator.h"
 
 using namespace std;
 
@@ -22,30 +31,197 @@ SearchServer::SearchServer(const string &stop_words_text)
 void SearchServer::AddDocument(int document_id, const string_view &document,
                                DocumentStatus status,
                                const vector<int> &ratings) {
-  if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+  if ((document_id < 0) || (id_to_ordinal_.count(document_id) > 0)) {
     throw invalid_argument("Invalid document_id"s);
   }
 
-  const auto [it, inserted] = documents_.emplace(
-      document_id, DocumentData{ComputeAverageRating(ratings), status, string(document)});
-  const auto words = SplitIntoWordsNoStop(it->second.document);
+  const auto words = SplitIntoWordsNoStop(document);
+  const int ordinal =
+      AllocateOrdinal(document_id, status, ComputeAverageRating(ratings));
 
   const double inv_word_count = 1.0 / words.size();
+  map<string_view, double> word_freqs;
   for (const auto &word : words) {
-    word_to_document_freqs_[word][document_id] += inv_word_count;
-    doc_to_words_freqs_[document_id][word] += inv_word_count;
+    word_freqs[word] += inv_word_count;
+  }
+  // Both indexes key on the term strings owned by the inverted index.
+  auto &doc_words = doc_to_words_freqs_[document_id];
+  for (const auto [word, term_freq] : word_freqs) {
+    doc_words.emplace_hint(
+        doc_words.end(),
+        word_to_document_freqs_.AddPosting(word, ordinal, term_freq),
+        term_freq);
   }
   document_ids_.insert(document_id);
+  if (mutation_log_.log != nullptr) {
+    log_sequence_ = mutation_log_.log->AppendAddDocument(document_id, document,
+                                                         status, ratings);
+  }
+}
+
+void SearchServer::AddDocuments(const vector<NewDocument> &documents) {
+  AddDocuments(documents, TokenizeDocuments(execution::par, documents));
+}
+
+SearchServer::TokenizedBatch
+SearchServer::TokenizeDocuments(execution::sequenced_policy policy,
+                                const vector<NewDocument> &documents) const {
+  return TokenizeDocumentsImpl(policy, documents);
+}
+
+SearchServer::TokenizedBatch
+SearchServer::TokenizeDocuments(execution::parallel_policy policy,
+                                const vector<NewDocument> &documents) const {
+  return TokenizeDocumentsImpl(policy, documents);
+}
+
+template <typename ExecutionPolicy>
+SearchServer::TokenizedBatch
+SearchServer::TokenizeDocumentsImpl(ExecutionPolicy &&policy,
+                                    const vector<NewDocument> &documents) const {
+  TokenizedBatch tokenized(documents.size());
+  transform(policy, documents.begin(), documents.end(), tokenized.begin(),
+            [this](const NewDocument &document) {
+              TokenizedDocument result;
+              try {
+                auto words = SplitIntoWordsNoStop(document.text);
+                sort(words.begin(), words.end());
+                const double inv_word_count = 1.0 / words.size();
+                for (const auto word : words) {
+                  if (result.word_freqs.empty() ||
+                      result.word_freqs.back().first != word) {
+                    result.word_freqs.push_back({word, 0.0});
+                  }
+                  result.word_freqs.back().second += inv_word_count;
+                }
+              } catch (...) {
+                result.error = current_exception();
+              }
+              result.rating = ComputeAverageRating(document.ratings);
+              return result;
+            });
+  return tokenized;
+}
+
+void SearchServer::AddDocuments(const vector<NewDocument> &documents,
+                                const TokenizedBatch &tokenized) {
+  if (tokenized.size() != documents.size()) {
+    throw invalid_argument("Tokenized batch does not match the documents"s);
+  }
+  // The first rejected document ends the batch, like a loop of AddDocument.
+  size_t accepted_count = 0;
+  exception_ptr error;
+  set<int> batch_ids;
+  for (; accepted_count < documents.size(); ++accepted_count) {
+    const int document_id = documents[accepted_count].id;
+    if (document_id < 0 || id_to_ordinal_.count(document_id) > 0 ||
+        !batch_ids.insert(document_id).second) {
+      error = make_exception_ptr(invalid_argument("Invalid document_id"s));
+      break;
+    }
+    if (tokenized[accepted_count].error) {
+      error = tokenized[accepted_count].error;
+      break;
+    }
+  }
+
+  vector<int> ordinals(accepted_count);
+  for (size_t i = 0; i < accepted_count; ++i) {
+    ordinals[i] = AllocateOrdinal(documents[i].id, documents[i].status,
+                                  tokenized[i].rating);
+  }
+
+  // Every task collects the postings of a contiguous slice of the batch.
+  using PartialPostings = unordered_map<string_view, InvertedIndex::PostingList>;
+  const size_t chunk_count =
+      min<size_t>(max(1u, thread::hardware_concurrency()) * 4,
+                  max<size_t>(1, accepted_count / 256));
+  vector<PartialPostings> partials(chunk_count);
+  vector<size_t> chunk_indices(chunk_count);
+  iota(chunk_indices.begin(), chunk_indices.end(), 0);
+  for_each(execution::par, chunk_indices.begin(), chunk_indices.end(),
+           [&](size_t chunk) {
+             const size_t end = accepted_count * (chunk + 1) / chunk_count;
+             for (size_t i = accepted_count * chunk / chunk_count; i < end; ++i) {
+               for (const auto &[word, term_freq] : tokenized[i].word_freqs) {
+                 partials[chunk][word].push_back({ordinals[i], term_freq});
+               }
+             }
+           });
+
+  // Merge the partial lists term by term, in sorted term order.
+  unordered_map<string_view, vector<const InvertedIndex::PostingList *>>
+      term_to_partials;
+  for (const auto &partial : partials) {
+    for (const auto &[word, term_postings] : partial) {
+      term_to_partials[word].push_back(&term_postings);
+    }
+  }
+  vector<string_view> terms;
+  terms.reserve(term_to_partials.size());
+  for (const auto &[word, _] : term_to_partials) {
+    terms.push_back(word);
+  }
+  sort(terms.begin(), terms.end());
+  unordered_map<string_view, string_view> owned_words;
+  InvertedIndex::PostingList term_postings;
+  for (const string_view word : terms) {
+    term_postings.clear();
+    for (const auto *partial : term_to_partials.at(word)) {
+      term_postings.insert(term_postings.end(), partial->begin(),
+                           partial->end());
+    }
+    // Recycled ordinals break the batch order.
+    if (!is_sorted(term_postings.begin(), term_postings.end(),
+                   [](const Posting &lhs, const Posting &rhs) {
+                     return lhs.ordinal < rhs.ordinal;
+                   })) {
+      sort(term_postings.begin(), term_postings.end(),
+           [](const Posting &lhs, const Posting &rhs) {
+             return lhs.ordinal < rhs.ordinal;
+           });
+    }
+    owned_words.emplace(word,
+                        word_to_document_freqs_.AddPostings(word, term_postings));
+  }
+
+  vector<map<string_view, double> *> doc_words(accepted_count);
+  for (size_t i = 0; i < accepted_count; ++i) {
+    doc_words[i] = &doc_to_words_freqs_[documents[i].id];
+    document_ids_.insert(documents[i].id);
+  }
+  vector<size_t> batch_indices(accepted_count);
+  iota(batch_indices.begin(), batch_indices.end(), 0);
+  for_each(execution::par, batch_indices.begin(), batch_indices.end(),
+           [&](size_t i) {
+             for (const auto &[word, term_freq] : tokenized[i].word_freqs) {
+               doc_words[i]->emplace_hint(doc_words[i]->end(),
+                                          owned_words.at(word), term_freq);
+             }
+           });
+
+  if (mutation_log_.log != nullptr) {
+    for (size_t i = 0; i < accepted_count; ++i) {
+      log_sequence_ = mutation_log_.log->AppendAddDocument(
+          documents[i].id, documents[i].text, documents[i].status,
+          documents[i].ratings);
+    }
+  }
+  if (error) {
+    rethrow_exception(error);
+  }
 }
 
 tuple<vector<string_view>, DocumentStatus>
 SearchServer::MatchDocument(string_view raw_query, int document_id) const {
-  const auto query = ParseQuery(raw_query, false);
+  LOG_LATENCY("match");
+  const auto scratch = ParseScratchQuery(raw_query);
+  const Query &query = *scratch;
 
   vector<string_view> matched_words;
+  const int ordinal = id_to_ordinal_.at(document_id);
   auto f = [&](const string_view &word) {
-    return ((word_to_document_freqs_.count(word) != 0) &&
-            (word_to_document_freqs_.at(word).count(document_id) > 0));
+    return word_to_document_freqs_.Contains(word, ordinal);
   };
   auto it = query.minus_words.empty() ? query.minus_words.end()
                                       : find_if(query.minus_words.begin(),
@@ -53,18 +229,13 @@ SearchServer::MatchDocument(string_view raw_query, int document_id) const {
   if (query.minus_words.end() == it) {
 
     for (const auto &word : query.plus_words) {
-      auto item = word_to_document_freqs_.find(word);
-      if (word_to_document_freqs_.end() == item) {
-          continue;
-      }
-      
-      if (item->second.count(document_id) > 0) {
-        matched_words.push_back(item->first);
+      if (word_to_document_freqs_.Contains(word, ordinal)) {
+        matched_words.push_back(word_to_document_freqs_.FindTerm(word));
       }
     }
 
   }
-  return {matched_words, documents_.at(document_id).status};
+  return {matched_words, statuses_[ordinal]};
 }
 
 tuple<vector<string_view>, DocumentStatus>
@@ -76,6 +247,8 @@ SearchServer::MatchDocument(execution::sequenced_policy policy,
 tuple<vector<string_view>, DocumentStatus>
 SearchServer::MatchDocument(execution::parallel_policy policy,
     string_view raw_query, int document_id) const {
+    LOG_LATENCY("match");
+    const int ordinal = id_to_ordinal_.at(document_id);
     auto words = SplitIntoWords(raw_query);
 
     vector<string_view> matched_words;
@@ -83,10 +256,10 @@ SearchServer::MatchDocument(execution::parallel_policy policy,
     vector<string_view> tmp_words(words.size());
 
     auto f = [&](const string_view& word) {
-        auto it = word_to_document_freqs_.find(string(word));
-        return pair(((word_to_document_freqs_.end() != it) &&
-            (it->second.count(document_id) > 0)),
-            it);
+        const auto term = word_to_document_freqs_.FindTerm(word);
+        return pair(!term.empty() &&
+            word_to_document_freqs_.Contains(term, ordinal),
+            term);
     };
     bool is_valid = true;
     bool found = false;
@@ -101,7 +274,7 @@ SearchServer::MatchDocument(execution::parallel_policy policy,
                     }
                     else {
                         found = true;
-                        return item.second->first;
+                        return item.second;
                     }
                 }
             }
@@ -119,14 +292,13 @@ SearchServer::MatchDocument(execution::parallel_policy policy,
         matched_words = vector<string_view>(size);
         copy(policy, it, move_iterator(u_it), matched_words.begin());
     }
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, statuses_[ordinal] };
 }
 
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query,
-                                                DocumentStatus status) const {
-  return FindTopDocuments(
-      raw_query, [status](int document_id, DocumentStatus document_status,
-                          int rating) { return document_status == status; });
+                                                DocumentStatus status,
+                                                size_t max_result_count) const {
+  return FindTopDocuments(raw_query, StatusPredicate{status}, max_result_count);
 }
 
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
@@ -134,7 +306,7 @@ vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
 }
 
 bool SearchServer::IsStopWord(const string_view &word) const {
-  return stop_words_.count(word) > 0;
+  return stop_word_set_.Contains(word);
 }
 
 bool SearchServer::IsValidWord(const string_view &word) {
@@ -145,15 +317,14 @@ bool SearchServer::IsValidWord(const string_view &word) {
 
 vector<string_view> SearchServer::SplitIntoWordsNoStop(const string_view &text) const {
   vector<string_view> words;
-  for (const auto &word : SplitIntoWords(text)) {
-    //if (word.empty() || word[0] == '-' || !IsValidWord(word))
-      if (!IsValidWord(word)) {
-      throw invalid_argument("Word "s + string(word) + " is invalid"s);
-    }
-    if (!IsStopWord(word)) {
-      words.push_back(word);
-    }
+  const size_t first_invalid = TokenizeWords(text, words);
+  if (first_invalid < words.size()) {
+    throw invalid_argument("Word "s + string(words[first_invalid]) +
+                           " is invalid"s);
   }
+  words.erase(remove_if(words.begin(), words.end(),
+                        [this](string_view word) { return IsStopWord(word); }),
+              words.end());
   return words;
 }
 
@@ -165,7 +336,41 @@ int SearchServer::ComputeAverageRating(const vector<int> &ratings) {
          static_cast<int>(ratings.size());
 }
 
+int SearchServer::AllocateOrdinal(int document_id, DocumentStatus status,
+                                  int rating) {
+  int ordinal;
+  if (free_ordinals_.empty()) {
+    ordinal = static_cast<int>(ordinal_to_id_.size());
+    ordinal_to_id_.push_back(document_id);
+    ratings_.push_back(rating);
+    statuses_.push_back(status);
+  } else {
+    ordinal = free_ordinals_.back();
+    free_ordinals_.pop_back();
+    ordinal_to_id_[ordinal] = document_id;
+    ratings_[ordinal] = rating;
+    statuses_[ordinal] = status;
+  }
+  id_to_ordinal_.emplace(document_id, ordinal);
+  word_to_document_freqs_.SetDocumentCount(GetDocumentCount());
+  ++generation_;
+  return ordinal;
+}
+
+void SearchServer::ReleaseOrdinal(int document_id) {
+  auto it = id_to_ordinal_.find(document_id);
+  free_ordinals_.push_back(it->second);
+  id_to_ordinal_.erase(it);
+  word_to_document_freqs_.SetDocumentCount(GetDocumentCount());
+  ++generation_;
+}
+
 SearchServer::QueryWord SearchServer::ParseQueryWord(const string_view &text) const {
+  return ParseQueryWord(text, IsValidWord(text));
+}
+
+SearchServer::QueryWord SearchServer::ParseQueryWord(const string_view &text,
+                                                     bool is_valid) const {
   if (text.empty()) {
     throw invalid_argument("Query word is empty"s);
   }
@@ -175,7 +380,7 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(const string_view &text) co
     is_minus = true;
     word.remove_prefix(1);
   }
-  if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
+  if (word.empty() || word[0] == '-' || !is_valid) {
     throw invalid_argument("Query word "s + string(word) + " is invalid");
   }
   return {word, is_minus, IsStopWord(word)};
@@ -183,14 +388,26 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(const string_view &text) co
 
 SearchServer::Query SearchServer::ParseQuery(string_view text, bool skip_sort) const {
   Query result;
-  result.plus_words.reserve(1000);
-  result.minus_words.reserve(1000);
-  auto begin = text.begin();
-  auto it = text.begin();
-  size_t count = 0;
-
-  auto process_word = [&](string_view word) {
-    const auto query_word = ParseQueryWord(word);
+  vector<string_view> words;
+  ParseQuery(text, skip_sort, words, result);
+  return result;
+}
+
+SearchServer::ScratchQuery SearchServer::ParseScratchQuery(string_view text) const {
+  LOG_LATENCY("parse");
+  ScratchQuery query;
+  ParseQuery(text, false, query.buffers_->words, query.buffers_->query);
+  return query;
+}
+
+void SearchServer::ParseQuery(string_view text, bool skip_sort,
+                              vector<string_view> &words, Query &result) const {
+  result.plus_words.clear();
+  result.minus_words.clear();
+  words.clear();
+  const size_t first_invalid = TokenizeWords(text, words);
+  for (size_t i = 0; i < words.size(); ++i) {
+    const auto query_word = ParseQueryWord(words[i], i < first_invalid);
     if (!query_word.is_stop) {
       if (query_word.is_minus) {
         result.minus_words.push_back(query_word.data);
@@ -198,40 +415,565 @@ SearchServer::Query SearchServer::ParseQuery(string_view text, bool skip_sort) c
         result.plus_words.push_back(query_word.data);
       }
     }
+  }
+
+  if (!skip_sort) {
+    // Parallel algorithms only pay off far beyond typical query sizes.
+    static const size_t PARALLEL_DEDUP_MIN_SIZE = 4096;
+    for (auto *query_words : {&result.plus_words, &result.minus_words}) {
+      if (query_words->size() < PARALLEL_DEDUP_MIN_SIZE) {
+        sort(query_words->begin(), query_words->end());
+        query_words->erase(unique(query_words->begin(), query_words->end()),
+                           query_words->end());
+      } else {
+        sort(execution::par, query_words->begin(), query_words->end());
+        query_words->erase(
+            unique(execution::par, query_words->begin(), query_words->end()),
+            query_words->end());
+      }
+    }
+  }
+}
+
+SearchServer::ScratchQuery::ScratchQuery() {
+  auto &pool = GetPool();
+  if (pool.empty()) {
+    buffers_ = make_unique<Buffers>();
+  } else {
+    buffers_ = move(pool.back());
+    pool.pop_back();
+  }
+}
+
+SearchServer::ScratchQuery::ScratchQuery(ScratchQuery &&other) noexcept
+    : buffers_(move(other.buffers_)) {}
+
+SearchServer::ScratchQuery::~ScratchQuery() {
+  if (buffers_) {
+    GetPool().push_back(move(buffers_));
+  }
+}
+
+vector<unique_ptr<SearchServer::ScratchQuery::Buffers>> &
+SearchServer::ScratchQuery::GetPool() {
+  thread_local vector<unique_ptr<Buffers>> pool;
+  return pool;
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(const string_view &word) const {
+  return word_to_document_freqs_.GetInverseDocumentFreq(word);
+}
+
+OrdinalSet SearchServer::CollectMinusDocuments(const Query &query) const {
+  vector<const InvertedIndex::PostingList *> lists;
+  for (const auto &word : query.minus_words) {
+    if (const auto *postings = word_to_document_freqs_.FindPostings(word)) {
+      lists.push_back(postings);
+    }
+  }
+  return OrdinalSet(lists, ordinal_to_id_.size());
+}
+
+vector<SearchServer::OrdinalRange>
+SearchServer::SplitOrdinalRanges(size_t max_range_size) const {
+  // Ranges below this size cost more to set up than they save.
+  constexpr int MIN_RANGE_SIZE = 1024;
+  const int ordinal_count = static_cast<int>(ordinal_to_id_.size());
+  const int task_count = max(1u, thread::hardware_concurrency()) * 4;
+  const int range_count =
+      max(clamp(ordinal_count / MIN_RANGE_SIZE, 1, task_count),
+          static_cast<int>((ordinal_count + max_range_size - 1) /
+                           max_range_size));
+
+  vector<OrdinalRange> ranges;
+  ranges.reserve(range_count);
+  for (int i = 0; i < range_count; ++i) {
+    ranges.push_back({static_cast<int>(int64_t{ordinal_count} * i / range_count),
+                      static_cast<int>(int64_t{ordinal_count} * (i + 1) /
+                                       range_count)});
+  }
+  return ranges;
+}
+
+bool SearchServer::IsMoreRelevant(const Document &lhs, const Document &rhs) {
+  if (abs(lhs.relevance - rhs.relevance) < DOUBLE_TOLERANCE) {
+    return lhs.rating > rhs.rating;
+  }
+  return lhs.relevance > rhs.relevance;
+}
+
+void SearchServer::SelectTopDocuments(vector<Document> &documents,
+                                      size_t max_result_count) {
+  LOG_LATENCY("sort");
+  if (documents.size() > max_result_count) {
+    partial_sort(documents.begin(), documents.begin() + max_result_count,
+                 documents.end(), IsMoreRelevant);
+    documents.resize(max_result_count);
+  } else {
+    sort(documents.begin(), documents.end(), IsMoreRelevant);
+  }
+}
+
+void SearchServer::SelectTopDocuments(execution::parallel_policy policy,
+                                      vector<Document> &documents,
+                                      size_t max_result_count) {
+  const size_t chunk_count = max(1u, thread::hardware_concurrency());
+  if (documents.size() <= max_result_count * chunk_count) {
+    SelectTopDocuments(documents, max_result_count);
+    return;
+  }
+  LOG_LATENCY("sort");
+
+  // Every chunk keeps its own top max_result_count in front, then the
+  // winners of all chunks compete for the final positions.
+  const size_t chunk_size = (documents.size() + chunk_count - 1) / chunk_count;
+  vector<size_t> chunks(chunk_count);
+  iota(chunks.begin(), chunks.end(), 0);
+  for_each(policy, chunks.begin(), chunks.end(), [&](size_t chunk) {
+    const auto begin = documents.begin() +
+                       min(chunk * chunk_size, documents.size());
+    const auto end = documents.begin() +
+                     min((chunk + 1) * chunk_size, documents.size());
+    const auto middle =
+        begin + min(max_result_count, static_cast<size_t>(end - begin));
+    partial_sort(begin, middle, end, IsMoreRelevant);
+  });
+
+  vector<Document> candidates;
+  candidates.reserve(max_result_count * chunk_count);
+  for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+    const size_t begin = min(chunk * chunk_size, documents.size());
+    const size_t end = min(begin + max_result_count,
+                           min((chunk + 1) * chunk_size, documents.size()));
+    candidates.insert(candidates.end(), documents.begin() + begin,
+                      documents.begin() + end);
+  }
+  SelectTopDocuments(candidates, max_result_count);
+  documents = move(candidates);
+}
+
+vector<vector<Document>>
+SearchServer::FindTopDocumentsBatch(const vector<string> &raw_queries,
+                                    size_t max_result_count) const {
+  vector<Query> parsed_queries(raw_queries.size());
+  transform(execution::par, raw_queries.begin(), raw_queries.end(),
+            parsed_queries.begin(), [this](string_view raw_query) {
+              return ParseQuery(raw_query, false);
+            });
+
+  // Word lists of a parsed query are sorted and unique, so equal queries
+  // compare equal here.
+  const auto query_less = [](const Query *lhs, const Query *rhs) {
+    return tie(lhs->plus_words, lhs->minus_words) <
+           tie(rhs->plus_words, rhs->minus_words);
+  };
+  map<const Query *, size_t, decltype(query_less)> query_to_unique(query_less);
+  vector<const Query *> unique_queries;
+  vector<size_t> unique_indices(parsed_queries.size());
+  for (size_t i = 0; i < parsed_queries.size(); ++i) {
+    const auto [it, inserted] =
+        query_to_unique.emplace(&parsed_queries[i], unique_queries.size());
+    if (inserted) {
+      unique_queries.push_back(&parsed_queries[i]);
+    }
+    unique_indices[i] = it->second;
+  }
+
+  // Every distinct plus word is looked up and weighted by its IDF once, and
+  // remembers the queries that use it.
+  vector<string_view> terms;
+  for (const Query *query : unique_queries) {
+    terms.insert(terms.end(), query->plus_words.begin(),
+                 query->plus_words.end());
+  }
+  sort(terms.begin(), terms.end());
+  terms.erase(unique(terms.begin(), terms.end()), terms.end());
+  vector<InvertedIndex::TermStats> term_stats(terms.size());
+  vector<vector<size_t>> term_queries(terms.size());
+  for (size_t query = 0; query < unique_queries.size(); ++query) {
+    for (const string_view word : unique_queries[query]->plus_words) {
+      const size_t term =
+          lower_bound(terms.begin(), terms.end(), word) - terms.begin();
+      term_queries[term].push_back(query);
+    }
+  }
+  for (size_t term = 0; term < terms.size(); ++term) {
+    term_stats[term] = word_to_document_freqs_.FindTermStats(terms[term]);
+  }
+  vector<OrdinalSet> excluded(unique_queries.size());
+  transform(execution::par, unique_queries.begin(), unique_queries.end(),
+            excluded.begin(), [this](const Query *query) {
+              return CollectMinusDocuments(*query);
+            });
+
+  // Queries are scored in groups of up to MAX_POOLED_QUERIES, term at a
+  // time: each posting list is streamed once per group and every posting is
+  // added into all the queries of the group that use the term. Tasks own
+  // disjoint ordinal ranges, small enough for the sums of the group to stay
+  // in cache, so the accumulators need no locking. A query gets its terms in
+  // word order, as in the single-query search, so the relevances are summed
+  // in the same order.
+  vector<vector<Document>> unique_results(unique_queries.size());
+  for (size_t group_begin = 0; group_begin < unique_queries.size();
+       group_begin += RelevanceAccumulator::MAX_POOLED_QUERIES) {
+    const size_t group_end =
+        min(group_begin + RelevanceAccumulator::MAX_POOLED_QUERIES,
+            unique_queries.size());
+    const auto ranges = SplitOrdinalRanges(
+        RelevanceAccumulator::GetCachedDocumentCount(group_end - group_begin));
+    // Terms of the group with the group-relative slots of their queries.
+    vector<pair<size_t, vector<size_t>>> group_terms;
+    for (size_t term = 0; term < terms.size(); ++term) {
+      vector<size_t> slots;
+      for (const size_t query : term_queries[term]) {
+        if (query >= group_begin && query < group_end) {
+          slots.push_back(query - group_begin);
+        }
+      }
+      if (!slots.empty() && term_stats[term].postings != nullptr) {
+        group_terms.emplace_back(term, move(slots));
+      }
+    }
+
+    vector<vector<vector<Document>>> range_results(ranges.size());
+    transform(
+        execution::par, ranges.begin(), ranges.end(), range_results.begin(),
+        [&](OrdinalRange range) {
+          RelevanceAccumulator relevances(range.end - range.begin,
+                                          group_end - group_begin);
+          for (const auto &[term, slots] : group_terms) {
+            const auto &stats = term_stats[term];
+            const auto &postings = *stats.postings;
+            auto posting = lower_bound(postings.begin(), postings.end(),
+                                       range.begin,
+                                       [](const Posting &posting, int value) {
+                                         return posting.ordinal < value;
+                                       });
+            for (; posting != postings.end() && posting->ordinal < range.end;
+                 ++posting) {
+              const int ordinal = posting->ordinal;
+              if (statuses_[ordinal] != DocumentStatus::ACTUAL) {
+                continue;
+              }
+              const double relevance =
+                  posting->term_freq * stats.inverse_document_freq;
+              for (const size_t slot : slots) {
+                if (!excluded[group_begin + slot].Contains(ordinal)) {
+                  relevances.Add(slot, ordinal - range.begin, relevance);
+                }
+              }
+            }
+          }
+          vector<vector<Document>> documents(group_end - group_begin);
+          for (size_t slot = 0; slot < documents.size(); ++slot) {
+            documents[slot] = relevances.TakeDocuments(
+                slot, [&](size_t document, double relevance) {
+                  const int ordinal = range.begin + static_cast<int>(document);
+                  return Document(ordinal_to_id_[ordinal], relevance,
+                                  ratings_[ordinal]);
+                });
+          }
+          return documents;
+        });
+
+    vector<size_t> slots(group_end - group_begin);
+    iota(slots.begin(), slots.end(), 0);
+    for_each(execution::par, slots.begin(), slots.end(), [&](size_t slot) {
+      // Ranges are in ordinal order, so ties are broken as in the
+      // single-query search.
+      auto &matched_documents = unique_results[group_begin + slot];
+      for (auto &documents : range_results) {
+        matched_documents.insert(matched_documents.end(),
+                                 documents[slot].begin(),
+                                 documents[slot].end());
+      }
+      SelectTopDocuments(matched_documents, max_result_count);
+    });
+  }
+
+  vector<vector<Document>> results(raw_queries.size());
+  for (size_t i = 0; i < results.size(); ++i) {
+    results[i] = unique_results[unique_indices[i]];
+  }
+  return results;
+}
+
+void SearchServer::SetResultCacheCapacity(size_t capacity) {
+  if (capacity == 0) {
+    result_cache_.reset();
+  } else {
+    result_cache_.emplace(capacity);
+  }
+}
+
+QueryResultCache::Stats SearchServer::GetResultCacheStats() const {
+  return result_cache_ ? result_cache_->GetStats() : QueryResultCache::Stats();
+}
+
+uint64_t SearchServer::GetGeneration() const { return generation_; }
+
+optional<QueryResultCache::Filter>
+SearchServer::GetCacheFilter(const StatusPredicate &document_predicate) {
+  return QueryResultCache::Filter{typeid(DocumentStatus),
+                                  static_cast<int>(document_predicate.status)};
+}
+
+namespace {
+
+constexpr uint32_t SNAPSHOT_MAGIC = 0x53534958;  // "XISS" on disk
+constexpr uint32_t SNAPSHOT_VERSION = 2;
+constexpr int FREE_ORDINAL_ID = -1;
+
+// Bytes left in a seekable stream, or the largest value when the stream
+// cannot report its size. Used to reject counts that the file cannot hold
+// before allocating for them.
+uint64_t RemainingBytes(istream &input) {
+  const auto position = input.tellg();
+  if (position == istream::pos_type(-1)) {
+    return numeric_limits<uint64_t>::max();
+  }
+  input.seekg(0, ios::end);
+  const auto end = input.tellg();
+  input.seekg(position);
+  if (end == istream::pos_type(-1) || end < position) {
+    return numeric_limits<uint64_t>::max();
+  }
+  return static_cast<uint64_t>(end - position);
+}
+
+} // namespace
+
+void SearchServer::SaveSnapshot(ostream &output) const {
+  WriteValue(output, SNAPSHOT_MAGIC);
+  WriteValue(output, SNAPSHOT_VERSION);
+  WriteValue(output, BYTE_ORDER_MARK);
+  WriteValue(output, log_sequence_);
+
+  WriteValue(output, static_cast<uint64_t>(stop_words_.size()));
+  for (const auto &word : stop_words_) {
+    WriteString(output, word);
+  }
+
+  // Ordinals of removed documents are written with FREE_ORDINAL_ID so the
+  // postings can be stored as they are.
+  vector<int> ids(ordinal_to_id_.size(), FREE_ORDINAL_ID);
+  for (const auto [document_id, ordinal] : id_to_ordinal_) {
+    ids[ordinal] = document_id;
+  }
+  vector<uint8_t> statuses(statuses_.size());
+  transform(statuses_.begin(), statuses_.end(), statuses.begin(),
+            [](DocumentStatus status) { return static_cast<uint8_t>(status); });
+  WriteValue(output, static_cast<uint64_t>(ids.size()));
+  WriteArray(output, ids.data(), ids.size());
+  WriteArray(output, ratings_.data(), ratings_.size());
+  WriteArray(output, statuses.data(), statuses.size());
+  WriteValue(output, static_cast<uint64_t>(free_ordinals_.size()));
+  WriteArray(output, free_ordinals_.data(), free_ordinals_.size());
+
+  WriteValue(output, static_cast<uint64_t>(word_to_document_freqs_.GetTermCount()));
+  vector<int> ordinals;
+  vector<double> term_freqs;
+  word_to_document_freqs_.ForEachTerm(
+      [&](string_view word, const InvertedIndex::PostingList &postings) {
+        ordinals.clear();
+        term_freqs.clear();
+        for (const auto [ordinal, term_freq] : postings) {
+          ordinals.push_back(ordinal);
+          term_freqs.push_back(term_freq);
+        }
+        WriteString(output, word);
+        WriteValue(output, static_cast<uint64_t>(postings.size()));
+        WriteArray(output, ordinals.data(), ordinals.size());
+        WriteArray(output, term_freqs.data(), term_freqs.size());
+      });
+  WriteValue(output, SNAPSHOT_MAGIC);
+  if (!output) {
+    throw runtime_error("Failed to write index snapshot"s);
+  }
+}
+
+void SearchServer::SaveSnapshot(const string &path) const {
+  ofstream output(path, ios::binary);
+  if (!output) {
+    throw runtime_error("Cannot open "s + path + " for writing"s);
+  }
+  SaveSnapshot(output);
+}
+
+SearchServer SearchServer::LoadSnapshot(istream &input) {
+  if (ReadValue<uint32_t>(input) != SNAPSHOT_MAGIC) {
+    throw runtime_error("Not an index snapshot"s);
+  }
+  const auto version = ReadValue<uint32_t>(input);
+  if (version != SNAPSHOT_VERSION) {
+    throw runtime_error("Unsupported index snapshot version "s +
+                        to_string(version));
+  }
+  if (ReadValue<uint32_t>(input) != BYTE_ORDER_MARK) {
+    throw runtime_error("Index snapshot has a different byte order"s);
+  }
+  const auto log_sequence = ReadValue<uint64_t>(input);
+
+  // Every count is checked against the bytes left before it is allocated
+  // for, so a corrupted count fails like a truncated file.
+  uint64_t remaining = RemainingBytes(input);
+  const auto consume = [&remaining](uint64_t count, uint64_t item_size) {
+    if (count > remaining / item_size) {
+      throw runtime_error("Corrupted index snapshot"s);
+    }
+    remaining -= count * item_size;
+  };
+  const auto read_count = [&](uint64_t item_size) {
+    consume(1, sizeof(uint64_t));
+    const auto count = ReadValue<uint64_t>(input);
+    consume(count, item_size);
+    return count;
+  };
+  // The length of a string is consumed with the count of its list.
+  const auto read_string = [&] {
+    string text = ReadString(input, remaining);
+    remaining -= text.size();
+    return text;
   };
 
-  while (text.end() != it) {
-    if (*it == ' ') {
-      if (count > 0) {
-        process_word(text.substr(distance(text.begin(), begin), count));
+  vector<string> stop_words(read_count(sizeof(uint32_t)));
+  for (auto &word : stop_words) {
+    word = read_string();
+  }
+  SearchServer server(stop_words);
+  server.log_sequence_ = log_sequence;
+
+  constexpr uint64_t ORDINAL_RECORD_SIZE =
+      sizeof(int) + sizeof(decltype(server.ratings_)::value_type) +
+      sizeof(uint8_t);
+  const auto ordinal_count = read_count(ORDINAL_RECORD_SIZE);
+  if (ordinal_count > static_cast<uint64_t>(numeric_limits<int>::max())) {
+    throw runtime_error("Corrupted index snapshot"s);
+  }
+  vector<int> ids(ordinal_count);
+  vector<uint8_t> statuses(ordinal_count);
+  server.ratings_.resize(ordinal_count);
+  ReadArray(input, ids.data(), ids.size());
+  ReadArray(input, server.ratings_.data(), server.ratings_.size());
+  ReadArray(input, statuses.data(), statuses.size());
+  const auto free_count = read_count(sizeof(int));
+  if (free_count > ordinal_count) {
+    throw runtime_error("Corrupted index snapshot"s);
+  }
+  server.free_ordinals_.resize(free_count);
+  ReadArray(input, server.free_ordinals_.data(), server.free_ordinals_.size());
+
+  // A free ordinal is handed out again by AllocateOrdinal, so each one must
+  // be in range, listed once and not hold a document.
+  vector<bool> is_free(ordinal_count, false);
+  for (const int ordinal : server.free_ordinals_) {
+    if (ordinal < 0 || static_cast<uint64_t>(ordinal) >= ordinal_count ||
+        is_free[ordinal] || ids[ordinal] != FREE_ORDINAL_ID) {
+      throw runtime_error("Corrupted index snapshot"s);
+    }
+    is_free[ordinal] = true;
+  }
+  if (static_cast<size_t>(count(ids.begin(), ids.end(), FREE_ORDINAL_ID)) !=
+      free_count) {
+    throw runtime_error("Corrupted index snapshot"s);
+  }
+
+  server.ordinal_to_id_ = ids;
+  server.statuses_.resize(ordinal_count);
+  vector<map<string_view, double> *> doc_words(ordinal_count, nullptr);
+  for (size_t ordinal = 0; ordinal < ordinal_count; ++ordinal) {
+    if (statuses[ordinal] > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+      throw runtime_error("Corrupted index snapshot"s);
+    }
+    server.statuses_[ordinal] = static_cast<DocumentStatus>(statuses[ordinal]);
+    if (ids[ordinal] != FREE_ORDINAL_ID) {
+      if (!server.id_to_ordinal_.emplace(ids[ordinal], static_cast<int>(ordinal))
+               .second) {
+        throw runtime_error("Corrupted index snapshot"s);
       }
-      count = 0;
-      begin = it + 1;
+      server.document_ids_.insert(ids[ordinal]);
+      doc_words[ordinal] = &server.doc_to_words_freqs_[ids[ordinal]];
+    }
+  }
+  server.word_to_document_freqs_.SetDocumentCount(server.GetDocumentCount());
 
-    } else {
-      ++count;
-      if (it + 1 == text.end()) {
-        process_word(text.substr(distance(text.begin(), begin), count));
+  // A term takes at least its word length and posting count.
+  const auto term_count = read_count(sizeof(uint32_t) + sizeof(uint64_t));
+  vector<string_view> terms;
+  terms.reserve(term_count);
+  vector<int> ordinals;
+  vector<double> term_freqs;
+  vector<size_t> term_offsets = {0};
+  InvertedIndex::PostingList postings;
+  for (uint64_t term = 0; term < term_count; ++term) {
+    const string word = read_string();
+    const auto posting_count = ReadValue<uint64_t>(input);
+    consume(posting_count, sizeof(int) + sizeof(double));
+    const size_t offset = ordinals.size();
+    ordinals.resize(offset + posting_count);
+    term_freqs.resize(offset + posting_count);
+    ReadArray(input, ordinals.data() + offset, posting_count);
+    ReadArray(input, term_freqs.data() + offset, posting_count);
+
+    postings.clear();
+    for (size_t i = offset; i < ordinals.size(); ++i) {
+      if (ordinals[i] < 0 || static_cast<uint64_t>(ordinals[i]) >= ordinal_count ||
+          doc_words[ordinals[i]] == nullptr ||
+          (i > offset && ordinals[i] <= ordinals[i - 1])) {
+        throw runtime_error("Corrupted index snapshot"s);
       }
+      postings.push_back({ordinals[i], term_freqs[i]});
     }
-    ++it;
+    terms.push_back(server.word_to_document_freqs_.AddPostings(word, postings));
+    term_offsets.push_back(ordinals.size());
   }
-  
-  if (!skip_sort) {
-    for (auto *words : {&result.plus_words, &result.minus_words}) {
-      sort(execution::par, words->begin(), words->end());
-      words->erase(unique(execution::par, words->begin(), words->end()), words->end());
+
+  // Regroup the postings by document, keeping the word order, and fill the
+  // word maps of different documents in parallel.
+  vector<size_t> doc_offsets(ordinal_count + 1, 0);
+  for (const int ordinal : ordinals) {
+    ++doc_offsets[ordinal + 1];
+  }
+  partial_sum(doc_offsets.begin(), doc_offsets.end(), doc_offsets.begin());
+  vector<pair<uint32_t, double>> doc_postings(ordinals.size());
+  vector<size_t> next = doc_offsets;
+  for (size_t term = 0; term < terms.size(); ++term) {
+    for (size_t i = term_offsets[term]; i < term_offsets[term + 1]; ++i) {
+      doc_postings[next[ordinals[i]]++] = {static_cast<uint32_t>(term),
+                                           term_freqs[i]};
     }
   }
-  return result;
+  vector<size_t> all_ordinals(ordinal_count);
+  iota(all_ordinals.begin(), all_ordinals.end(), 0);
+  for_each(execution::par, all_ordinals.begin(), all_ordinals.end(),
+           [&](size_t ordinal) {
+             for (size_t i = doc_offsets[ordinal]; i < doc_offsets[ordinal + 1];
+                  ++i) {
+               doc_words[ordinal]->emplace_hint(doc_words[ordinal]->end(),
+                                                terms[doc_postings[i].first],
+                                                doc_postings[i].second);
+             }
+           });
+  if (ReadValue<uint32_t>(input) != SNAPSHOT_MAGIC) {
+    throw runtime_error("Corrupted index snapshot"s);
+  }
+  ++server.generation_;
+  return server;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const string_view &word) const {
-  return log(GetDocumentCount() * 1.0 /
-             word_to_document_freqs_.at(string(word)).size());
+SearchServer SearchServer::LoadSnapshot(const string &path) {
+  ifstream input(path, ios::binary);
+  if (!input) {
+    throw runtime_error("Cannot open "s + path);
+  }
+  return LoadSnapshot(input);
 }
 
-int SearchServer::GetDocumentCount() const { return documents_.size(); }
+void SearchServer::SetMutationLog(MutationLog *log) { mutation_log_.log = log; }
+
+uint64_t SearchServer::GetLogSequence() const { return log_sequence_; }
+
+int SearchServer::GetDocumentCount() const { return id_to_ordinal_.size(); }
 
 std::set<int>::const_iterator SearchServer::begin() const {
   return document_ids_.begin();
@@ -251,22 +993,23 @@ SearchServer::GetWordFrequencies(int document_id) const {
 }
 
  void SearchServer::RemoveDocument(int document_id) {
-  auto doc_it = find(document_ids_.begin(), document_ids_.end(), document_id);
+  auto doc_it = document_ids_.find(document_id);
   if (document_ids_.end() == doc_it) {
     return;
   }
   auto it = doc_to_words_freqs_.find(document_id);
   if (doc_to_words_freqs_.end() != it) {
+    const int ordinal = id_to_ordinal_.at(document_id);
     for (auto w : it->second) {
-      word_to_document_freqs_[w.first].erase(document_id);
-      if (word_to_document_freqs_[w.first].empty()) {
-        word_to_document_freqs_.erase(w.first);
-      }
+      word_to_document_freqs_.RemovePosting(w.first, ordinal);
     }
     doc_to_words_freqs_.erase(document_id);
   }
   document_ids_.erase(doc_it);
-  documents_.erase(document_id);
+  ReleaseOrdinal(document_id);
+  if (mutation_log_.log != nullptr) {
+    log_sequence_ = mutation_log_.log->AppendRemoveDocument(document_id);
+  }
  }
 
  void SearchServer::RemoveDocument(std::execution::sequenced_policy policy,
@@ -276,33 +1019,43 @@ SearchServer::GetWordFrequencies(int document_id) const {
 
  void SearchServer::RemoveDocument(std::execution::parallel_policy policy,
                                   int document_id) {
-  auto doc_it = std::find(document_ids_.begin(), document_ids_.end(),
-                          document_id);
-  if (document_ids_.end() == doc_it) {
-    return;
+  RemoveDocuments({document_id});
+ }
+
+void SearchServer::RemoveDocuments(const vector<int> &document_ids) {
+  vector<int> removed_ids;
+  for (const int document_id : document_ids) {
+    if (document_ids_.count(document_id) > 0) {
+      removed_ids.push_back(document_id);
+    }
   }
-  
+  sort(removed_ids.begin(), removed_ids.end());
+  removed_ids.erase(unique(removed_ids.begin(), removed_ids.end()),
+                    removed_ids.end());
 
-  auto it = doc_to_words_freqs_.find(document_id);
-  if (doc_to_words_freqs_.end() != it) {
-    std::vector<string_view> words_for_erase(it->second.size());
-    std::transform(
-        std::execution::par, it->second.begin(), it->second.end(),
-        words_for_erase.begin(),
-        [](std::pair<std::string_view, double> word) { return word.first; });
-    mutex m;
-    std::for_each(std::execution::par, words_for_erase.begin(),
-                  words_for_erase.end(), [&](const auto word) {
-                    {
-                      lock_guard<mutex> lock(m);
-                      word_to_document_freqs_[word].erase(document_id);
-                      if (word_to_document_freqs_[word].empty()) {
-                        word_to_document_freqs_.erase(word);
-                      }
-                    }
-                  });
+  // The word maps hold index-owned views, so a term is identified by the
+  // address of its characters and no string is hashed.
+  unordered_map<const char *, size_t> term_to_removal;
+  vector<InvertedIndex::TermRemoval> removals;
+  for (const int document_id : removed_ids) {
+    const int ordinal = id_to_ordinal_.at(document_id);
+    for (const auto &[word, _] : doc_to_words_freqs_.at(document_id)) {
+      const auto [it, inserted] =
+          term_to_removal.emplace(word.data(), removals.size());
+      if (inserted) {
+        removals.push_back({word, {}});
+      }
+      removals[it->second].ordinals.push_back(ordinal);
+    }
+  }
+  word_to_document_freqs_.RemovePostings(move(removals));
+
+  for (const int document_id : removed_ids) {
     doc_to_words_freqs_.erase(document_id);
+    document_ids_.erase(document_id);
+    ReleaseOrdinal(document_id);
+    if (mutation_log_.log != nullptr) {
+      log_sequence_ = mutation_log_.log->AppendRemoveDocument(document_id);
+    }
   }
-  document_ids_.erase(doc_it);
-  documents_.erase(document_id);
- }
\ No newline at end of file
+}
\ No newline at end of file
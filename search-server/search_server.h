@@ -1,59 +1,168 @@
-#pragma once
+﻿#pragma once
 
 #include <algorithm>
 #include <functional>
+#include <exception>
 #include <map>
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 #include <cmath>
 #include <execution>
 #include <unordered_set>
 #include <string_view>
 #include <cassert>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <optional>
+#include <memory>
+#include <typeinfo>
+#include <type_traits>
+#include <istream>
+#include <ostream>
 
 #include "document.h"
 #include "read_input_functions.h"
 #include "string_processing.h"
-#include "concurrent_map.h"
+#include "inverted_index.h"
+#include "ordinal_set.h"
+#include "query_result_cache.h"
+#include "stop_word_set.h"
+#include "log_duration.h"
 
 static const int MAX_RESULT_DOCUMENT_COUNT = 5;
 static const double DOUBLE_TOLERANCE = 1.0e-6;
 
+// Passed to FindTopDocuments in place of an execution policy. Posting lists
+// are then walked document-at-a-time and documents whose score bound cannot
+// reach the current top are skipped (MaxScore). Results are the same as
+// with the exhaustive search.
+struct MaxScoreRetrieval {};
+inline constexpr MaxScoreRetrieval max_score_retrieval{};
+
+// One document of an AddDocuments batch; text must outlive the call.
+struct NewDocument {
+  int id;
+  std::string_view text;
+  DocumentStatus status;
+  std::vector<int> ratings;
+};
+
+class MutationLog;
+
 class SearchServer {
 public:
   using MatchedResult = std::tuple<std::vector<std::string_view>, DocumentStatus>;
+  // Words copied out of the index, for servers whose index may change once
+  // the call returns.
+  using OwnedMatchedResult = std::tuple<std::vector<std::string>, DocumentStatus>;
   
   template <typename StringContainer>
   explicit SearchServer(const StringContainer &stop_words);
   explicit SearchServer(const std::string_view &stop_words_text);
   explicit SearchServer(const std::string &stop_words_text);
+  // Uses the stop-word table built by the compiler as is.
+  template <size_t N>
+  explicit SearchServer(const FrozenStopWordSet<N> &stop_words);
 
 
   void AddDocument(int document_id, const std::string_view &document,
                    DocumentStatus status, const std::vector<int> &ratings);
-
-
+  // Same result as calling AddDocument for each document in order: if one
+  // is rejected, the documents before it are added and its invalid_argument
+  // is thrown. Documents are tokenized in parallel and their postings are
+  // merged into the index in a single pass over the sorted terms.
+  void AddDocuments(const std::vector<NewDocument> &documents);
+
+  // A document of a batch split into words, with its average rating, or the
+  // error that rejects it. Words point into the text of the document.
+  struct TokenizedDocument {
+    std::vector<std::pair<std::string_view, double>> word_freqs;  // sorted by word
+    int rating = 0;
+    std::exception_ptr error;
+  };
+  using TokenizedBatch = std::vector<TokenizedDocument>;
+
+  // The tokenizing half of AddDocuments. It only reads the stop words, so a
+  // pipeline may tokenize the next batch on another thread while this
+  // server indexes the previous one.
+  TokenizedBatch TokenizeDocuments(std::execution::sequenced_policy,
+                                   const std::vector<NewDocument> &documents) const;
+  TokenizedBatch TokenizeDocuments(std::execution::parallel_policy,
+                                   const std::vector<NewDocument> &documents) const;
+  // The indexing half: tokenized must be TokenizeDocuments(documents) of a
+  // server with the same stop words.
+  void AddDocuments(const std::vector<NewDocument> &documents,
+                    const TokenizedBatch &tokenized);
+
+
+  // max_result_count bounds the result size; only that many documents are
+  // ordered, the rest of the matches are discarded unsorted.
   template <typename DocumentPredicate>
   std::vector<Document>
   FindTopDocuments(std::string_view raw_query,
-                   DocumentPredicate document_predicate) const;
+                   DocumentPredicate document_predicate,
+                   size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
 template <typename ExecutionPolicy, typename DocumentPredicate>
   std::vector<Document>
   FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query,
-                   DocumentPredicate document_predicate) const;
+                   DocumentPredicate document_predicate,
+                   size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
   std::vector<Document> FindTopDocuments(std::string_view raw_query,
-                                         DocumentStatus status) const;
+                                         DocumentStatus status,
+                                         size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
   template <typename ExecutionPolicy>
   std::vector<Document> FindTopDocuments(ExecutionPolicy policy,
-       std::string_view raw_query, DocumentStatus status) const;
+       std::string_view raw_query, DocumentStatus status,
+       size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
   std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
   template <typename ExecutionPolicy>
   std::vector<Document> FindTopDocuments(ExecutionPolicy policy,
        std::string_view raw_query) const;
 
 
+  // Runs every query as FindTopDocuments(raw_query, DocumentStatus::ACTUAL,
+  // max_result_count) would, but for the batch as a whole: queries that are
+  // equal after normalization run once, and every distinct term is looked
+  // up and weighted by its IDF once. Queries are scored in groups of up to
+  // RelevanceAccumulator::MAX_POOLED_QUERIES distinct queries, which bounds
+  // the memory of the sums, and a posting list is read once per group
+  // however many of its queries use it: once per batch only for batches
+  // that fit in one group.
+  std::vector<std::vector<Document>>
+  FindTopDocumentsBatch(const std::vector<std::string> &raw_queries,
+                        size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+
+  // Caches up to capacity top-document results keyed by the normalized
+  // query; 0 turns the cache off (the default). Only searches filtered by
+  // status are cached; searches with a predicate always run.
+  void SetResultCacheCapacity(size_t capacity);
+  QueryResultCache::Stats GetResultCacheStats() const;
+  // Bumped by every document insertion and removal.
+  uint64_t GetGeneration() const;
+
+  // Versioned binary snapshot of the whole index: log sequence number, stop
+  // words, document metadata, terms and postings. Loading reads it
+  // sequentially without tokenizing; the forward index is rebuilt from the
+  // postings. Unreadable or incompatible snapshots throw std::runtime_error.
+  void SaveSnapshot(std::ostream &output) const;
+  void SaveSnapshot(const std::string &path) const;
+  static SearchServer LoadSnapshot(std::istream &input);
+  static SearchServer LoadSnapshot(const std::string &path);
+
+  // Appends every later accepted insertion and removal to log; nullptr
+  // detaches it. Recovery is LoadSnapshot followed by MutationLog::Replay.
+  // The log is not owned, and copies of the server are not attached to it.
+  void SetMutationLog(MutationLog *log);
+  // Log sequence number of the last mutation logged or replayed; 0 if there
+  // was none. Snapshots store it, see MutationLog.
+  uint64_t GetLogSequence() const;
+
+
   int GetDocumentCount() const;
   const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
 
@@ -63,6 +172,9 @@ template <typename ExecutionPolicy, typename DocumentPredicate>
   void RemoveDocument(std::execution::parallel_policy policy, int document_id);
   void RemoveDocument(std::execution::sequenced_policy policy, int document_id);
   void RemoveDocument(int document_id);
+  // Unknown ids are ignored. Postings of all the documents are grouped by
+  // term and every affected posting list is rewritten once, in parallel.
+  void RemoveDocuments(const std::vector<int> &document_ids);
   
 
   MatchedResult MatchDocument(std::string_view raw_query, int document_id) const;
@@ -72,18 +184,46 @@ template <typename ExecutionPolicy, typename DocumentPredicate>
 
 
 private:
-  struct DocumentData {
-    int rating;
-    DocumentStatus status;
-    const std::string document;
-  };
-
+  friend class ShardedSearchServer;
+  friend class MappedSearchServer;
+  friend class MutationLog;
 
   const std::set<std::string, std::less<>> stop_words_;
-  std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
+  // The same words, hashed for IsStopWord.
+  const StopWordSet stop_word_set_;
+  InvertedIndex word_to_document_freqs_;
   std::map<int, std::map<std::string_view, double>> doc_to_words_freqs_;
-  std::map<int, DocumentData> documents_;
   std::set<int> document_ids_;
+
+  // Postings refer to documents by dense ordinals; per-document metadata is
+  // kept in parallel arrays indexed by ordinal. Ordinals of removed documents
+  // are recycled through free_ordinals_.
+  std::map<int, int> id_to_ordinal_;
+  std::vector<int> ordinal_to_id_;
+  std::vector<int> ratings_;
+  std::vector<DocumentStatus> statuses_;
+  std::vector<int> free_ordinals_;
+
+  uint64_t generation_ = 0;
+  mutable std::optional<QueryResultCache> result_cache_;
+
+  struct MutationLogLink {
+    MutationLog *log = nullptr;
+
+    MutationLogLink() = default;
+    MutationLogLink(const MutationLogLink &) {}
+    MutationLogLink &operator=(const MutationLogLink &) { return *this; }
+  } mutation_log_;
+  uint64_t log_sequence_ = 0;
+
+  struct StatusPredicate {
+    DocumentStatus status;
+
+    bool operator()(int /*document_id*/, DocumentStatus document_status,
+                    int /*rating*/) const {
+      return document_status == status;
+    }
+  };
   
   struct QueryWord {
     std::string_view data;
@@ -97,6 +237,32 @@ private:
     std::vector<std::string_view> minus_words;
   };
 
+  // Parsed query whose buffers are taken from a per-thread pool and given
+  // back on destruction, so parsing allocates nothing once the buffers have
+  // grown. A nested parse on the same thread takes another set of buffers.
+  class ScratchQuery {
+  public:
+    ScratchQuery();
+    ScratchQuery(ScratchQuery &&other) noexcept;
+    ScratchQuery &operator=(ScratchQuery &&) = delete;
+    ~ScratchQuery();
+
+    const Query &operator*() const { return buffers_->query; }
+    const Query *operator->() const { return &buffers_->query; }
+
+  private:
+    friend class SearchServer;
+
+    struct Buffers {
+      Query query;
+      std::vector<std::string_view> words;
+    };
+
+    static std::vector<std::unique_ptr<Buffers>> &GetPool();
+
+    std::unique_ptr<Buffers> buffers_;
+  };
+
   
   bool IsStopWord(const std::string_view &word) const;
 
@@ -105,20 +271,87 @@ private:
 
   
   std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view &text) const;
+  template <typename ExecutionPolicy>
+  TokenizedBatch TokenizeDocumentsImpl(ExecutionPolicy &&policy,
+                                       const std::vector<NewDocument> &documents) const;
 
   
   static int ComputeAverageRating(const std::vector<int> &ratings);
 
+  int AllocateOrdinal(int document_id, DocumentStatus status, int rating);
+  void ReleaseOrdinal(int document_id);
+
   
   QueryWord ParseQueryWord(const std::string_view &text) const;
+  // is_valid tells whether text is free of control characters, when the
+  // tokenizer has already checked it.
+  QueryWord ParseQueryWord(const std::string_view &text, bool is_valid) const;
 
   
   Query ParseQuery(std::string_view text, bool skip_sort = true) const;
+  // Sorted and deduplicated, like ParseQuery(text, false).
+  ScratchQuery ParseScratchQuery(std::string_view text) const;
+  // Fills result, using words for the tokens; both are cleared first.
+  void ParseQuery(std::string_view text, bool skip_sort,
+                  std::vector<std::string_view> &words, Query &result) const;
 
 
   double ComputeWordInverseDocumentFreq(const std::string_view &word) const;
+  // Documents containing any minus word; they are skipped while scoring.
+  OrdinalSet CollectMinusDocuments(const Query &query) const;
+
+
+  static bool IsMoreRelevant(const Document &lhs, const Document &rhs);
+  // Leaves the max_result_count most relevant documents in order.
+  static void SelectTopDocuments(std::vector<Document> &documents,
+                                 size_t max_result_count);
+  static void SelectTopDocuments(std::execution::parallel_policy policy,
+                                 std::vector<Document> &documents,
+                                 size_t max_result_count);
 
 
+  template <typename DocumentPredicate>
+  std::vector<Document>
+  FindTopDocumentsMaxScore(const Query &query,
+                           DocumentPredicate document_predicate,
+                           size_t max_result_count) const;
+
+  // inverse_document_freq(i, term_stats) supplies the IDF of the i-th plus
+  // word, letting a sharded caller score with collection-wide statistics.
+  template <typename DocumentPredicate, typename InverseDocumentFreq>
+  std::vector<Document>
+  ScoreDocuments(const Query &query, DocumentPredicate document_predicate,
+                 InverseDocumentFreq inverse_document_freq) const;
+
+  // Half-open range of document ordinals scored by one parallel task.
+  struct OrdinalRange {
+    int begin;
+    int end;
+  };
+
+  // Ranges also get cut to at most max_range_size ordinals.
+  std::vector<OrdinalRange> SplitOrdinalRanges(
+      size_t max_range_size = std::numeric_limits<int>::max()) const;
+  template <typename DocumentPredicate>
+  std::vector<Document>
+  ScoreOrdinalRange(OrdinalRange range,
+                    const std::vector<InvertedIndex::TermStats> &terms,
+                    const OrdinalSet &excluded,
+                    DocumentPredicate document_predicate) const;
+
+  template <typename DocumentPredicate>
+  static std::optional<QueryResultCache::Filter>
+  GetCacheFilter(const DocumentPredicate &document_predicate);
+  static std::optional<QueryResultCache::Filter>
+  GetCacheFilter(const StatusPredicate &document_predicate);
+  // Serves the query from the result cache when possible, otherwise runs
+  // search() and caches its result.
+  template <typename DocumentPredicate, typename Search>
+  std::vector<Document>
+  FindTopDocumentsCached(const Query &query,
+                         const DocumentPredicate &document_predicate,
+                         size_t max_result_count, Search search) const;
+
   template <typename DocumentPredicate> std::vector<Document> FindAllDocuments(const SearchServer::Query &query, DocumentPredicate document_predicate) const;
   template <typename ExecutionPolicy, typename DocumentPredicate> std::vector<Document>
       FindAllDocuments(ExecutionPolicy, const SearchServer::Query &query, DocumentPredicate document_predicate) const;
@@ -127,165 +360,348 @@ private:
 template <typename StringContainer>
 SearchServer::SearchServer(const StringContainer &stop_words)
     : stop_words_(
-          MakeUniqueNonEmptyStrings(stop_words)) // Extract non-empty stop words
+          MakeUniqueNonEmptyStrings(stop_words)), // Extract non-empty stop words
+      stop_word_set_(stop_words_)
 {
   if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
     throw std::invalid_argument("Some of stop words are invalid");
   }
 }
 
+template <size_t N>
+SearchServer::SearchServer(const FrozenStopWordSet<N> &stop_words)
+    : stop_words_(MakeUniqueNonEmptyStrings(stop_words)),
+      stop_word_set_(stop_words) {
+  if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
+    throw std::invalid_argument("Some of stop words are invalid");
+  }
+}
+
 template <typename DocumentPredicate>
 std::vector<Document>
 SearchServer::FindTopDocuments(std::string_view raw_query,
-                 DocumentPredicate document_predicate) const {
-  const auto query = ParseQuery(raw_query, false);
-
-  auto matched_documents = FindAllDocuments(query, document_predicate);
-
-  sort(matched_documents.begin(), matched_documents.end(),
-       [](const Document &lhs, const Document &rhs) {
-         if (std::abs(lhs.relevance - rhs.relevance) < DOUBLE_TOLERANCE) {
-           return lhs.rating > rhs.rating;
-         } else {
-           return lhs.relevance > rhs.relevance;
-         }
-       });
-  if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-    matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-  }
+                 DocumentPredicate document_predicate,
+                 size_t max_result_count) const {
+  const auto scratch = ParseScratchQuery(raw_query);
+  const Query &query = *scratch;
+  return FindTopDocumentsCached(
+      query, document_predicate, max_result_count, [&] {
+        auto matched_documents = FindAllDocuments(query, document_predicate);
+        SelectTopDocuments(matched_documents, max_result_count);
+        return matched_documents;
+      });
+}
 
-  return matched_documents;
+template <typename DocumentPredicate>
+std::optional<QueryResultCache::Filter>
+SearchServer::GetCacheFilter(const DocumentPredicate & /*document_predicate*/) {
+  // An arbitrary predicate may read state outside of itself, even when its
+  // type is empty, so only status filters are cached.
+  return std::nullopt;
+}
+
+template <typename DocumentPredicate, typename Search>
+std::vector<Document> SearchServer::FindTopDocumentsCached(
+    const Query &query, const DocumentPredicate &document_predicate,
+    size_t max_result_count, Search search) const {
+  if (!result_cache_) {
+    return search();
+  }
+  const auto filter = GetCacheFilter(document_predicate);
+  if (!filter) {
+    return search();
+  }
+  auto key = QueryResultCache::MakeKey(query.plus_words, query.minus_words,
+                                       *filter, max_result_count);
+  if (auto documents = result_cache_->Find(key, generation_)) {
+    return std::move(*documents);
+  }
+  auto documents = search();
+  result_cache_->Insert(std::move(key), generation_, documents);
+  return documents;
 }
 
 template <typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document>
 SearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query,
-    DocumentPredicate document_predicate) const {
+    DocumentPredicate document_predicate, size_t max_result_count) const {
     if constexpr (
-        is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
-        return FindTopDocuments(raw_query, document_predicate);
+        std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+        return FindTopDocuments(raw_query, document_predicate, max_result_count);
+    }
+    else if constexpr (std::is_same_v<ExecutionPolicy, MaxScoreRetrieval>) {
+        const auto scratch = ParseScratchQuery(raw_query);
+        const Query &query = *scratch;
+        return FindTopDocumentsCached(query, document_predicate, max_result_count, [&] {
+            return FindTopDocumentsMaxScore(query, document_predicate, max_result_count);
+        });
     }
     else {
-        const auto query = ParseQuery(raw_query, false);
-
-        auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-
-        sort(policy, matched_documents.begin(), matched_documents.end(),
-            [](const Document& lhs, const Document& rhs) {
-                if (std::abs(lhs.relevance - rhs.relevance) < DOUBLE_TOLERANCE) {
-                    return lhs.rating > rhs.rating;
-                }
-                else {
-                    return lhs.relevance > rhs.relevance;
-                }
+        const auto scratch = ParseScratchQuery(raw_query);
+        const Query &query = *scratch;
+        return FindTopDocumentsCached(query, document_predicate, max_result_count, [&] {
+            auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+            SelectTopDocuments(std::execution::par, matched_documents, max_result_count);
+            return matched_documents;
+        });
+    }
+}
+
+template <typename DocumentPredicate>
+std::vector<Document>
+SearchServer::FindTopDocumentsMaxScore(const Query &query,
+                                       DocumentPredicate document_predicate,
+                                       size_t max_result_count) const {
+  LOG_LATENCY("score");
+  struct TermCursor {
+    const Posting *current;
+    const Posting *end;
+    double inverse_document_freq;
+    double upper_bound;
+  };
+
+  std::vector<Document> candidates;
+  if (max_result_count == 0) {
+    return candidates;
+  }
+
+  std::vector<TermCursor> cursors;
+  for (const auto &word : query.plus_words) {
+    const auto term = word_to_document_freqs_.FindTermStats(word);
+    if (term.postings != nullptr) {
+      const Posting *begin = term.postings->data();
+      cursors.push_back({begin, begin + term.postings->size(),
+                         term.inverse_document_freq,
+                         term.max_term_freq * term.inverse_document_freq});
+    }
+  }
+  // Terms with the smallest bounds become non-essential first: once their
+  // bounds together stay below the threshold they are only probed for
+  // documents found through the essential terms.
+  std::sort(cursors.begin(), cursors.end(),
+            [](const TermCursor &lhs, const TermCursor &rhs) {
+              return lhs.upper_bound < rhs.upper_bound;
             });
-        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-        }
+  std::vector<double> bound_sums(cursors.size());
+  std::transform_inclusive_scan(
+      cursors.begin(), cursors.end(), bound_sums.begin(), std::plus<>(),
+      [](const TermCursor &cursor) { return cursor.upper_bound; });
+
+  const OrdinalSet excluded = CollectMinusDocuments(query);
+  // The max_result_count best relevances so far. A document has to score
+  // at least threshold - DOUBLE_TOLERANCE to compete for the result, since
+  // closer relevances are ordered by rating.
+  std::priority_queue<double, std::vector<double>, std::greater<>> top_relevances;
+  double threshold = -std::numeric_limits<double>::infinity();
+  size_t first_essential = 0;
+
+  while (true) {
+    while (first_essential < cursors.size() &&
+           bound_sums[first_essential] < threshold - DOUBLE_TOLERANCE) {
+      ++first_essential;
+    }
+    int ordinal = std::numeric_limits<int>::max();
+    for (size_t i = first_essential; i < cursors.size(); ++i) {
+      if (cursors[i].current != cursors[i].end) {
+        ordinal = std::min(ordinal, cursors[i].current->ordinal);
+      }
+    }
+    if (ordinal == std::numeric_limits<int>::max()) {
+      break;
+    }
 
-        return matched_documents;
+    double relevance = 0.0;
+    for (size_t i = first_essential; i < cursors.size(); ++i) {
+      auto &cursor = cursors[i];
+      if (cursor.current != cursor.end && cursor.current->ordinal == ordinal) {
+        relevance += cursor.current->term_freq * cursor.inverse_document_freq;
+        ++cursor.current;
+      }
+    }
+    if (excluded.Contains(ordinal) ||
+        !document_predicate(ordinal_to_id_[ordinal], statuses_[ordinal],
+                            ratings_[ordinal])) {
+      continue;
+    }
+
+    bool pruned = false;
+    for (size_t i = first_essential; i-- > 0;) {
+      if (relevance + bound_sums[i] < threshold - DOUBLE_TOLERANCE) {
+        pruned = true;
+        break;
+      }
+      auto &cursor = cursors[i];
+      cursor.current = std::lower_bound(
+          cursor.current, cursor.end, ordinal,
+          [](const Posting &posting, int value) {
+            return posting.ordinal < value;
+          });
+      if (cursor.current != cursor.end && cursor.current->ordinal == ordinal) {
+        relevance += cursor.current->term_freq * cursor.inverse_document_freq;
+      }
+    }
+    if (pruned || relevance < threshold - DOUBLE_TOLERANCE) {
+      continue;
+    }
+
+    candidates.push_back(
+        {ordinal_to_id_[ordinal], relevance, ratings_[ordinal]});
+    top_relevances.push(relevance);
+    if (top_relevances.size() > max_result_count) {
+      top_relevances.pop();
+    }
+    if (top_relevances.size() == max_result_count) {
+      threshold = top_relevances.top();
     }
+  }
+
+  candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                  [threshold](const Document &document) {
+                                    return document.relevance <
+                                           threshold - DOUBLE_TOLERANCE;
+                                  }),
+                   candidates.end());
+  SelectTopDocuments(candidates, max_result_count);
+  return candidates;
 }
 
 template <typename DocumentPredicate>
 std::vector<Document>
 SearchServer::FindAllDocuments(const SearchServer::Query &query,
                  DocumentPredicate document_predicate) const {
+  LOG_LATENCY("score");
+  return ScoreDocuments(query, document_predicate,
+                        [](size_t, const InvertedIndex::TermStats &term) {
+                          return term.inverse_document_freq;
+                        });
+}
+
+template <typename DocumentPredicate, typename InverseDocumentFreq>
+std::vector<Document>
+SearchServer::ScoreDocuments(const Query &query,
+                             DocumentPredicate document_predicate,
+                             InverseDocumentFreq inverse_document_freq) const {
+  const OrdinalSet excluded = CollectMinusDocuments(query);
   std::map<int, double> document_to_relevance;
-  for (const auto &word : query.plus_words) {
-    if (word_to_document_freqs_.count(word) == 0) {
+  for (size_t i = 0; i < query.plus_words.size(); ++i) {
+    const auto term = word_to_document_freqs_.FindTermStats(query.plus_words[i]);
+    if (term.postings == nullptr) {
       continue;
     }
-    const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-    for (const auto [document_id, term_freq] :
-         word_to_document_freqs_.at(word)) {
-      const auto &document_data = documents_.at(document_id);
-      if (document_predicate(document_id, document_data.status,
-                             document_data.rating)) {
-        document_to_relevance[document_id] += term_freq * inverse_document_freq;
+    const double word_inverse_document_freq = inverse_document_freq(i, term);
+    for (const auto [ordinal, term_freq] : *term.postings) {
+      if (!excluded.Contains(ordinal) &&
+          document_predicate(ordinal_to_id_[ordinal], statuses_[ordinal],
+                             ratings_[ordinal])) {
+        document_to_relevance[ordinal] += term_freq * word_inverse_document_freq;
       }
     }
   }
-  
-  for (const auto &word : query.minus_words) {
-    if (word_to_document_freqs_.count(word) == 0) {
-      continue;
-    }
-    for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-      document_to_relevance.erase(document_id);
+
+  std::vector<Document> matched_documents;
+  for (const auto [ordinal, relevance] : document_to_relevance) {
+    matched_documents.push_back(
+        {ordinal_to_id_[ordinal], relevance, ratings_[ordinal]});
+  }
+  return matched_documents;
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::ScoreOrdinalRange(
+    OrdinalRange range, const std::vector<InvertedIndex::TermStats> &terms,
+    const OrdinalSet &excluded, DocumentPredicate document_predicate) const {
+  enum : char { UNSEEN, ACCEPTED, REJECTED };
+  const size_t range_size = range.end - range.begin;
+  std::vector<double> relevances(range_size);
+  std::vector<char> states(range_size, UNSEEN);
+  for (const auto &term : terms) {
+    const auto &postings = *term.postings;
+    auto posting = std::lower_bound(postings.begin(), postings.end(),
+                                    range.begin,
+                                    [](const Posting &posting, int value) {
+                                      return posting.ordinal < value;
+                                    });
+    for (; posting != postings.end() && posting->ordinal < range.end;
+         ++posting) {
+      const int ordinal = posting->ordinal;
+      char &state = states[ordinal - range.begin];
+      if (state == UNSEEN) {
+        state = !excluded.Contains(ordinal) &&
+                        document_predicate(ordinal_to_id_[ordinal],
+                                           statuses_[ordinal],
+                                           ratings_[ordinal])
+                    ? ACCEPTED
+                    : REJECTED;
+      }
+      if (state == ACCEPTED) {
+        relevances[ordinal - range.begin] +=
+            posting->term_freq * term.inverse_document_freq;
+      }
     }
   }
 
   std::vector<Document> matched_documents;
-  for (const auto [document_id, relevance] : document_to_relevance) {
-    matched_documents.push_back(
-        {document_id, relevance, documents_.at(document_id).rating});
+  for (size_t i = 0; i < range_size; ++i) {
+    if (states[i] == ACCEPTED) {
+      const int ordinal = range.begin + static_cast<int>(i);
+      matched_documents.push_back(
+          {ordinal_to_id_[ordinal], relevances[i], ratings_[ordinal]});
+    }
   }
   return matched_documents;
 }
 
 template <typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document>
-SearchServer::FindAllDocuments(ExecutionPolicy policy,
+SearchServer::FindAllDocuments(ExecutionPolicy /*policy*/,
                                const SearchServer::Query &query,
                                DocumentPredicate document_predicate) const {
     if constexpr (
-        is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+        std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
         return FindAllDocuments(query, document_predicate);
     }
     else {
-        ConcurrentMap<int, double> document_to_relevance(100);
-        std::set<std::string_view, std::less<>> minus_words(query.minus_words.begin(),
-            query.minus_words.end());
-        auto is_minus_word = [&](std::string_view word) {
-            return minus_words.end() != minus_words.find(word);
-        };
-
-        for_each(std::execution::par,
-            query.plus_words.begin(), query.plus_words.end(),
-            [&](std::string_view word)
-            {
-
-                if (word_to_document_freqs_.count(word) && !is_minus_word(word)) {
-                    const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                    std::for_each(word_to_document_freqs_.at(std::string(word)).begin(), word_to_document_freqs_.at(std::string(word)).end(),
-                        [&](const auto& doc_freq)
-                        {
-                            const auto& doc_data = documents_.at(doc_freq.first);
-                            if (document_predicate(doc_freq.first, doc_data.status, doc_data.rating)) {
-                                document_to_relevance[doc_freq.first].ref_to_value += doc_freq.second * inverse_document_freq;
-                            }
-                        });
-                }
-            });
-
-        std::atomic_int size = 0;
-        const std::map<int, double>& ord_map = document_to_relevance.BuildOrdinaryMap();
-        std::vector<Document> matched_documents(ord_map.size());
+        LOG_LATENCY("score");
+        // Every task owns a disjoint ordinal range and accumulates into its
+        // own dense array, so relevances are summed without any locking and
+        // in the same term order as the sequential search.
+        const OrdinalSet excluded = CollectMinusDocuments(query);
+        std::vector<InvertedIndex::TermStats> terms;
+        terms.reserve(query.plus_words.size());
+        for (const std::string_view word : query.plus_words) {
+            const auto term = word_to_document_freqs_.FindTermStats(word);
+            if (term.postings != nullptr) {
+                terms.push_back(term);
+            }
+        }
 
-        std::for_each(std::execution::par,
-            ord_map.begin(), ord_map.end(),
-            [&](const auto& map)
-            {
-                matched_documents[size++] = { map.first, map.second, documents_.at(map.first).rating };
+        const auto ranges = SplitOrdinalRanges();
+        std::vector<std::vector<Document>> range_documents(ranges.size());
+        // Scoring a range allocates, which par_unseq does not allow, so any
+        // parallel policy runs it as par.
+        std::transform(std::execution::par, ranges.begin(), ranges.end(),
+            range_documents.begin(),
+            [&](OrdinalRange range) {
+                return ScoreOrdinalRange(range, terms, excluded, document_predicate);
             });
 
-        matched_documents.resize(size);
-
+        std::vector<Document> matched_documents;
+        for (const auto& documents : range_documents) {
+            matched_documents.insert(matched_documents.end(),
+                documents.begin(), documents.end());
+        }
         return matched_documents;
     }
-  
 }
+
 template<typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query,
-    DocumentStatus status) const {
+    DocumentStatus status, size_t max_result_count) const {
     if constexpr (
-        is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
-        return FindTopDocuments(raw_query, raw_query, [status](int document_id, DocumentStatus document_status,
-            int rating) { return document_status == status; });
+        std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+        return FindTopDocuments(raw_query, status, max_result_count);
     } else {
-        return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status,
-            int rating) { return document_status == status; });
+        return FindTopDocuments(policy, raw_query, StatusPredicate{status}, max_result_count);
     }
 }
 
@@ -293,7 +709,7 @@ template<typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(
     ExecutionPolicy policy, std::string_view raw_query) const {
     if constexpr (
-        is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+        std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
         return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
     } else {
         return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
@@ -0,0 +1,102 @@
+#include "sharded_search_server.h"
+
+#include <cmath>
+
+using namespace std;
+
+ShardedSearchServer::ShardedSearchServer(size_t shard_count,
+                                         const string &stop_words_text)
+    : ShardedSearchServer(shard_count, SplitIntoWords(stop_words_text)) {}
+
+void ShardedSearchServer::AddDocument(int document_id, string_view document,
+                                      DocumentStatus status,
+                                      const vector<int> &ratings) {
+  if (document_id < 0) {
+    throw invalid_argument("Invalid document_id"s);
+  }
+  Shard &shard = GetShard(document_id);
+  lock_guard lock(shard.mutex);
+  shard.server.AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+  if (document_id < 0) {
+    return;
+  }
+  Shard &shard = GetShard(document_id);
+  lock_guard lock(shard.mutex);
+  shard.server.RemoveDocument(document_id);
+}
+
+vector<Document>
+ShardedSearchServer::FindTopDocuments(string_view raw_query,
+                                      DocumentStatus status,
+                                      size_t max_result_count) const {
+  return FindTopDocuments(raw_query, SearchServer::StatusPredicate{status},
+                          max_result_count);
+}
+
+vector<Document>
+ShardedSearchServer::FindTopDocuments(string_view raw_query) const {
+  return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+SearchServer::OwnedMatchedResult
+ShardedSearchServer::MatchDocument(string_view raw_query,
+                                   int document_id) const {
+  if (document_id < 0) {
+    throw out_of_range("Unknown document_id"s);
+  }
+  const Shard &shard = GetShard(document_id);
+  shared_lock lock(shard.mutex);
+  const auto [words, status] = shard.server.MatchDocument(raw_query, document_id);
+  return {vector<string>(words.begin(), words.end()), status};
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+  const auto locks = LockAllShards();
+  int document_count = 0;
+  for (const auto &shard : shards_) {
+    document_count += shard->server.GetDocumentCount();
+  }
+  return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const { return shards_.size(); }
+
+ShardedSearchServer::Shard &ShardedSearchServer::GetShard(int document_id) const {
+  return *shards_[static_cast<size_t>(document_id) % shards_.size()];
+}
+
+vector<shared_lock<shared_mutex>> ShardedSearchServer::LockAllShards() const {
+  // Shards are always locked in the same order; writers hold one lock only.
+  vector<shared_lock<shared_mutex>> locks;
+  locks.reserve(shards_.size());
+  for (const auto &shard : shards_) {
+    locks.emplace_back(shard->mutex);
+  }
+  return locks;
+}
+
+vector<double> ShardedSearchServer::ComputeInverseDocumentFreqs(
+    const SearchServer::Query &query) const {
+  int document_count = 0;
+  vector<size_t> document_freqs(query.plus_words.size());
+  for (const auto &shard : shards_) {
+    const auto &server = shard->server;
+    document_count += server.GetDocumentCount();
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+      document_freqs[i] +=
+          server.word_to_document_freqs_.GetDocumentFreq(query.plus_words[i]);
+    }
+  }
+
+  vector<double> inverse_document_freqs(query.plus_words.size());
+  for (size_t i = 0; i < query.plus_words.size(); ++i) {
+    if (document_freqs[i] > 0) {
+      inverse_document_freqs[i] =
+          log(document_count * 1.0 / document_freqs[i]);
+    }
+  }
+  return inverse_document_freqs;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <execution>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "search_server.h"
+
+// Documents are partitioned by id over independent SearchServer shards, each
+// guarded by its own lock, so writers to different shards do not contend.
+// Queries run on all shards in parallel with IDF computed from the summed
+// shard statistics, which gives the same ranking as a single server.
+class ShardedSearchServer {
+public:
+  template <typename StringContainer>
+  ShardedSearchServer(size_t shard_count, const StringContainer &stop_words);
+  ShardedSearchServer(size_t shard_count, const std::string &stop_words_text);
+
+  void AddDocument(int document_id, std::string_view document,
+                   DocumentStatus status, const std::vector<int> &ratings);
+  void RemoveDocument(int document_id);
+
+  template <typename DocumentPredicate>
+  std::vector<Document>
+  FindTopDocuments(std::string_view raw_query,
+                   DocumentPredicate document_predicate,
+                   size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+  std::vector<Document>
+  FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                   size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+  std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+  // The words are copied while the shard is locked: a writer may free the
+  // terms of the shard once the lock is released.
+  SearchServer::OwnedMatchedResult MatchDocument(std::string_view raw_query,
+                                                 int document_id) const;
+
+  int GetDocumentCount() const;
+  size_t GetShardCount() const;
+
+private:
+  struct Shard {
+    SearchServer server;
+    mutable std::shared_mutex mutex;
+
+    template <typename StringContainer>
+    explicit Shard(const StringContainer &stop_words) : server(stop_words) {}
+  };
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  Shard &GetShard(int document_id) const;
+  std::vector<std::shared_lock<std::shared_mutex>> LockAllShards() const;
+  // Collection-wide IDF of every plus word, in query order.
+  std::vector<double>
+  ComputeInverseDocumentFreqs(const SearchServer::Query &query) const;
+};
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(size_t shard_count,
+                                         const StringContainer &stop_words) {
+  if (shard_count == 0) {
+    throw std::invalid_argument("Shard count must be positive");
+  }
+  shards_.reserve(shard_count);
+  for (size_t i = 0; i < shard_count; ++i) {
+    shards_.push_back(std::make_unique<Shard>(stop_words));
+  }
+}
+
+template <typename DocumentPredicate>
+std::vector<Document>
+ShardedSearchServer::FindTopDocuments(std::string_view raw_query,
+                                      DocumentPredicate document_predicate,
+                                      size_t max_result_count) const {
+  const auto locks = LockAllShards();
+  const auto scratch = shards_.front()->server.ParseScratchQuery(raw_query);
+  const SearchServer::Query &query = *scratch;
+  const auto inverse_document_freqs = ComputeInverseDocumentFreqs(query);
+
+  std::vector<std::vector<Document>> shard_documents(shards_.size());
+  std::transform(
+      std::execution::par, shards_.begin(), shards_.end(),
+      shard_documents.begin(), [&](const std::unique_ptr<Shard> &shard) {
+        auto documents = shard->server.ScoreDocuments(
+            query, document_predicate,
+            [&inverse_document_freqs](size_t i,
+                                      const InvertedIndex::TermStats &) {
+              return inverse_document_freqs[i];
+            });
+        SearchServer::SelectTopDocuments(documents, max_result_count);
+        return documents;
+      });
+
+  std::vector<Document> matched_documents;
+  for (const auto &documents : shard_documents) {
+    matched_documents.insert(matched_documents.end(), documents.begin(),
+                             documents.end());
+  }
+  SearchServer::SelectTopDocuments(matched_documents, max_result_count);
+  return matched_documents;
+}
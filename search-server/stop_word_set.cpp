@@ -0,0 +1,29 @@
+#include "stop_word_set.h"
+
+using namespace std;
+
+StopWordSet::StopWordSet(const set<string, less<>> &words)
+    : seeds_(PerfectWordHash::GetBucketCount(words.size())) {
+  const vector<string_view> word_list(words.begin(), words.end());
+  vector<size_t> slot_words(word_list.size());
+  vector<size_t> scratch(PerfectWordHash::GetScratchSize(word_list.size()));
+  PerfectWordHash::Build(word_list, word_list.size(), seeds_, slot_words,
+                         scratch);
+  words_.reserve(word_list.size());
+  for (const size_t word : slot_words) {
+    words_.emplace_back(word_list[word]);
+    prefilter_.Add(words_.back());
+  }
+}
+
+bool StopWordSet::Contains(string_view word) const {
+  if (words_.empty() || !prefilter_.MayContain(word)) {
+    return false;
+  }
+  const uint64_t hash = PerfectWordHash::HashWord(word);
+  const uint32_t seed =
+      seeds_[PerfectWordHash::GetBucket(hash, seeds_.size())];
+  return words_[PerfectWordHash::GetSlot(hash, seed, words_.size())] == word;
+}
+
+size_t StopWordSet::size() const { return words_.size(); }
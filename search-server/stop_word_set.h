@@ -0,0 +1,240 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Minimal perfect hashing of a fixed word list (hash and displace). Words
+// are grouped into buckets by their hash; every bucket gets the first seed
+// that sends all its words to free slots of a table with exactly one slot
+// per word. A lookup hashes the word once, finds its only candidate slot and
+// compares one string. Everything is constexpr so that FrozenStopWordSet
+// can be built by the compiler.
+class PerfectWordHash {
+public:
+  static constexpr size_t GetBucketCount(size_t word_count) {
+    return word_count / 2 + 1;
+  }
+
+  static constexpr size_t GetScratchSize(size_t word_count) {
+    return 4 * word_count + 3 * GetBucketCount(word_count) + 1;
+  }
+
+  static constexpr uint64_t HashWord(std::string_view word) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char c : word) {
+      hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3ULL;
+    }
+    return hash;
+  }
+
+  static constexpr size_t GetBucket(uint64_t hash, size_t bucket_count) {
+    return Mix(hash) % bucket_count;
+  }
+
+  static constexpr size_t GetSlot(uint64_t hash, uint32_t seed,
+                                  size_t word_count) {
+    return Mix(hash ^ (seed * 0x9e3779b97f4a7c15ULL)) % word_count;
+  }
+
+  // Fills seeds (one per bucket) and slot_words (word index per slot) for
+  // word_count distinct words; scratch holds GetScratchSize(word_count)
+  // zeros. Throws std::invalid_argument on repeated words.
+  template <typename Words, typename Seeds, typename Slots, typename Scratch>
+  static constexpr void Build(const Words &words, size_t word_count,
+                              Seeds &seeds, Slots &slot_words,
+                              Scratch &scratch) {
+    if (word_count == 0) {
+      return;
+    }
+    const size_t bucket_count = GetBucketCount(word_count);
+    // scratch: word bucket | bucket size | bucket start | bucket fill |
+    // bucket members | slot taken | candidate slots
+    const size_t bucket_of = 0;
+    const size_t sizes = bucket_of + word_count;
+    const size_t starts = sizes + bucket_count;
+    const size_t fills = starts + bucket_count + 1;
+    const size_t members = fills + bucket_count;
+    const size_t taken = members + word_count;
+    const size_t candidates = taken + word_count;
+
+    size_t max_size = 0;
+    for (size_t i = 0; i < word_count; ++i) {
+      const size_t bucket = GetBucket(HashWord(words[i]), bucket_count);
+      scratch[bucket_of + i] = bucket;
+      ++scratch[sizes + bucket];
+      max_size = std::max(max_size, scratch[sizes + bucket]);
+    }
+    for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+      scratch[starts + bucket + 1] =
+          scratch[starts + bucket] + scratch[sizes + bucket];
+    }
+    for (size_t i = 0; i < word_count; ++i) {
+      const size_t bucket = scratch[bucket_of + i];
+      scratch[members + scratch[starts + bucket] + scratch[fills + bucket]++] =
+          i;
+    }
+
+    // The largest buckets are placed first, while most slots are free.
+    for (size_t size = max_size; size > 0; --size) {
+      for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+        if (scratch[sizes + bucket] != size) {
+          continue;
+        }
+        const size_t first = members + scratch[starts + bucket];
+        for (size_t i = 0; i < size; ++i) {
+          for (size_t j = 0; j < i; ++j) {
+            if (words[scratch[first + i]] == words[scratch[first + j]]) {
+              throw std::invalid_argument("Repeated word in a perfect hash");
+            }
+          }
+        }
+        for (uint32_t seed = 0;; ++seed) {
+          if (seed == MAX_SEED) {
+            throw std::invalid_argument("No perfect hash for the words");
+          }
+          bool placed = true;
+          for (size_t i = 0; i < size && placed; ++i) {
+            const size_t slot =
+                GetSlot(HashWord(words[scratch[first + i]]), seed, word_count);
+            placed = scratch[taken + slot] == 0;
+            for (size_t j = 0; j < i && placed; ++j) {
+              placed = scratch[candidates + j] != slot;
+            }
+            scratch[candidates + i] = slot;
+          }
+          if (placed) {
+            seeds[bucket] = seed;
+            for (size_t i = 0; i < size; ++i) {
+              scratch[taken + scratch[candidates + i]] = 1;
+              slot_words[scratch[candidates + i]] = scratch[first + i];
+            }
+            break;
+          }
+        }
+      }
+    }
+  }
+
+private:
+  static constexpr uint32_t MAX_SEED = 1u << 24;
+
+  static constexpr uint64_t Mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+  }
+};
+
+// Rejects most non-members before hashing: word lengths (63 stands for 63
+// and longer) and first bytes that occur in the set.
+class WordPrefilter {
+public:
+  constexpr void Add(std::string_view word) {
+    lengths_ |= uint64_t{1} << std::min<size_t>(word.size(), 63);
+    if (!word.empty()) {
+      const auto first = static_cast<uint8_t>(word[0]);
+      first_bytes_[first / 64] |= uint64_t{1} << (first % 64);
+    }
+  }
+
+  constexpr bool MayContain(std::string_view word) const {
+    if ((lengths_ >> std::min<size_t>(word.size(), 63) & 1) == 0) {
+      return false;
+    }
+    if (word.empty()) {
+      return true;
+    }
+    const auto first = static_cast<uint8_t>(word[0]);
+    return (first_bytes_[first / 64] >> (first % 64) & 1) != 0;
+  }
+
+private:
+  uint64_t lengths_ = 0;
+  std::array<uint64_t, 4> first_bytes_{};
+};
+
+// Stop words fixed at compile time:
+//   constexpr FrozenStopWordSet<3> STOP_WORDS({"and"sv, "in"sv, "on"sv});
+// The words must be distinct; the array they view must outlive the set
+// (string literals do).
+template <size_t N> class FrozenStopWordSet {
+public:
+  static constexpr size_t BUCKET_COUNT = PerfectWordHash::GetBucketCount(N);
+
+  constexpr explicit FrozenStopWordSet(
+      const std::array<std::string_view, N> &words) {
+    std::array<size_t, N> slot_words{};
+    std::array<size_t, PerfectWordHash::GetScratchSize(N)> scratch{};
+    PerfectWordHash::Build(words, N, seeds_, slot_words, scratch);
+    for (size_t slot = 0; slot < N; ++slot) {
+      words_[slot] = words[slot_words[slot]];
+      prefilter_.Add(words_[slot]);
+    }
+  }
+
+  constexpr bool Contains(std::string_view word) const {
+    if constexpr (N == 0) {
+      return false;
+    } else {
+      if (!prefilter_.MayContain(word)) {
+        return false;
+      }
+      const uint64_t hash = PerfectWordHash::HashWord(word);
+      const uint32_t seed =
+          seeds_[PerfectWordHash::GetBucket(hash, BUCKET_COUNT)];
+      return words_[PerfectWordHash::GetSlot(hash, seed, N)] == word;
+    }
+  }
+
+  constexpr size_t size() const { return N; }
+
+  // Words in slot order.
+  constexpr auto begin() const { return words_.begin(); }
+  constexpr auto end() const { return words_.end(); }
+
+  constexpr const std::array<uint32_t, BUCKET_COUNT> &GetSeeds() const {
+    return seeds_;
+  }
+
+private:
+  std::array<std::string_view, N> words_{};
+  std::array<uint32_t, BUCKET_COUNT> seeds_{};
+  WordPrefilter prefilter_;
+};
+
+// Immutable stop-word set built at construction; lookups take one hash pass
+// and at most one string comparison.
+class StopWordSet {
+public:
+  StopWordSet() = default;
+  explicit StopWordSet(const std::set<std::string, std::less<>> &words);
+  // Takes over the table the compiler has built.
+  template <size_t N> explicit StopWordSet(const FrozenStopWordSet<N> &words);
+
+  bool Contains(std::string_view word) const;
+  size_t size() const;
+
+private:
+  std::vector<std::string> words_;  // by slot
+  std::vector<uint32_t> seeds_;     // by bucket
+  WordPrefilter prefilter_;
+};
+
+template <size_t N>
+StopWordSet::StopWordSet(const FrozenStopWordSet<N> &words)
+    : words_(words.begin(), words.end()),
+      seeds_(words.GetSeeds().begin(), words.GetSeeds().end()) {
+  for (const auto &word : words_) {
+    prefilter_.Add(word);
+  }
+}
@@ -2,6 +2,8 @@
 
 #include <iostream>
 
+#include "tokenizer.h"
+
 using namespace std;
 
 void PrintDocument(const Document &document) {
@@ -25,30 +27,6 @@ void PrintMatchDocumentResult(int document_id, const vector<string_view> &words,
 
 vector<string_view> SplitIntoWords(string_view text) {
   vector<string_view> words;
-
-  auto begin = text.begin();
-  auto it = text.begin();
-  size_t count = 0;
-  while (text.end() != it) {
-    if (*it == ' ') {
-      if (count > 0) {
-        //(it + 1 == text.end()) ? (it + 1) : it
-        // = {begin, begin + count};
-        string_view word = text.substr(distance(text.begin(), begin), count);
-        // if (!word.empty()) {
-        words.push_back(word);
-        //}
-      }
-      count = 0;
-      begin = it + 1;
-
-    } else {
-      ++count;
-      if (it + 1 == text.end()) {
-        words.push_back(text.substr(distance(text.begin(), begin), count));
-      }
-    }
-    ++it;
-  }
+  TokenizeWords(text, words);
   return words;
 }
@@ -72,55 +72,6 @@ void MatchDocuments(const SearchServer &search_server, const string &query,
   }
 }
 
-string GenerateWord(mt19937 &generator, int max_length) {
-  const int length = max_length;
-  uniform_int_distribution(1, max_length)(generator);
-  string word;
-  word.reserve(length);
-  for (int i = 0; i < length; ++i) {
-    word.push_back(uniform_int_distribution(static_cast<int>('a'),
-                                            static_cast<int> ('z'))(generator));
-  }
-  return word;
-}
-
-vector<string> GenerateDictionary(mt19937 &generator, int word_count,
-                                  int max_length) {
-  vector<string> words;
-  words.reserve(word_count);
-  for (int i = 0; i < word_count; ++i) {
-    words.push_back(GenerateWord(generator, max_length));
-  }
-  sort(words.begin(), words.end());
-  words.erase(unique(words.begin(), words.end()), words.end());
-  return words;
-}
-
-string GenerateQuery(mt19937 &generator, const vector<string> &dictionary,
-                     int max_word_count) {
-  const int word_count = uniform_int_distribution(1, max_word_count)(generator);
-  string query;
-  for (int i = 0; i < word_count; ++i) {
-    if (!query.empty()) {
-      query.push_back(' ');
-    }
-    query += dictionary[uniform_int_distribution<int>(0, static_cast<int>(dictionary.size() -
-                                                            1))(generator)];
-  }
-  return query;
-}
-
-vector<string> GenerateQueries(mt19937 &generator,
-                               const vector<string> &dictionary,
-                               int query_count, int max_word_count) {
-  vector<string> queries;
-  queries.reserve(query_count);
-  for (int i = 0; i < query_count; ++i) {
-    queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
-  }
-  return queries;
-}
-
 void TestRemoveDocument() {
   SearchServer search_server("and with"s);
 
@@ -155,6 +106,52 @@ void TestRemoveDocument() {
   report();
 } 
 
+void TestRemoveDocumentKeepsSharedWords() {
+  SearchServer server(""s);
+  server.AddDocument(1, "funny pet"s, DocumentStatus::ACTUAL, {1});
+  server.AddDocument(2, "funny rat"s, DocumentStatus::ACTUAL, {2});
+  server.AddDocument(3, "curly pet"s, DocumentStatus::ACTUAL, {3});
+
+  // document 1 introduced "funny" and "pet", the index must not depend on it
+  server.RemoveDocument(1);
+  auto found_docs = server.FindTopDocuments("funny"s);
+  ASSERT_EQUAL(1u, found_docs.size());
+  ASSERT_EQUAL(2, found_docs[0].id);
+  found_docs = server.FindTopDocuments("pet -rat"s);
+  ASSERT_EQUAL(1u, found_docs.size());
+  ASSERT_EQUAL(3, found_docs[0].id);
+
+  const auto [words, status] = server.MatchDocument("funny pet"s, 2);
+  ASSERT_EQUAL(1u, words.size());
+  ASSERT_EQUAL("funny"s, words[0]);
+
+  server.RemoveDocument(execution::par, 2);
+  ASSERT(server.FindTopDocuments("funny"s).empty());
+  ASSERT_EQUAL(1u, server.FindTopDocuments("pet"s).size());
+}
+
+void TestRejectedDocumentIsNotIndexed() {
+  SearchServer server(""s);
+  server.AddDocument(1, "funny pet"s, DocumentStatus::ACTUAL, {1});
+  try {
+    server.AddDocument(2, "funny r\x12t"s, DocumentStatus::ACTUAL, {2});
+    ASSERT_HINT(false, "This should never happen");
+  } catch (const invalid_argument &) {
+  }
+  ASSERT_EQUAL(1, server.GetDocumentCount());
+  server.AddDocument(2, "funny rat"s, DocumentStatus::BANNED, {2});
+  server.RemoveDocument(1);
+  // the freed slot is reused by the next document
+  server.AddDocument(3, "curly pet"s, DocumentStatus::ACTUAL, {3});
+  ASSERT_EQUAL(2, server.GetDocumentCount());
+  const auto found_docs = server.FindTopDocuments("pet funny"s);
+  ASSERT_EQUAL(1u, found_docs.size());
+  ASSERT_EQUAL(3, found_docs[0].id);
+  ASSERT_EQUAL(3, found_docs[0].rating);
+  ASSERT_EQUAL(DocumentStatus::BANNED,
+               get<1>(server.MatchDocument("funny"s, 2)));
+}
+
 void TestExcludeStopWordsFromAddedDocumentContent() {
   const int doc_id = 42;
   const string content = "cat in the city"s;
@@ -270,9 +267,34 @@ void TestMinusWordsP() {
         ASSERT_EQUAL(42, found_docs[0].id);
         found_docs = server.FindTopDocuments(execution::par, "in -cat"s);
         ASSERT(found_docs.empty());
+        // par_unseq is accepted and scored as par
+        found_docs = server.FindTopDocuments(execution::par_unseq, "in -night"s);
+        ASSERT_EQUAL(1U, found_docs.size());
+        ASSERT_EQUAL(42, found_docs[0].id);
     }
 }
 
+void TestDenseMinusWords() {
+  SearchServer server(""s);
+  for (int id = 0; id < 200; ++id) {
+    server.AddDocument(id, id % 2 == 0 ? "cat spam"s : "cat dog"s,
+                       DocumentStatus::ACTUAL, {id});
+  }
+  server.AddDocument(200, "cat rare"s, DocumentStatus::ACTUAL, {1000});
+
+  // "spam" covers half of the documents, "rare" a single one
+  for (const auto &found_docs :
+       {server.FindTopDocuments("cat -spam -rare"s, DocumentStatus::ACTUAL, 500),
+        server.FindTopDocuments(execution::par, "cat -spam -rare"s,
+                                DocumentStatus::ACTUAL, 500)}) {
+    ASSERT_EQUAL(100u, found_docs.size());
+    for (const auto &document : found_docs) {
+      ASSERT_EQUAL(1, document.id % 2);
+    }
+  }
+  const auto found_docs = server.FindTopDocuments("cat -rare"s);
+  ASSERT_EQUAL(199, found_docs[0].id);
+}
 
 void TestMatchingDocuments() {
   {
@@ -443,6 +465,1283 @@ void TestRelevanceSortP() {
     }
 }
 
+void TestTopDocumentsCount() {
+  mt19937 generator;
+  const auto dictionary = GenerateDictionary(generator, 100, 5);
+  const auto documents = GenerateQueries(generator, dictionary, 5'000, 10);
+
+  SearchServer server(""s);
+  for (size_t i = 0; i < documents.size(); ++i) {
+    server.AddDocument(i, documents[i], DocumentStatus::ACTUAL,
+                       {static_cast<int>(i % 7)});
+  }
+
+  const string query = dictionary[0] + " "s + dictionary[1];
+  const auto all_docs = server.FindTopDocuments(
+      query, DocumentStatus::ACTUAL, documents.size());
+  ASSERT(all_docs.size() > 100u);
+  ASSERT_EQUAL(MAX_RESULT_DOCUMENT_COUNT,
+               static_cast<int>(server.FindTopDocuments(query).size()));
+  for (size_t count : {0u, 1u, 7u, 100u}) {
+    const auto seq_docs =
+        server.FindTopDocuments(query, DocumentStatus::ACTUAL, count);
+    const auto par_docs = server.FindTopDocuments(
+        execution::par, query, DocumentStatus::ACTUAL, count);
+    ASSERT_EQUAL(count, seq_docs.size());
+    ASSERT_EQUAL(count, par_docs.size());
+    for (size_t i = 0; i < count; ++i) {
+      ASSERT(fabs(all_docs[i].relevance - seq_docs[i].relevance) < 1e-6);
+      ASSERT(fabs(all_docs[i].relevance - par_docs[i].relevance) < 1e-6);
+      ASSERT_EQUAL(all_docs[i].rating, seq_docs[i].rating);
+      ASSERT_EQUAL(all_docs[i].rating, par_docs[i].rating);
+    }
+  }
+}
+
+void TestMaxScoreRetrieval() {
+  mt19937 generator;
+  const auto dictionary = GenerateDictionary(generator, 300, 6);
+  const auto documents = GenerateQueries(generator, dictionary, 3'000, 30);
+
+  SearchServer server(dictionary[0]);
+  for (size_t i = 0; i < documents.size(); ++i) {
+    server.AddDocument(i, documents[i],
+                       i % 5 == 0 ? DocumentStatus::BANNED
+                                  : DocumentStatus::ACTUAL,
+                       {static_cast<int>(i)});
+  }
+
+  const auto queries = GenerateQueries(generator, dictionary, 100, 20);
+  for (size_t i = 0; i < queries.size(); ++i) {
+    const string query =
+        queries[i] + (i % 3 == 0 ? " -"s + dictionary[i] : ""s);
+    for (size_t count : {1u, 5u, 40u}) {
+      const auto expected =
+          server.FindTopDocuments(query, DocumentStatus::ACTUAL, count);
+      const auto found_docs = server.FindTopDocuments(
+          max_score_retrieval, query, DocumentStatus::ACTUAL, count);
+      ASSERT_EQUAL(expected.size(), found_docs.size());
+      for (size_t j = 0; j < expected.size(); ++j) {
+        ASSERT_EQUAL(expected[j].id, found_docs[j].id);
+        ASSERT(fabs(expected[j].relevance - found_docs[j].relevance) < 1e-9);
+      }
+    }
+  }
+  ASSERT(server
+             .FindTopDocuments(max_score_retrieval, dictionary[1],
+                               DocumentStatus::ACTUAL, 0)
+             .empty());
+}
+
+void TestParallelMatchesSequential() {
+  mt19937 generator;
+  const auto dictionary = GenerateDictionary(generator, 300, 6);
+  const auto documents = GenerateQueries(generator, dictionary, 5'000, 20);
+
+  SearchServer search_server(dictionary[0]);
+  for (size_t i = 0; i < documents.size(); ++i) {
+    search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL,
+                              {static_cast<int>(i)});
+  }
+  const auto even_ids = [](int document_id, DocumentStatus, int) {
+    return document_id % 2 == 0;
+  };
+
+  const auto queries = GenerateQueries(generator, dictionary, 30, 5);
+  for (size_t i = 0; i < queries.size(); ++i) {
+    const string query =
+        queries[i] + (i % 3 == 0 ? " -"s + dictionary[i] : ""s);
+    const auto expected = search_server.FindTopDocuments(query, even_ids, 50);
+    const auto found_docs =
+        search_server.FindTopDocuments(execution::par, query, even_ids, 50);
+    ASSERT_EQUAL(expected.size(), found_docs.size());
+    for (size_t j = 0; j < expected.size(); ++j) {
+      ASSERT_EQUAL(expected[j].id, found_docs[j].id);
+      ASSERT_EQUAL(expected[j].relevance, found_docs[j].relevance);
+    }
+  }
+}
+
+void TestSnapshot() {
+  mt19937 generator;
+  const auto dictionary = GenerateDictionary(generator, 200, 6);
+  const auto texts = GenerateQueries(generator, dictionary, 500, 15);
+
+  SearchServer search_server(dictionary[0] + " "s + dictionary[1]);
+  for (size_t i = 0; i < texts.size(); ++i) {
+    search_server.AddDocument(i * 2, texts[i],
+                              static_cast<DocumentStatus>(i % 4),
+                              {static_cast<int>(i), -3});
+  }
+  for (int id = 0; id < 1'000; id += 6) {
+    search_server.RemoveDocument(id);
+  }
+
+  stringstream snapshot;
+  search_server.SaveSnapshot(snapshot);
+  SearchServer loaded = SearchServer::LoadSnapshot(snapshot);
+
+  ASSERT_EQUAL(search_server.GetDocumentCount(), loaded.GetDocumentCount());
+  ASSERT_EQUAL(vector<int>(search_server.begin(), search_server.end()),
+               vector<int>(loaded.begin(), loaded.end()));
+  for (const int id : search_server) {
+    ASSERT_EQUAL(search_server.GetWordFrequencies(id),
+                 loaded.GetWordFrequencies(id));
+    ASSERT_EQUAL(get<1>(search_server.MatchDocument(dictionary[5], id)),
+                 get<1>(loaded.MatchDocument(dictionary[5], id)));
+  }
+  for (const auto &query : GenerateQueries(generator, dictionary, 30, 4)) {
+    for (const auto status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+      const auto expected = search_server.FindTopDocuments(query, status);
+      const auto found_docs = loaded.FindTopDocuments(query, status);
+      ASSERT_EQUAL(expected.size(), found_docs.size());
+      for (size_t j = 0; j < expected.size(); ++j) {
+        ASSERT_EQUAL(expected[j].id, found_docs[j].id);
+        ASSERT_EQUAL(expected[j].relevance, found_docs[j].relevance);
+        ASSERT_EQUAL(expected[j].rating, found_docs[j].rating);
+      }
+    }
+  }
+  // stop words survive the round trip
+  ASSERT(loaded.FindTopDocuments(dictionary[1]).empty());
+  // the loaded index stays mutable
+  loaded.AddDocument(0, dictionary[2], DocumentStatus::ACTUAL, {});
+  ASSERT_EQUAL(0, loaded.FindTopDocuments(dictionary[2]).front().id);
+
+  const string data = snapshot.str();
+  for (const size_t size : {size_t{0}, size_t{10}, data.size() / 2}) {
+    istringstream truncated(data.substr(0, size));
+    try {
+      SearchServer::LoadSnapshot(truncated);
+      ASSERT_HINT(false, "This should never happen");
+    } catch (const runtime_error &) {
+    }
+  }
+
+  // Ordinals 1 and 2 are free: ids {1, -1, -1, 4}. With no stop words the
+  // ordinal count is at byte 28, followed by the ids, ratings, statuses, the
+  // free count at byte 72, the free ordinals at bytes 80 and 84 and the term
+  // count at byte 88. The first term has its word length at byte 96 and,
+  // as both words have 5 letters, its posting count at byte 105.
+  SearchServer small(""s);
+  for (int id = 1; id <= 4; ++id) {
+    small.AddDocument(id, "word"s + to_string(id), DocumentStatus::ACTUAL, {id});
+  }
+  small.RemoveDocument(2);
+  small.RemoveDocument(3);
+  stringstream small_snapshot;
+  small.SaveSnapshot(small_snapshot);
+  const string small_data = small_snapshot.str();
+  const auto patched = [&small_data](size_t offset, auto value) {
+    string result = small_data;
+    memcpy(result.data() + offset, &value, sizeof(value));
+    return result;
+  };
+  {
+    istringstream input(small_data);
+    ASSERT_EQUAL(2u, SearchServer::LoadSnapshot(input).GetDocumentCount());
+  }
+  for (const string &corrupted : {
+           patched(28, uint64_t{1} << 60),  // ordinal count past the file
+           patched(72, uint64_t{1} << 40),  // free count past the file
+           patched(72, uint64_t{1}),        // fewer free ordinals than slots
+           patched(80, 7),                  // free ordinal out of range
+           patched(84, 1),                  // free ordinal listed twice
+           patched(80, 0),                  // free ordinal holds a document
+           patched(48, 1),                  // live id on two ordinals
+           patched(20, uint64_t{1} << 60),  // stop word count past the file
+           patched(88, uint64_t{1} << 60),  // term count past the file
+           patched(96, uint32_t{1} << 31),  // word length past the file
+           patched(105, uint64_t{1} << 40), // posting count past the file
+       }) {
+    istringstream input(corrupted);
+    try {
+      SearchServer::LoadSnapshot(input);
+      ASSERT_HINT(false, "This should never happen");
+    } catch (const runtime_error &) {
+    }
+  }
+}
+
+void TestMappedSearchServer() {
+  mt19937 generator;
+  const auto dictionary = GenerateDictionary(generator, 200, 6);
+  const auto texts = GenerateQueries(generator, dictionary, 500, 15);
+
+  SearchServer search_server(dictionary[0] + " "s + dictionary[1]);
+  for (size_t i = 0; i < texts.size(); ++i) {
+    search_server.AddDocument(i * 3, texts[i],
+                              static_cast<DocumentStatus>(i % 4),
+                              {static_cast<int>(i)});
+  }
+  for (int id = 0; id < 1'500; id += 9) {
+    search_server.RemoveDocument(id);
+  }
+  const string path = "mapped_search_server_test.idx"s;
+  MappedSearchServer::WriteIndex(search_server, path);
+  {
+    const MappedSearchServer mapped(path);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), mapped.GetDocumentCount());
+    for (const auto &query : GenerateQueries(generator, dictionary, 30, 4)) {
+      const string raw_query = query + " -"s + dictionary[query.size() % 50];
+      for (const auto status :
+           {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT}) {
+        const auto expected = search_server.FindTopDocuments(raw_query, status);
+        const auto found_docs = mapped.FindTopDocuments(raw_query, status);
+        ASSERT_EQUAL(expected.size(), found_docs.size());
+        for (size_t j = 0; j < expected.size(); ++j) {
+          ASSERT_EQUAL(expected[j].id, found_docs[j].id);
+          ASSERT_EQUAL(expected[j].relevance, found_docs[j].relevance);
+          ASSERT_EQUAL(expected[j].rating, found_docs[j].rating);
+        }
+      }
+      for (const int id : {3, 12, 600, 1'002}) {
+        const auto [expected_words, expected_status] =
+            search_server.MatchDocument(raw_query, id);
+        const auto [words, status] = mapped.MatchDocument(raw_query, id);
+        ASSERT_EQUAL(expected_words, words);
+        ASSERT_EQUAL(expected_status, status);
+      }
+    }
+    ASSERT(mapped.FindTopDocuments(dictionary[1]).empty());
+    try {
+      mapped.MatchDocument(dictionary[2], 9);
+      ASSERT_HINT(false, "removed documents are unknown");
+    } catch (const out_of_range &) {
+    }
+
+    MappedSearchServer writable_looking(path);
+    try {
+      writable_looking.AddDocument(2'000, "cat"s, DocumentStatus::ACTUAL, {});
+      ASSERT_HINT(false, "This should never happen");
+    } catch (const logic_error &error) {
+      ASSERT(string(error.what()).find("read-only"s) != string::npos);
+    }
+    try {
+      writable_looking.RemoveDocument(1);
+      ASSERT_HINT(false, "This should never happen");
+    } catch (const logic_error &) {
+    }
+
+    // Rebuilding the index replaces the file; open mappings keep the old one.
+    const auto before = mapped.FindTopDocuments(dictionary[3]);
+    SearchServer rebuilt(""s);
+    rebuilt.AddDocument(7, dictionary[3], DocumentStatus::ACTUAL, {1});
+    MappedSearchServer::WriteIndex(rebuilt, path);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), mapped.GetDocumentCount());
+    const auto after = mapped.FindTopDocuments(dictionary[3]);
+    ASSERT_EQUAL(before.size(), after.size());
+    for (size_t j = 0; j < before.size(); ++j) {
+      ASSERT_EQUAL(before[j].id, after[j].id);
+    }
+    const MappedSearchServer reopened(path);
+    ASSERT_EQUAL(1u, reopened.GetDocumentCount());
+    ASSERT_EQUAL(7, reopened.FindTopDocuments(dictionary[3]).front().id);
+
+    // concurrent writers each replace the whole file and leave no
+    // temporary files behind
+    vector<thread> writers;
+    for (int t = 0; t < 4; ++t) {
+      writers.emplace_back([&, t] {
+        MappedSearchServer::WriteIndex(t % 2 == 0 ? rebuilt : search_server,
+                                       path);
+      });
+    }
+    for (auto &writer : writers) {
+      writer.join();
+    }
+    const int written_count = MappedSearchServer(path).GetDocumentCount();
+    ASSERT(written_count == 1 ||
+           written_count == search_server.GetDocumentCount());
+    for (const auto &entry : filesystem::directory_iterator(".")) {
+      ASSERT(entry.path().filename().string().rfind(path + ".tmp"s, 0) ==
+             string::npos);
+    }
+    MappedSearchServer::WriteIndex(search_server, path);
+  }
+
+  string data;
+  {
+    ifstream input(path, ios::binary);
+    data.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+  }
+  // damage bytes all over the file: opening either rejects it or serves
+  // queries within the file
+  int rejected_count = 0;
+  for (size_t position = 64; position < data.size(); position += 61) {
+    string damaged = data;
+    damaged[position] = '\xff';
+    {
+      ofstream output(path, ios::binary);
+      output.write(damaged.data(), damaged.size());
+    }
+    try {
+      const MappedSearchServer mapped(path);
+      for (const auto &query : GenerateQueries(generator, dictionary, 3, 4)) {
+        mapped.FindTopDocuments(query + " -"s + dictionary[3],
+                                DocumentStatus::IRRELEVANT);
+        mapped.MatchDocument(query, 3);
+      }
+    } catch (const runtime_error &) {
+      ++rejected_count;
+    }
+  }
+  ASSERT(rejected_count > 0);
+
+  // postings of a document whose ordinal is marked free are rejected when a
+  // query reads them; the ids section offset is at byte 80 of the header
+  {
+    uint64_t ids_offset;
+    memcpy(&ids_offset, data.data() + 80, sizeof(ids_offset));
+    string damaged = data;
+    const int32_t free_id = -1;
+    memcpy(damaged.data() + ids_offset + sizeof(int32_t), &free_id,
+           sizeof(free_id));  // ordinal 1 holds document 3
+    {
+      ofstream output(path, ios::binary);
+      output.write(damaged.data(), damaged.size());
+    }
+    const MappedSearchServer mapped(path);
+    try {
+      mapped.FindTopDocuments(texts[1], DocumentStatus::BANNED);
+      ASSERT_HINT(false, "This should never happen");
+    } catch (const runtime_error &) {
+    }
+  }
+
+  // truncate the file
+  {
+    ofstream output(path, ios::binary);
+    output.write(data.data(), data.size() / 2);
+  }
+  try {
+    MappedSearchServer truncated(path);
+    ASSERT_HINT(false, "This should never happen");
+  } catch (const runtime_error &) {
+  }
+
+  // an index with more ordinals than relevance sums are pooled for
+  {
+    const size_t document_count = RelevanceAccumulator::MAX_POOLED_SLOTS + 10;
+    const string words[] = {"cat"s, "dog"s, "bird"s, "cat dog"s};
+    vector<NewDocument> documents;
+    documents.reserve(document_count);
+    for (size_t i = 0; i < document_count; ++i) {
+      documents.push_back({static_cast<int>(i), words[i % 4],
+                           DocumentStatus::ACTUAL, {static_cast<int>(i % 7)}});
+    }
+    SearchServer large(""s);
+    large.AddDocuments(documents);
+    MappedSearchServer::WriteIndex(large, path);
+    const MappedSearchServer mapped(path);
+    const auto expected = large.FindTopDocuments("cat -bird dog"s);
+    const auto found_docs = mapped.FindTopDocuments("cat -bird dog"s);
+    ASSERT_EQUAL(expected.size(), found_docs.size());
+    for (size_t j = 0; j < expected.size(); ++j) {
+      ASSERT_EQUAL(expected[j].id, found_docs[j].id);
+      ASSERT_EQUAL(expected[j].relevance, found_docs[j].relevance);
+      ASSERT_EQUAL(expected[j].rating, found_docs[j].rating);
+    }
+  }
+  remove(path.c_str());
+}
+
+void TestMutationLog() {
+  mt19937 generator;
+  const auto dictionary = GenerateDictionary(generator, 200, 6);
+  const auto texts = GenerateQueries(generator, dictionary, 600, 15);
+  const string snapshot_path = "mutation_log_test.idx"s;
+  const string log_path = "mutation_log_test.log"s;
+  remove(log_path.c_str());
+
+  SearchServer search_server(dictionary[0]);
+  for (int i = 0; i < 200; ++i) {
+    search_server.AddDocument(i, texts[i], DocumentStatus::ACTUAL, {i});
+  }
+  search_server.SaveSnapshot(snapshot_path);
+  {
+    MutationLog::Options options;
+    options.group_size = 100;
+    options.group_interval = chrono::hours(1);
+    MutationLog log(log_path, options);
+    search_server.SetMutationLog(&log);
+    for (int i = 200; i < 400; ++i) {
+      search_server.AddDocument(i, texts[i], static_cast<DocumentStatus>(i % 4),
+                                {i, -1});
+    }
+    // rejected documents are not logged
+    try {
+      search_server.AddDocument(5, texts[5], DocumentStatus::ACTUAL, {});
+      ASSERT_HINT(false, "This should never happen");
+    } catch (const invalid_argument &) {
+    }
+    vector<NewDocument> batch;
+    for (int i = 400; i < 600; ++i) {
+      batch.push_back({i, texts[i], DocumentStatus::BANNED, {i}});
+    }
+    batch[150].id = 1;
+    try {
+      search_server.AddDocuments(batch);
+      ASSERT_HINT(false, "This should never happen");
+    } catch (const invalid_argument &) {
+    }
+    search_server.RemoveDocument(3);
+    search_server.RemoveDocument(execution::par, 250);
+    search_server.RemoveDocuments({10, 420, 10, 1'000});
+    // 200 + 150 additions and 4 removals
+    ASSERT_EQUAL(log.GetRecordCount(), 354u);
+    log.Sync();
+    // the groups were committed by size, not per record
+    ASSERT(log.GetSyncCount() >= 1);
+    ASSERT(log.GetSyncCount() <= 5);
+    search_server.SetMutationLog(nullptr);
+  }
+
+  // a torn record at the tail is dropped
+  {
+    ofstream output(log_path, ios::binary | ios::app);
+    output.write("\x40\0\0\0\x12\x34", 6);
+  }
+  SearchServer recovered = SearchServer::LoadSnapshot(snapshot_path);
+  ASSERT_EQUAL(MutationLog::Replay(log_path, recovered), 354u);
+  ASSERT_EQUAL(vector<int>(search_server.begin(), search_server.end()),
+               vector<int>(recovered.begin(), recovered.end()));
+  for (const int id : search_server) {
+    ASSERT_EQUAL(search_server.GetWordFrequencies(id),
+                 recovered.GetWordFrequencies(id));
+  }
+  for (const auto &query : GenerateQueries(generator, dictionary, 30, 4)) {
+    for (const auto status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+      const auto expected = search_server.FindTopDocuments(query, status);
+      const auto found_docs = recovered.FindTopDocuments(query, status);
+      ASSERT_EQUAL(expected.size(), found_docs.size());
+      for (size_t j = 0; j < expected.size(); ++j) {
+        ASSERT_EQUAL(expected[j].id, found_docs[j].id);
+        ASSERT_EQUAL(expected[j].relevance, found_docs[j].relevance);
+        ASSERT_EQUAL(expected[j].rating, found_docs[j].rating);
+      }
+    }
+  }
+
+  // a crash between saving the checkpoint snapshot and resetting the log:
+  // replay skips the records the snapshot holds, including the addition
+  // that would otherwise be rejected as a duplicate
+  uint64_t checkpoint = 0;
+  {
+    MutationLog log(log_path);
+    // the reopened log continues the numbering after the torn record
+    ASSERT_EQUAL(log.GetLastSequence(), 354u);
+    search_server.SetMutationLog(&log);
+    search_server.AddDocument(1'000, texts[0], DocumentStatus::ACTUAL, {});
+    search_server.SaveSnapshot(snapshot_path);
+    checkpoint = search_server.GetLogSequence();
+    // logged after the snapshot, before the reset
+    search_server.RemoveDocument(7);
+    search_server.SetMutationLog(nullptr);
+  }
+  ASSERT_EQUAL(checkpoint, 355u);
+  {
+    SearchServer crashed = SearchServer::LoadSnapshot(snapshot_path);
+    ASSERT_EQUAL(crashed.GetLogSequence(), checkpoint);
+    ASSERT_EQUAL(MutationLog::Replay(log_path, crashed), 1u);
+    ASSERT_EQUAL(crashed.GetLogSequence(), checkpoint + 1);
+    ASSERT_EQUAL(vector<int>(search_server.begin(), search_server.end()),
+                 vector<int>(crashed.begin(), crashed.end()));
+  }
+
+  // the reset drops what the snapshot covers and keeps the later records
+  {
+    MutationLog log(log_path);
+    log.Reset(checkpoint);
+    ASSERT_EQUAL(log.GetLastSequence(), checkpoint + 1);
+    search_server.SetMutationLog(&log);
+    search_server.RemoveDocument(8);
+    search_server.SetMutationLog(nullptr);
+  }
+  ASSERT_EQUAL(search_server.GetLogSequence(), checkpoint + 2);
+  SearchServer checkpointed = SearchServer::LoadSnapshot(snapshot_path);
+  ASSERT_EQUAL(MutationLog::Replay(log_path, checkpointed), 2u);
+  ASSERT_EQUAL(vector<int>(search_server.begin(), search_server.end()),
+               vector<int>(checkpointed.begin(), checkpointed.end()));
+  // a reset past every record leaves an empty log that keeps the numbering
+  {
+    MutationLog log(log_path);
+    log.Reset(log.GetLastSequence());
+  }
+  {
+    MutationLog log(log_path);
+    ASSERT_EQUAL(log.GetLastSequence(), checkpoint + 2);
+  }
+  SearchServer reloaded = SearchServer::LoadSnapshot(snapshot_path);
+  ASSERT_EQUAL(MutationLog::Replay(log_path, reloaded), 0u);
+
+  remove(snapshot_path.c_str());
+  remove(log_path.c_str());
+}
+
+void TestConcurrentSearchServer() {
+  mt19937 generator;
+  const auto dictionary = GenerateDictionary(generator, 200, 6);
+  const auto texts = GenerateQueries(generator, dictionary, 1'000, 15);
+
+  // sequentially it behaves as SearchServer
+  SearchServer expected(dictionary[0]);
+  ConcurrentSearchServer search_server(dictionary[0]);
+  vector<NewDocument> batch;
+  for (int i = 0; i < 500; ++i) {
+    expected.AddDocument(i, texts[i], DocumentStatus::ACTUAL, {i});
+    search_server.AddDocument(i, texts[i], DocumentStatus::ACTUAL, {i});
+    batch.push_back({500 + i, texts[500 + i], DocumentStatus::BANNED, {i}});
+  }
+  batch[300].id = 7;
+  try {
+    expected.AddDocuments(batch);
+    ASSERT_HINT(false, "This should never happen");
+  } catch (const invalid_argument &) {
+  }
+  try {
+    search_server.AddDocuments(batch);
+    ASSERT_HINT(false, "This should never happen");
+  } catch (const invalid_argument &) {
+  }
+  expected.RemoveDocuments({3, 600, 4});
+  search_server.RemoveDocuments({3, 600, 4});
+  expected.RemoveDocument(17);
+  search_server.RemoveDocument(17);
+  ASSERT_EQUAL(expected.GetDocumentCount(), search_server.GetDocumentCount());
+  for (const auto &query : GenerateQueries(generator, dictionary, 30, 4)) {
+    for (const auto status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+      const auto expected_docs = expected.FindTopDocuments(query, status);
+      const auto found_docs = search_server.FindTopDocuments(query, status);
+      ASSERT_EQUAL(expected_docs.size(), found_docs.size());
+      for (size_t j = 0; j < expected_docs.size(); ++j) {
+        ASSERT_EQUAL(expected_docs[j].id, found_docs[j].id);
+        ASSERT_EQUAL(expected_docs[j].relevance, found_docs[j].relevance);
+      }
+    }
+  }
+  // both replicas went through the same changes
+  for (int i = 0; i < 2; ++i) {
+    search_server.AddDocument(2'000 + i, dictionary[1], DocumentStatus::ACTUAL,
+                              {});
+    ASSERT_EQUAL(expected.GetDocumentCount() + i + 1,
+                 search_server.GetDocumentCount());
+  }
+
+  // readers see whole versions while a writer runs
+  ConcurrentSearchServer growing(dictionary[0]);
+  atomic<bool> writing = true;
+  atomic<bool> consistent = true;
+  vector<thread> readers;
+  for (int t = 0; t < 3; ++t) {
+    readers.emplace_back([&] {
+      int last_count = 0;
+      while (writing) {
+        const auto version = growing.Pin();
+        const int count = version->GetDocumentCount();
+        // ids are added in order, so a version holds exactly 0..count-1
+        for (const auto &document :
+             version->FindTopDocuments(dictionary[2], DocumentStatus::ACTUAL,
+                                       1'000)) {
+          consistent = consistent && document.id < count;
+        }
+        consistent = consistent && count >= last_count &&
+                     version->GetDocumentCount() == count;
+        last_count = count;
+      }
+    });
+  }
+  for (int i = 0; i < 300; ++i) {
+    growing.AddDocument(i, texts[i], DocumentStatus::ACTUAL, {});
+  }
+  writing = false;
+  for (auto &reader : readers) {
+    reader.join();
+  }
+  ASSERT(consistent);
+  ASSERT_EQUAL(300, growing.GetDocumentCount());
+
+  // matched words outlive the removal of the only document holding them
+  ConcurrentSearchServer matching(""s);
+  matching.AddDocument(1, "unique words here"s, DocumentStatus::ACTUAL, {});
+  const auto [words, status] = matching.MatchDocument("unique here"s, 1);
+  thread([&matching] { matching.RemoveDocument(1); }).join();
+  ASSERT_EQUAL(0, matching.GetDocumentCount());
+  ASSERT_EQUAL((vector<string>{"here"s, "unique"s}), words);
+  ASSERT_EQUAL(DocumentStatus::ACTUAL, status);
+}
+
+void TestNestedQueries() {
+  SearchServer search_server("and"s);
+  search_server.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, {1});
+  search_server.AddDocument(2, "funny dog"s, DocumentStatus::ACTUAL, {2});
+  search_server.AddDocument(3, "curly dog and cat"s, DocumentStatus::ACTUAL, {3});
+  // a predicate that searches itself must not disturb the outer query
+  const auto found_docs = search_server.FindTopDocuments(
+      "curly -funny cat"s, [&](int document_id, DocumentStatus, int) {
+        const auto inner = search_server.FindTopDocuments("funny dog and"s);
+        return none_of(inner.begin(), inner.end(), [&](const Document &document) {
+          return document.id == document_id && document_id == 2;
+        });
+      });
+  ASSERT_EQUAL(2u, found_docs.size());
+  ASSERT_EQUAL(1, found_docs[0].id);
+  ASSERT_EQUAL(3, found_docs[1].id);
+  // repeated words are dropped whatever the query size
+  string long_query;
+  for (int i = 0; i < 5'000; ++i) {
+    long_query += (i % 2 == 0 ? "cat "s : "-funny "s);
+  }
+  ASSERT_EQUAL(2u, search_server.FindTopDocuments(long_query).size());
+  const auto [words, status] = search_server.MatchDocument("cat cat curly"s, 3);
+  ASSERT_EQUAL(words, vector<string_view>({"cat"sv, "curly"sv}));
+}
+
+void TestCorpusLoader() {
+  mt19937 generator;
+  const auto dictionary = GenerateDictionary(generator, 200, 6);
+  const auto texts = GenerateQueries(generator, dictionary, 1'000, 15);
+  const string path = "corpus_loader_test.tsv"s;
+
+  SearchServer expected(dictionary[0]);
+  {
+    ofstream output(path, ios::binary);
+    for (size_t i = 0; i < texts.size(); ++i) {
+      const auto status = static_cast<DocumentStatus>(i % 4);
+      const vector<int> ratings = i % 5 == 0 ? vector<int>{}
+                                             : vector<int>{static_cast<int>(i), -2};
+      expected.AddDocument(i * 2, texts[i], status, ratings);
+      output << i * 2 << '\t';
+      if (i % 2 == 0) {
+        output << static_cast<int>(status);
+      } else {
+        output << array{"ACTUAL"s, "IRRELEVANT"s, "BANNED"s, "REMOVED"s}[i % 4];
+      }
+      output << '\t';
+      for (size_t j = 0; j < ratings.size(); ++j) {
+        output << (j > 0 ? " "s : ""s) << ratings[j];
+      }
+      output << '\t' << texts[i] << (i % 3 == 0 ? "\r\n"s : "\n"s);
+      if (i % 100 == 0) {
+        output << '\n';
+      }
+    }
+  }
+
+  CorpusLoadOptions options;
+  options.chunk_size = 1'000;  // many small chunks
+  options.max_pending_chunks = 2;
+  options.parser_count = 3;
+  SearchServer search_server(dictionary[0]);
+  ASSERT_EQUAL(texts.size(), LoadCorpus(path, search_server, options));
+  ASSERT_EQUAL(vector<int>(expected.begin(), expected.end()),
+               vector<int>(search_server.begin(), search_server.end()));
+  for (const auto &query : GenerateQueries(generator, dictionary, 30, 4)) {
+    for (const auto status : {DocumentStatus::ACTUAL, DocumentStatus::REMOVED}) {
+      const auto expected_docs = expected.FindTopDocuments(query, status);
+      const auto found_docs = search_server.FindTopDocuments(query, status);
+      ASSERT_EQUAL(expected_docs.size(), found_docs.size());
+      for (size_t j = 0; j < expected_docs.size(); ++j) {
+        ASSERT_EQUAL(expected_docs[j].id, found_docs[j].id);
+        ASSERT_EQUAL(expected_docs[j].relevance, found_docs[j].relevance);
+        ASSERT_EQUAL(expected_docs[j].rating, found_docs[j].rating);
+      }
+    }
+  }
+
+  // the documents before a malformed line are loaded
+  {
+    ofstream output(path, ios::binary);
+    output << "1\tACTUAL\t1 2\tcat\n"s << "2\tACTUAL\t3\tdog\n"s
+           << "3\tSLEEPING\t\tbird\n"s << "4\tACTUAL\t\tfish\n"s;
+  }
+  SearchServer partial(""s);
+  try {
+    LoadCorpus(path, partial);
+    ASSERT_HINT(false, "This should never happen");
+  } catch (const runtime_error &error) {
+    ASSERT(string(error.what()).find("line 3"s) != string::npos);
+  }
+  ASSERT_EQUAL(2, partial.GetDocumentCount());
+  remove(path.c_str());
+}
+
+void TestBenchmarkSuite() {
+  BenchmarkConfig config;
+  config.document_counts = {40};
+  config.thread_counts = {1, 3};
+  config.dictionary_size = 100;
+  config.max_word_length = 4;
+  config.words_per_document = 8;
+  config.query_count = 20;
+  config.repetitions = 1;
+  const auto results = RunBenchmarks(config);
+
+  set<string> keys;
+  for (const auto &result : results) {
+    ASSERT_EQUAL(result.document_count, 40);
+    ASSERT(result.operation_count > 0);
+    ASSERT(result.seconds >= 0);
+    keys.insert(result.GetKey());
+  }
+  ASSERT_EQUAL(keys.size(), results.size());
+  for (const string &name : {"AddDocument"s, "ProcessQueries"s,
+                            "RemoveDocument"s, "RemoveDuplicates"s}) {
+    ASSERT_EQUAL(keys.count(name + " docs=40 threads=1"s), 1u);
+  }
+  for (const string &name : {"FindTopDocuments/seq"s, "FindTopDocuments/par"s,
+                            "MatchDocument/seq"s, "MatchDocument/par"s}) {
+    for (const int threads : config.thread_counts) {
+      ASSERT_EQUAL(
+          keys.count(name + " docs=40 threads="s + to_string(threads)), 1u);
+    }
+  }
+
+  stringstream json;
+  WriteBenchmarkJson(json, results);
+  const auto read = ReadBenchmarkJson(json);
+  ASSERT_EQUAL(read.size(), results.size());
+  for (size_t i = 0; i < read.size(); ++i) {
+    ASSERT_EQUAL(read[i].GetKey(), results[i].GetKey());
+    ASSERT_EQUAL(read[i].operation_count, results[i].operation_count);
+    ASSERT(abs(read[i].seconds - results[i].seconds) <=
+           results[i].seconds * 1e-6);
+  }
+
+  // unknown keys are skipped; a quoted name survives the round trip
+  istringstream handwritten(
+      R"({"machine": {"cores": [8, null], "fast": true},
+          "benchmarks": [{"name": "a \"b\"", "extra": "x",
+                          "documents": 10, "threads": 2,
+                          "operations": 4, "seconds": 2e-6}]})"s);
+  const auto handwritten_results = ReadBenchmarkJson(handwritten);
+  ASSERT_EQUAL(handwritten_results.size(), 1u);
+  ASSERT_EQUAL(handwritten_results[0].GetKey(), "a \"b\" docs=10 threads=2"s);
+  ASSERT(abs(handwritten_results[0].GetNanosecondsPerOperation() - 500) < 1e-6);
+  for (const string &malformed :
+       {""s, "{"s, R"({"benchmarks": [{"seconds": 1}]})"s,
+        R"({"benchmarks": []} x)"s, R"({"benchmarks": [)"s}) {
+    istringstream input(malformed);
+    try {
+      ReadBenchmarkJson(input);
+      ASSERT_HINT(false, "Malformed benchmark results must be rejected"s);
+    } catch (const invalid_argument &) {
+    }
+  }
+
+  // 10% tolerance: 5% slower passes, 50% slower is flagged
+  const vector<BenchmarkResult> baseline = {
+      {"x"s, 10, 1, 100, 1.0}, {"y"s, 10, 1, 100, 1.0}, {"z"s, 10, 1, 100, 1.0}};
+  const vector<BenchmarkResult> current = {
+      {"x"s, 10, 1, 100, 1.05}, {"y"s, 10, 1, 100, 1.5},
+      {"y"s, 10, 2, 100, 9.0}, {"z"s, 10, 1, 100, 0.5}};
+  const auto comparisons = CompareBenchmarks(baseline, current, 0.1);
+  ASSERT_EQUAL(comparisons.size(), 3u);
+  ASSERT(!comparisons[0].regression);
+  ASSERT(comparisons[1].regression);
+  ASSERT(abs(comparisons[1].ratio - 1.5) < 1e-9);
+  ASSERT(!comparisons[2].regression);
+}
+
+void TestLatencyHistograms() {
+  // every value lands in a bucket whose upper bound is at most 12.5% above it
+  size_t previous_bucket = 0;
+  for (uint64_t value : {0ull, 1ull, 7ull, 8ull, 9ull, 15ull, 16ull, 17ull,
+                         1'000ull, 123'456'789ull, ~0ull >> 1, ~0ull}) {
+    const size_t bucket = LatencyHistogram::GetBucket(value);
+    ASSERT(bucket < LatencyHistogram::BUCKET_COUNT);
+    ASSERT(bucket >= previous_bucket);
+    previous_bucket = bucket;
+    const uint64_t upper_bound = LatencyHistogram::GetBucketUpperBound(bucket);
+    ASSERT(upper_bound >= value);
+    ASSERT(upper_bound - value <= value / 8);
+    ASSERT(bucket == 0 ||
+           LatencyHistogram::GetBucketUpperBound(bucket - 1) < value);
+  }
+  ASSERT_EQUAL(LatencyHistogram::GetBucket(~0ull),
+               LatencyHistogram::BUCKET_COUNT - 1);
+
+  // threads record 1..1000 us between them; exited threads still count
+  const LatencyMetric metric("test latency"sv);
+  vector<thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&metric, t] {
+      for (int us = 1 + t; us <= 1'000; us += 4) {
+        RecordLatency(metric, chrono::microseconds(us));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  RecordLatency(LatencyMetric("test latency"sv), chrono::microseconds(2'000));
+  auto snapshot = GetLatencySnapshot("test latency"sv);
+  ASSERT_EQUAL(snapshot.count, 1'001u);
+  ASSERT_EQUAL(snapshot.max, 2'000'000u);
+  for (const auto &[percentile, expected] :
+       {pair{snapshot.p50, 501'000.0}, pair{snapshot.p90, 901'000.0},
+        pair{snapshot.p99, 991'000.0}}) {
+    ASSERT(percentile >= expected && percentile <= expected * 1.125);
+  }
+  ASSERT_EQUAL(GetLatencySnapshots().count("test latency"s), 1u);
+  ASSERT_EQUAL(GetLatencySnapshot("never registered"sv).count, 0u);
+
+  // a disabled scope records nothing; LOG_DURATION records instead of
+  // printing in RECORD mode
+  ResetLatencyHistograms();
+  ASSERT_EQUAL(GetLatencySnapshot("test latency"sv).count, 0u);
+  const auto record_scopes = [] {
+    for (int i = 0; i < 3; ++i) {
+      LOG_LATENCY("test scope");
+      LOG_DURATION("test log duration"s);
+    }
+  };
+  LogDuration::SetOutput(LogDuration::Output::RECORD);
+  record_scopes();
+  ASSERT_EQUAL(GetLatencySnapshot("test scope"sv).count, 0u);
+  ASSERT_EQUAL(GetLatencySnapshot("test log duration"sv).count, 0u);
+  SetLatencyRecording(true);
+  record_scopes();
+  SetLatencyRecording(false);
+  LogDuration::SetOutput(LogDuration::Output::PRINT);
+  ASSERT_EQUAL(GetLatencySnapshot("test scope"sv).count, 3u);
+  ASSERT_EQUAL(GetLatencySnapshot("test log duration"sv).count, 3u);
+
+  // the search server reports its stages
+  SearchServer search_server("and"s);
+  search_server.AddDocument(1, "white cat and fancy collar"s,
+                            DocumentStatus::ACTUAL, {1});
+  search_server.AddDocument(2, "fluffy cat fluffy tail"s,
+                            DocumentStatus::ACTUAL, {2});
+  map<string, uint64_t> counts_before;
+  for (const auto &[name, stage] : GetLatencySnapshots()) {
+    counts_before[name] = stage.count;
+  }
+  SetLatencyRecording(true);
+  search_server.FindTopDocuments("fluffy cat -collar"s);
+  search_server.FindTopDocuments(execution::par, "fluffy cat -collar"s);
+  search_server.MatchDocument("fluffy cat"s, 2);
+  SetLatencyRecording(false);
+  for (const string &name : {"parse"s, "score"s, "sort"s, "match"s}) {
+    ASSERT_HINT(GetLatencySnapshot(name).count > counts_before[name], name);
+  }
+}
+
+void TestRemoveDocuments() {
+  mt19937 generator;
+  const auto dictionary = GenerateDictionary(generator, 200, 6);
+  const auto texts = GenerateQueries(generator, dictionary, 1'000, 15);
+
+  SearchServer expected(dictionary[0]);
+  SearchServer search_server(dictionary[0]);
+  for (size_t i = 0; i < texts.size(); ++i) {
+    expected.AddDocument(i, texts[i], DocumentStatus::ACTUAL,
+                         {static_cast<int>(i)});
+    search_server.AddDocument(i, texts[i], DocumentStatus::ACTUAL,
+                              {static_cast<int>(i)});
+  }
+
+  // unknown and repeated ids are ignored
+  vector<int> removed_ids = {5'000, -1, 7, 7};
+  for (int id = 0; id < 1'000; id += 3) {
+    removed_ids.push_back(id);
+  }
+  for (const int id : removed_ids) {
+    expected.RemoveDocument(id);
+  }
+  search_server.RemoveDocuments(removed_ids);
+  search_server.RemoveDocument(execution::par, 10);
+  expected.RemoveDocument(10);
+
+  ASSERT_EQUAL(expected.GetDocumentCount(), search_server.GetDocumentCount());
+  ASSERT_EQUAL(vector<int>(expected.begin(), expected.end()),
+               vector<int>(search_server.begin(), search_server.end()));
+  for (size_t i = 0; i < 40; ++i) {
+    const auto expected_docs = expected.FindTopDocuments(dictionary[i]);
+    const auto found_docs = search_server.FindTopDocuments(dictionary[i]);
+    ASSERT_EQUAL(expected_docs.size(), found_docs.size());
+    for (size_t j = 0; j < expected_docs.size(); ++j) {
+      ASSERT_EQUAL(expected_docs[j].id, found_docs[j].id);
+      ASSERT_EQUAL(expected_docs[j].relevance, found_docs[j].relevance);
+    }
+  }
+
+  // the removed ordinals are recycled cleanly
+  search_server.AddDocument(0, dictionary[1], DocumentStatus::ACTUAL, {});
+  ASSERT_EQUAL(0, search_server.FindTopDocuments(dictionary[1]).front().id);
+
+  search_server.RemoveDocuments(
+      vector<int>(search_server.begin(), search_server.end()));
+  ASSERT_EQUAL(0, search_server.GetDocumentCount());
+  ASSERT(search_server.FindTopDocuments(dictionary[1]).empty());
+}
+
+void TestAddDocuments() {
+  mt19937 generator;
+  const auto dictionary = GenerateDictionary(generator, 200, 6);
+  const auto texts = GenerateQueries(generator, dictionary, 1'000, 15);
+
+  SearchServer expected(dictionary[0]);
+  SearchServer search_server(dictionary[0]);
+  // free ordinals get recycled by the batch
+  for (int id = 1'000; id < 1'100; ++id) {
+    expected.AddDocument(id, texts[id - 1'000], DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(id, texts[id - 1'000], DocumentStatus::ACTUAL,
+                              {1});
+  }
+  for (int id = 1'000; id < 1'100; id += 2) {
+    expected.RemoveDocument(id);
+    search_server.RemoveDocument(id);
+  }
+
+  vector<NewDocument> batch;
+  for (size_t i = 0; i < texts.size(); ++i) {
+    const DocumentStatus status =
+        i % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+    const vector<int> ratings = {static_cast<int>(i), 2};
+    expected.AddDocument(i, texts[i], status, ratings);
+    batch.push_back({static_cast<int>(i), texts[i], status, ratings});
+  }
+  search_server.AddDocuments(batch);
+
+  ASSERT_EQUAL(expected.GetDocumentCount(), search_server.GetDocumentCount());
+  for (const int id : expected) {
+    ASSERT_EQUAL(expected.GetWordFrequencies(id),
+                 search_server.GetWordFrequencies(id));
+  }
+  for (const auto &query : GenerateQueries(generator, dictionary, 30, 4)) {
+    const auto expected_docs = expected.FindTopDocuments(query);
+    const auto found_docs = search_server.FindTopDocuments(query);
+    ASSERT_EQUAL(expected_docs.size(), found_docs.size());
+    for (size_t j = 0; j < expected_docs.size(); ++j) {
+      ASSERT_EQUAL(expected_docs[j].id, found_docs[j].id);
+      ASSERT_EQUAL(expected_docs[j].relevance, found_docs[j].relevance);
+      ASSERT_EQUAL(expected_docs[j].rating, found_docs[j].rating);
+    }
+  }
+
+  // errors stop the batch where a loop of AddDocument would stop
+  SearchServer partial(""s);
+  try {
+    partial.AddDocuments({{1, "cat"sv, DocumentStatus::ACTUAL, {}},
+                          {2, "dog"sv, DocumentStatus::ACTUAL, {}},
+                          {3, "bad\x12word"sv, DocumentStatus::ACTUAL, {}},
+                          {4, "parrot"sv, DocumentStatus::ACTUAL, {}}});
+    ASSERT_HINT(false, "This should never happen");
+  } catch (const invalid_argument &) {
+  }
+  ASSERT_EQUAL(2, partial.GetDocumentCount());
+  ASSERT(partial.FindTopDocuments("parrot"s).empty());
+  try {
+    partial.AddDocuments({{5, "cat"sv, DocumentStatus::ACTUAL, {}},
+                          {5, "cat"sv, DocumentStatus::ACTUAL, {}}});
+    ASSERT_HINT(false, "This should never happen");
+  } catch (const invalid_argument &) {
+  }
+  ASSERT_EQUAL(3, partial.GetDocumentCount());
+  ASSERT_EQUAL(2u, partial.FindTopDocuments("cat"s).size());
+
+  // a batch tokenized apart, e.g. by another thread, is indexed the same way
+  SearchServer two_step(dictionary[0]);
+  const auto tokenized = two_step.TokenizeDocuments(execution::seq, batch);
+  two_step.AddDocuments(batch, tokenized);
+  for (const int id : two_step) {
+    ASSERT_EQUAL(expected.GetWordFrequencies(id),
+                 two_step.GetWordFrequencies(id));
+  }
+  try {
+    two_step.AddDocuments(batch, {});
+    ASSERT_HINT(false, "This should never happen");
+  } catch (const invalid_argument &) {
+  }
+}
+
+void TestJoinedAndStreamingQueries() {
+  SearchServer search_server("and with"s);
+  int id = 0;
+  for (const string &text : {
+           "funny pet and nasty rat"s,
+           "funny pet with curly hair"s,
+           "funny pet and not very nasty rat"s,
+           "pet with rat and rat and rat"s,
+           "nasty rat with curly hair"s,
+       }) {
+    search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, {1, 2});
+  }
+  const vector<string> queries = {"nasty rat -not"s, "parrot"s,
+                                  "not very funny nasty pet"s, "cat"s,
+                                  "curly hair"s};
+  const auto expected = ProcessQueries(search_server, queries);
+
+  const auto joined = ProcessQueriesJoined(search_server, queries);
+  vector<int> expected_ids;
+  for (const auto &documents : expected) {
+    for (const auto &document : documents) {
+      expected_ids.push_back(document.id);
+    }
+  }
+  vector<int> joined_ids;
+  for (const Document &document : joined) {
+    joined_ids.push_back(document.id);
+  }
+  ASSERT_EQUAL(expected_ids, joined_ids);
+  ASSERT_EQUAL(expected_ids.size(), joined.size());
+  ASSERT_EQUAL(static_cast<ptrdiff_t>(joined.size()),
+               distance(joined.begin(), joined.end()));
+  ASSERT(ProcessQueriesJoined(search_server, {"cat"s}).empty());
+  ASSERT(ProcessQueriesJoined(search_server, {}).begin() ==
+         ProcessQueriesJoined(search_server, {}).end());
+
+  vector<vector<Document>> streamed(queries.size());
+  size_t calls = 0;
+  ProcessQueriesStreaming(search_server, queries,
+                          [&](size_t query_index, vector<Document> &&documents) {
+                            ++calls;
+                            streamed[query_index] = move(documents);
+                          });
+  ASSERT_EQUAL(queries.size(), calls);
+  for (size_t i = 0; i < queries.size(); ++i) {
+    ASSERT_EQUAL(expected[i].size(), streamed[i].size());
+    for (size_t j = 0; j < expected[i].size(); ++j) {
+      ASSERT_EQUAL(expected[i][j].id, streamed[i][j].id);
+    }
+  }
+}
+
+void TestResultCache() {
+  SearchServer search_server("and"s);
+  search_server.AddDocument(1, "white cat and fashion collar"s,
+                            DocumentStatus::ACTUAL, {8, -3});
+  search_server.AddDocument(2, "fluffy cat fluffy tail"s,
+                            DocumentStatus::ACTUAL, {7, 2, 7});
+  search_server.AddDocument(3, "groomed dog expressive eyes"s,
+                            DocumentStatus::BANNED, {5, -12, 2, 1});
+  search_server.SetResultCacheCapacity(2);
+
+  const auto expected = search_server.FindTopDocuments("fluffy cat"s);
+  ASSERT_EQUAL(2u, expected.size());
+  // same normalized query
+  const auto cached = search_server.FindTopDocuments("cat fluffy cat"s);
+  ASSERT_EQUAL(expected.size(), cached.size());
+  ASSERT_EQUAL(expected[0].id, cached[0].id);
+  ASSERT_EQUAL(1u, search_server.GetResultCacheStats().hits);
+  ASSERT_EQUAL(1u, search_server.GetResultCacheStats().misses);
+
+  // the status is part of the key
+  ASSERT_EQUAL(1u, search_server
+                       .FindTopDocuments("dog cat"s, DocumentStatus::BANNED)
+                       .size());
+  ASSERT_EQUAL(2u, search_server.GetResultCacheStats().misses);
+  // a third key evicts the least recently used one
+  ASSERT_EQUAL(2u, search_server.FindTopDocuments("cat"s).size());
+  ASSERT_EQUAL(2u, search_server.FindTopDocuments("cat"s).size());
+  ASSERT_EQUAL(2u, search_server.GetResultCacheStats().hits);
+  ASSERT_EQUAL(1u, search_server.GetResultCacheStats().evictions);
+
+  // predicates bypass the cache, with or without state: a captureless one
+  // may still read state outside of itself
+  static int min_rating = 4;
+  const auto reads_global = [](int, DocumentStatus, int rating) {
+    return rating > min_rating;
+  };
+  ASSERT_EQUAL(1u, search_server.FindTopDocuments("cat"s, reads_global).size());
+  min_rating = 0;
+  ASSERT_EQUAL(2u, search_server.FindTopDocuments("cat"s, reads_global).size());
+  search_server.FindTopDocuments(
+      "cat"s, [threshold = 4](int, DocumentStatus, int rating) {
+        return rating > threshold;
+      });
+  ASSERT_EQUAL(3u, search_server.GetResultCacheStats().misses);
+  ASSERT_EQUAL(2u, search_server.GetResultCacheStats().hits);
+
+  // a new document invalidates the cached results
+  const uint64_t generation = search_server.GetGeneration();
+  search_server.AddDocument(4, "cat"s, DocumentStatus::ACTUAL, {9});
+  ASSERT(generation < search_server.GetGeneration());
+  ASSERT_EQUAL(3u, search_server.FindTopDocuments("cat"s).size());
+  ASSERT_EQUAL(2u, search_server.GetResultCacheStats().invalidations);
+  search_server.RemoveDocument(4);
+  ASSERT_EQUAL(2u, search_server
+                       .FindTopDocuments(execution::par, "cat"s,
+                                         DocumentStatus::ACTUAL)
+                       .size());
+  ASSERT_EQUAL(2u, search_server.GetResultCacheStats().hits);
+}
+
+void TestBatchQueries() {
+  mt19937 generator;
+  const auto dictionary = GenerateDictionary(generator, 200, 6);
+  const auto documents = GenerateQueries(generator, dictionary, 3'000, 20);
+
+  SearchServer search_server(dictionary[0]);
+  for (size_t i = 0; i < documents.size(); ++i) {
+    const DocumentStatus status =
+        i % 5 == 0 ? DocumentStatus::IRRELEVANT : DocumentStatus::ACTUAL;
+    search_server.AddDocument(i, documents[i], status, {static_cast<int>(i)});
+  }
+  // every query twice, once with its words reordered
+  vector<string> queries;
+  for (const auto &query : GenerateQueries(generator, dictionary, 40, 4)) {
+    auto words = SplitIntoWords(query);
+    queries.push_back(query + " -"s + dictionary[queries.size()]);
+    reverse(words.begin(), words.end());
+    string reordered = "-"s + dictionary[queries.size() - 1];
+    for (const auto word : words) {
+      reordered += " "s + string(word);
+    }
+    queries.push_back(reordered);
+  }
+  queries.push_back(dictionary[0]);
+
+  const auto results = ProcessQueries(search_server, queries);
+  ASSERT_EQUAL(queries.size(), results.size());
+  for (size_t i = 0; i < queries.size(); ++i) {
+    const auto expected = search_server.FindTopDocuments(queries[i]);
+    ASSERT_EQUAL(expected.size(), results[i].size());
+    for (size_t j = 0; j < expected.size(); ++j) {
+      ASSERT_EQUAL(expected[j].id, results[i][j].id);
+      ASSERT_EQUAL(expected[j].relevance, results[i][j].relevance);
+    }
+  }
+  ASSERT(results.back().empty());
+
+  // more distinct queries than the accumulators of one group hold
+  const auto many_queries = GenerateQueries(generator, dictionary, 10'000, 4);
+  ASSERT(set<string>(many_queries.begin(), many_queries.end()).size() >
+         RelevanceAccumulator::MAX_POOLED_QUERIES);
+  const auto many_results = search_server.FindTopDocumentsBatch(many_queries);
+  for (size_t i = 0; i < many_queries.size(); ++i) {
+    const auto expected = search_server.FindTopDocuments(many_queries[i]);
+    ASSERT_EQUAL(expected.size(), many_results[i].size());
+    for (size_t j = 0; j < expected.size(); ++j) {
+      ASSERT_EQUAL(expected[j].id, many_results[i][j].id);
+      ASSERT_EQUAL(expected[j].relevance, many_results[i][j].relevance);
+    }
+  }
+
+  // sums over more documents than are pooled start clean
+  const size_t slot_count = RelevanceAccumulator::MAX_POOLED_SLOTS * 2;
+  const auto make_document = [](size_t document, double relevance) {
+    return Document(static_cast<int>(document), relevance, 0);
+  };
+  {
+    RelevanceAccumulator relevances(slot_count);
+    relevances.Add(0, slot_count - 1, 1.0);
+    relevances.Add(0, 5, 2.0);
+  }
+  RelevanceAccumulator relevances(slot_count);
+  relevances.Add(0, slot_count - 1, 0.5);
+  const auto found_docs = relevances.TakeDocuments(0, make_document);
+  ASSERT_EQUAL(1u, found_docs.size());
+  ASSERT_EQUAL(static_cast<int>(slot_count - 1), found_docs[0].id);
+  ASSERT_EQUAL(0.5, found_docs[0].relevance);
+}
+
+void TestConcurrentMap() {
+  ConcurrentMap<string, int> word_counts(7);
+  const vector<string> words = {"cat"s, "dog"s, "parrot"s, "hamster"s};
+  vector<thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 10'000; ++i) {
+        word_counts[words[i % words.size()]].ref_to_value += 1;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQUAL(words.size(), word_counts.size());
+  ASSERT_EQUAL(10'000, word_counts.Find("cat"s).value_or(0));
+  ASSERT(!word_counts.Find("fish"s));
+
+  // enough keys per bucket to force rehashing and long probe chains
+  ConcurrentMap<int, int, hash<int>, equal_to<int>, SpinLock> squares(3);
+  for (int i = 0; i < 1'000; ++i) {
+    squares[i].ref_to_value = i * i;
+  }
+  for (int i = 0; i < 1'000; i += 2) {
+    ASSERT(squares.Erase(i));
+  }
+  ASSERT(!squares.Erase(0));
+  ASSERT_EQUAL(500u, squares.size());
+  for (int i = 0; i < 1'000; ++i) {
+    ASSERT_EQUAL(i % 2 == 1, squares.Find(i) == optional<int>(i * i));
+  }
+
+  const auto ordinary = squares.BuildOrdinaryMap(execution::par);
+  ASSERT_EQUAL(500u, ordinary.size());
+  ASSERT_EQUAL(1, ordinary.begin()->first);
+  ASSERT_EQUAL(999 * 999, ordinary.rbegin()->second);
+  ASSERT_EQUAL(500u, squares.BuildSnapshot(execution::par).size());
+
+  ConcurrentMap<int, int, hash<int>, equal_to<int>, SpinLock> extra(5);
+  extra[1].ref_to_value = 10;
+  extra[2].ref_to_value = 20;
+  squares.Merge(execution::par, extra,
+                [](int &target, int source) { target += source; });
+  ASSERT_EQUAL(11, squares.Find(1).value_or(0));
+  ASSERT_EQUAL(20, squares.Find(2).value_or(0));
+  ASSERT_EQUAL(501u, squares.size());
+}
+
+void TestShardedSearchServer() {
+  mt19937 generator;
+  const auto dictionary = GenerateDictionary(generator, 300, 6);
+  const auto documents = GenerateQueries(generator, dictionary, 2'000, 20);
+
+  SearchServer server(dictionary[0]);
+  ShardedSearchServer sharded_server(4, dictionary[0]);
+  ASSERT_EQUAL(4u, sharded_server.GetShardCount());
+  for (size_t i = 0; i < documents.size(); ++i) {
+    const DocumentStatus status =
+        i % 7 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+    server.AddDocument(i, documents[i], status, {static_cast<int>(i)});
+    sharded_server.AddDocument(i, documents[i], status, {static_cast<int>(i)});
+  }
+  for (int id = 0; id < 2'000; id += 13) {
+    server.RemoveDocument(id);
+    sharded_server.RemoveDocument(id);
+  }
+  ASSERT_EQUAL(server.GetDocumentCount(), sharded_server.GetDocumentCount());
+
+  const auto queries = GenerateQueries(generator, dictionary, 50, 5);
+  for (size_t i = 0; i < queries.size(); ++i) {
+    const string query =
+        queries[i] + (i % 4 == 0 ? " -"s + dictionary[i] : ""s);
+    const auto expected =
+        server.FindTopDocuments(query, DocumentStatus::ACTUAL, 20);
+    const auto found_docs =
+        sharded_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 20);
+    ASSERT_EQUAL(expected.size(), found_docs.size());
+    for (size_t j = 0; j < expected.size(); ++j) {
+      ASSERT_EQUAL(expected[j].id, found_docs[j].id);
+      ASSERT(fabs(expected[j].relevance - found_docs[j].relevance) < 1e-9);
+    }
+  }
+
+  const auto [words, status] = sharded_server.MatchDocument(documents[7], 7);
+  const auto expected_words = get<0>(server.MatchDocument(documents[7], 7));
+  ASSERT_EQUAL(vector<string>(expected_words.begin(), expected_words.end()),
+               words);
+  ASSERT_EQUAL(DocumentStatus::BANNED, status);
+  try {
+    sharded_server.AddDocument(1, "duplicate"s, DocumentStatus::ACTUAL, {});
+    ASSERT_HINT(false, "This should never happen");
+  } catch (const invalid_argument &) {
+  }
+
+  // matched words outlive the removal of the only document holding them
+  ShardedSearchServer matching(2, ""s);
+  matching.AddDocument(1, "unique words here"s, DocumentStatus::ACTUAL, {});
+  const auto [unique_words, unique_status] =
+      matching.MatchDocument("unique here"s, 1);
+  thread([&matching] { matching.RemoveDocument(1); }).join();
+  ASSERT_EQUAL(0, matching.GetDocumentCount());
+  ASSERT_EQUAL((vector<string>{"here"s, "unique"s}), unique_words);
+  ASSERT_EQUAL(DocumentStatus::ACTUAL, unique_status);
+}
+
 void TestAverageValueOfRaiting() {
   {
     SearchServer server(""s);
@@ -547,6 +1846,26 @@ void TestCalculateRelevance() {
   ASSERT(fabs(found_docs[0].relevance - log(2.0 / 1.0) * 9.0 / 14.0) < 1e-6);
 }
 
+void TestRelevanceFollowsDocumentCount() {
+  SearchServer server(""s);
+  server.AddDocument(1, "cat city"s, DocumentStatus::ACTUAL, {1});
+  server.AddDocument(2, "dog city"s, DocumentStatus::ACTUAL, {1});
+  auto found_docs = server.FindTopDocuments("cat"s);
+  ASSERT_EQUAL(1u, found_docs.size());
+  ASSERT(fabs(found_docs[0].relevance - log(2.0) / 2.0) < 1e-6);
+
+  server.AddDocument(3, "dog village"s, DocumentStatus::ACTUAL, {1});
+  server.AddDocument(4, "cat village"s, DocumentStatus::ACTUAL, {1});
+  found_docs = server.FindTopDocuments(execution::par, "cat"s);
+  ASSERT_EQUAL(2u, found_docs.size());
+  ASSERT(fabs(found_docs[0].relevance - log(2.0) / 2.0) < 1e-6);
+
+  server.RemoveDocument(4);
+  found_docs = server.FindTopDocuments("cat"s);
+  ASSERT_EQUAL(1u, found_docs.size());
+  ASSERT(fabs(found_docs[0].relevance - log(3.0) / 2.0) < 1e-6);
+}
+
 void TestFilterByPredicate() {
   SearchServer server(""s);
   ASSERT(server
@@ -1031,31 +2350,125 @@ void TestExceptions() {
   }
 } 
 
-void TestFindPerformance() {
-  mt19937 generator;
+void TestCompressedPostings() {
+  InvertedIndex::PostingList postings;
+  int ordinal = 0;
+  for (int i = 0; i < 300; ++i) {
+    // mix of 1, 2 and 4 byte deltas
+    ordinal += i < 130 ? 1 + i % 3 : i < 260 ? 300 + i : 70'000 + i;
+    postings.push_back({ordinal, 1.0 / (1 + i % 17)});
+  }
+  const CompressedPostingList compressed(postings);
+  ASSERT_EQUAL(postings.size(), compressed.size());
+  ASSERT(compressed.GetByteSize() < postings.size() * sizeof(Posting) / 2);
+  const CompressedPostingView view = compressed.GetView();
+  ASSERT_EQUAL(3u, view.GetBlockCount());
+  ASSERT_EQUAL(postings[127].ordinal, view.GetBlockLastOrdinal(0));
+  ASSERT(view.IsWellFormed(postings.back().ordinal + 1));
+  ASSERT(!view.IsWellFormed(postings.back().ordinal));
+
+  // term frequencies survive exactly
+  const auto decoded = view.Decode();
+  ASSERT_EQUAL(postings.size(), decoded.size());
+  for (size_t i = 0; i < postings.size(); ++i) {
+    ASSERT_EQUAL(postings[i].ordinal, decoded[i].ordinal);
+    ASSERT_EQUAL(postings[i].term_freq, decoded[i].term_freq);
+    ASSERT(view.Contains(postings[i].ordinal));
+  }
+  ASSERT(!view.Contains(postings[0].ordinal + 1));
+  ASSERT(!view.Contains(postings.back().ordinal + 1));
+  ASSERT(CompressedPostingList(InvertedIndex::PostingList()).empty());
+}
 
-  const auto dictionary = GenerateDictionary(generator, 1000, 10);
-  const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
+vector<string_view> SplitIntoWordsByBytes(string_view text,
+                                          size_t &first_invalid) {
+  vector<string_view> words;
+  first_invalid = string_view::npos;
+  size_t begin = 0;
+  for (size_t i = 0; i <= text.size(); ++i) {
+    if (i == text.size() || text[i] == ' ') {
+      if (i > begin) {
+        const string_view word = text.substr(begin, i - begin);
+        if (first_invalid == string_view::npos &&
+            any_of(word.begin(), word.end(), [](char c) {
+              return static_cast<unsigned char>(c) < ' ';
+            })) {
+          first_invalid = words.size();
+        }
+        words.push_back(word);
+      }
+      begin = i + 1;
+    }
+  }
+  if (first_invalid == string_view::npos) {
+    first_invalid = words.size();
+  }
+  return words;
+}
 
-  SearchServer search_server(dictionary[0]);
-  for (size_t i = 0; i < documents.size(); ++i) {
-    search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL,
-                              {1, 2, 3});
+void TestTokenizer() {
+  mt19937 generator;
+  const string alphabet = "ab \x01\x1f\xd0\xb1-"s;
+  uniform_int_distribution<size_t> letter(0, alphabet.size() - 1);
+  for (int round = 0; round < 2'000; ++round) {
+    // lengths around the block boundaries, mostly without control bytes
+    string text(round % 200, ' ');
+    for (char &c : text) {
+      c = alphabet[letter(generator) % (round % 3 == 0 ? alphabet.size() : 3)];
+    }
+    size_t expected_invalid;
+    const auto expected = SplitIntoWordsByBytes(text, expected_invalid);
+    vector<string_view> words = {"kept"sv};
+    const size_t first_invalid = TokenizeWords(text, words);
+    ASSERT_EQUAL(expected.size() + 1, words.size());
+    ASSERT(equal(expected.begin(), expected.end(), words.begin() + 1));
+    ASSERT_EQUAL(expected_invalid + 1, first_invalid);
   }
+  ASSERT(SplitIntoWords(""s).empty());
+  ASSERT(SplitIntoWords("   "s).empty());
+  ASSERT_EQUAL(SplitIntoWords(" cat  dog "s), vector<string_view>({"cat"sv, "dog"sv}));
+}
 
-  const auto queries = GenerateQueries(generator, dictionary, 100, 70);
-  {
-    LOG_DURATION("|");
-    TEST_POLICY(seq); 
+void TestStopWordSet() {
+  mt19937 generator;
+  for (const int word_count : {0, 1, 2, 7, 100, 1'000}) {
+    const auto dictionary = GenerateDictionary(generator, word_count * 2, 8);
+    const set<string, less<>> words(dictionary.begin(),
+                                    dictionary.begin() + dictionary.size() / 2);
+    const StopWordSet stop_words(words);
+    ASSERT_EQUAL(words.size(), stop_words.size());
+    for (const auto &word : dictionary) {
+      ASSERT_EQUAL(words.count(word) > 0, stop_words.Contains(word));
+    }
+    ASSERT(!stop_words.Contains(""s));
   }
-  {
-    LOG_DURATION("||");
-    TEST_POLICY(par);
+
+  static constexpr FrozenStopWordSet<4> FROZEN({"and"sv, "in"sv, "on"sv, "with"sv});
+  static_assert(FROZEN.Contains("in"sv));
+  static_assert(!FROZEN.Contains("an"sv));
+  const StopWordSet adopted(FROZEN);
+  ASSERT(adopted.Contains("with"s));
+  ASSERT(!adopted.Contains("within"s));
+
+  SearchServer frozen_server(FROZEN);
+  SearchServer text_server("and in on with"s);
+  for (auto *server : {&frozen_server, &text_server}) {
+    server->AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1});
+    server->AddDocument(2, "dog with a cat"s, DocumentStatus::ACTUAL, {2});
+  }
+  ASSERT(frozen_server.FindTopDocuments("in with"s).empty());
+  ASSERT_EQUAL(frozen_server.GetWordFrequencies(2),
+               text_server.GetWordFrequencies(2));
+
+  // in a constant expression this is a compile error
+  try {
+    FrozenStopWordSet<2>({"a"sv, "a"sv});
+    ASSERT_HINT(false, "This should never happen");
+  } catch (const invalid_argument &) {
   }
 }
 
 void TestSearchServer() {
-  TestFindPerformance();
   //RUN_TEST(TestProcessQueries);
   //RUN_TEST(TestParallelMatching);
   //RUN_TEST(TestPFromTask);
@@ -1070,15 +2483,41 @@ void TestSearchServer() {
   RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent);
   RUN_TEST(TestAddDocumentContent);
   RUN_TEST(TestMinusWords);
+  RUN_TEST(TestMinusWordsP);
+  RUN_TEST(TestDenseMinusWords);
   RUN_TEST(TestMatchingDocuments);
   RUN_TEST(TestMatchingDocumentsP);
   RUN_TEST(TestRelevanceSort);
+  RUN_TEST(TestTopDocumentsCount);
+  RUN_TEST(TestMaxScoreRetrieval);
+  RUN_TEST(TestShardedSearchServer);
+  RUN_TEST(TestParallelMatchesSequential);
+  RUN_TEST(TestConcurrentMap);
+  RUN_TEST(TestBatchQueries);
+  RUN_TEST(TestResultCache);
+  RUN_TEST(TestJoinedAndStreamingQueries);
+  RUN_TEST(TestAddDocuments);
+  RUN_TEST(TestRemoveDocuments);
+  RUN_TEST(TestSnapshot);
+  RUN_TEST(TestMappedSearchServer);
+  RUN_TEST(TestMutationLog);
+  RUN_TEST(TestConcurrentSearchServer);
+  RUN_TEST(TestCorpusLoader);
+  RUN_TEST(TestBenchmarkSuite);
+  RUN_TEST(TestLatencyHistograms);
   RUN_TEST(TestAverageValueOfRaiting);
   RUN_TEST(TestSearchingOfDocumentsByStatus);
   RUN_TEST(TestCalculateRelevance);
+  RUN_TEST(TestRelevanceFollowsDocumentCount);
   RUN_TEST(TestFilterByPredicate);
   RUN_TEST(TestParallel);
   RUN_TEST(TestParallel1);
   RUN_TEST(TestRemoveDocument);
+  RUN_TEST(TestRemoveDocumentKeepsSharedWords);
+  RUN_TEST(TestRejectedDocumentIsNotIndexed);
   RUN_TEST(TestMatchDocs1);
+  RUN_TEST(TestCompressedPostings);
+  RUN_TEST(TestTokenizer);
+  RUN_TEST(TestNestedQueries);
+  RUN_TEST(TestStopWordSet);
 }
\ No newline at end of file
@@ -4,19 +4,39 @@
 #include <cmath>
 #include <iostream>
 #include <map>
+#include <numeric>
 #include <set>
+#include <thread>
 #include <string>
 #include <type_traits>
 #include <utility>
 #include <vector>
 #include <sstream>
 #include <random>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <array>
+#include <iterator>
 
 #include "search_server.h"
 //#include "remove_duplicates.h"
 #include "string_processing.h"
 #include "log_duration.h"
 #include "process_queries.h"
+#include "compressed_postings.h"
+#include "sharded_search_server.h"
+#include "concurrent_map.h"
+#include "mapped_search_server.h"
+#include "mutation_log.h"
+#include "concurrent_search_server.h"
+#include "tokenizer.h"
+#include "stop_word_set.h"
+#include "corpus_loader.h"
+#include "benchmark_suite.h"
+#include "relevance_accumulator.h"
+#include "text_generator.h"
 
 
 template <typename T, typename U>
@@ -126,6 +146,8 @@ void TestExcludeStopWordsFromAddedDocumentContent();
 void TestAddDocumentContent();
 
 void TestMinusWords();
+void TestMinusWordsP();
+void TestDenseMinusWords();
 
 void TestAverageValueOfRaitingP();
 
@@ -135,9 +157,34 @@ void TestMatchingDocuments();
 
 void TestRelevanceSort();
 void TestRelevanceSortP();
+void TestTopDocumentsCount();
+void TestMaxScoreRetrieval();
+void TestShardedSearchServer();
+void TestParallelMatchesSequential();
+void TestConcurrentMap();
+void TestBatchQueries();
+void TestResultCache();
+void TestJoinedAndStreamingQueries();
+void TestAddDocuments();
+void TestRemoveDocuments();
+void TestSnapshot();
+void TestMappedSearchServer();
+void TestMutationLog();
+void TestConcurrentSearchServer();
+void TestCorpusLoader();
+void TestBenchmarkSuite();
+void TestLatencyHistograms();
 
 void TestRemoveDocument();
-void TestFindPerformance();
+void TestRemoveDocumentKeepsSharedWords();
+void TestRejectedDocumentIsNotIndexed();
+void TestCompressedPostings();
+void TestTokenizer();
+// Byte-at-a-time reference for the tokenizer.
+std::vector<std::string_view> SplitIntoWordsByBytes(std::string_view text,
+                                                    size_t &first_invalid);
+void TestNestedQueries();
+void TestStopWordSet();
 
 template <class T> double average(const T &doc3) {
   int s = 0;
@@ -148,11 +195,6 @@ template <class T> double average(const T &doc3) {
   return s;
 }
 
-std::string GenerateWord(std::mt19937 &generator, int max_length);
-std::vector<std::string> GenerateDictionary(std::mt19937 &generator, int word_count, int max_length);
-std::string GenerateQuery(std::mt19937 &generator,const std::vector<std::string> &dictionary, int max_word_count);
-std::vector<std::string> GenerateQueries(std::mt19937 &generator,const std::vector<std::string> &dictionary, int query_count, int max_word_count);
-
 template <typename QueriesProcessor>
 void Test(std::string_view mark, QueriesProcessor processor,
           const SearchServer &search_server, const std::vector<std::string> &queries) {
@@ -164,6 +206,7 @@ void TestAverageValueOfRaiting();
 void TestSearchingOfDocumentsByStatus();
 
 void TestCalculateRelevance();
+void TestRelevanceFollowsDocumentCount();
 
 //void TestRemoveDocument();
 void PrintDocument(const Document &document);
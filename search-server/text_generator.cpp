@@ -0,0 +1,54 @@
+#include "text_generator.h"
+
+#include <algorithm>
+
+using namespace std;
+
+string GenerateWord(mt19937 &generator, int max_length) {
+  const int length = max_length;
+  uniform_int_distribution(1, max_length)(generator);
+  string word;
+  word.reserve(length);
+  for (int i = 0; i < length; ++i) {
+    word.push_back(uniform_int_distribution(static_cast<int>('a'),
+                                            static_cast<int> ('z'))(generator));
+  }
+  return word;
+}
+
+vector<string> GenerateDictionary(mt19937 &generator, int word_count,
+                                  int max_length) {
+  vector<string> words;
+  words.reserve(word_count);
+  for (int i = 0; i < word_count; ++i) {
+    words.push_back(GenerateWord(generator, max_length));
+  }
+  sort(words.begin(), words.end());
+  words.erase(unique(words.begin(), words.end()), words.end());
+  return words;
+}
+
+string GenerateQuery(mt19937 &generator, const vector<string> &dictionary,
+                     int max_word_count) {
+  const int word_count = uniform_int_distribution(1, max_word_count)(generator);
+  string query;
+  for (int i = 0; i < word_count; ++i) {
+    if (!query.empty()) {
+      query.push_back(' ');
+    }
+    query += dictionary[uniform_int_distribution<int>(0, static_cast<int>(dictionary.size() -
+                                                            1))(generator)];
+  }
+  return query;
+}
+
+vector<string> GenerateQueries(mt19937 &generator,
+                               const vector<string> &dictionary,
+                               int query_count, int max_word_count) {
+  vector<string> queries;
+  queries.reserve(query_count);
+  for (int i = 0; i < query_count; ++i) {
+    queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
+  }
+  return queries;
+}
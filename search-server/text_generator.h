@@ -0,0 +1,20 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+// Random text for tests and benchmarks: words of lowercase latin letters,
+// and queries or documents of words drawn from a dictionary.
+std::string GenerateWord(std::mt19937 &generator, int max_length);
+// Sorted and without repeats, so it may hold fewer than word_count words.
+std::vector<std::string> GenerateDictionary(std::mt19937 &generator,
+                                            int word_count, int max_length);
+// 1 to max_word_count words separated by spaces.
+std::string GenerateQuery(std::mt19937 &generator,
+                          const std::vector<std::string> &dictionary,
+                          int max_word_count);
+std::vector<std::string>
+GenerateQueries(std::mt19937 &generator,
+                const std::vector<std::string> &dictionary, int query_count,
+                int max_word_count);
@@ -0,0 +1,177 @@
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "cpu_features.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||           \
+    defined(_M_IX86)
+#define TOKENIZER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TOKENIZER_TARGET(x) __attribute__((target(x)))
+#else
+#define TOKENIZER_TARGET(x)
+#endif
+
+using namespace std;
+
+namespace {
+
+constexpr size_t BLOCK_SIZE = 64;
+
+// Bit i describes byte i of a block.
+struct BlockMasks {
+  uint64_t spaces;
+  uint64_t controls;
+};
+
+using ClassifyBlockFunction = BlockMasks (*)(const char *block);
+
+BlockMasks ClassifyBytes(const char *bytes, size_t count) {
+  BlockMasks masks{0, 0};
+  for (size_t i = 0; i < count; ++i) {
+    const auto c = static_cast<unsigned char>(bytes[i]);
+    masks.spaces |= uint64_t{c == ' '} << i;
+    masks.controls |= uint64_t{c < ' '} << i;
+  }
+  return masks;
+}
+
+BlockMasks ClassifyBlockScalar(const char *block) {
+  return ClassifyBytes(block, BLOCK_SIZE);
+}
+
+#ifdef TOKENIZER_X86
+
+TOKENIZER_TARGET("sse2")
+BlockMasks ClassifyBlockSse2(const char *block) {
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i last_control = _mm_set1_epi8(' ' - 1);
+  BlockMasks masks{0, 0};
+  for (size_t i = 0; i < BLOCK_SIZE; i += 16) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + i));
+    // Unsigned byte <= 31 is min(byte, 31) == byte.
+    const __m128i controls =
+        _mm_cmpeq_epi8(_mm_min_epu8(bytes, last_control), bytes);
+    masks.spaces |= static_cast<uint64_t>(static_cast<uint16_t>(
+                        _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, space))))
+                    << i;
+    masks.controls |=
+        static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(controls)))
+        << i;
+  }
+  return masks;
+}
+
+TOKENIZER_TARGET("avx2")
+BlockMasks ClassifyBlockAvx2(const char *block) {
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i last_control = _mm256_set1_epi8(' ' - 1);
+  BlockMasks masks{0, 0};
+  for (size_t i = 0; i < BLOCK_SIZE; i += 32) {
+    const __m256i bytes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + i));
+    const __m256i controls =
+        _mm256_cmpeq_epi8(_mm256_min_epu8(bytes, last_control), bytes);
+    masks.spaces |= static_cast<uint64_t>(static_cast<uint32_t>(
+                        _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, space))))
+                    << i;
+    masks.controls |= static_cast<uint64_t>(
+                          static_cast<uint32_t>(_mm256_movemask_epi8(controls)))
+                      << i;
+  }
+  return masks;
+}
+
+#endif
+
+struct Classifier {
+  ClassifyBlockFunction classify;
+  const char *name;
+};
+
+Classifier SelectClassifier() {
+#ifdef TOKENIZER_X86
+  const CpuFeatures &features = GetCpuFeatures();
+  if (features.avx2) {
+    return {ClassifyBlockAvx2, "avx2"};
+  }
+  if (features.sse2) {
+    return {ClassifyBlockSse2, "sse2"};
+  }
+#endif
+  return {ClassifyBlockScalar, "scalar"};
+}
+
+const Classifier &GetClassifier() {
+  static const Classifier classifier = SelectClassifier();
+  return classifier;
+}
+
+int CountTrailingZeros(uint64_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, mask);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(mask);
+#endif
+}
+
+} // namespace
+
+size_t TokenizeWords(string_view text, vector<string_view> &words) {
+  const ClassifyBlockFunction classify = GetClassifier().classify;
+  size_t first_invalid = string_view::npos;
+  size_t first_control = string_view::npos;
+  size_t word_begin = 0;
+  bool in_word = false;
+  for (size_t base = 0; base < text.size(); base += BLOCK_SIZE) {
+    const size_t count = min(BLOCK_SIZE, text.size() - base);
+    BlockMasks masks = count == BLOCK_SIZE
+                           ? classify(text.data() + base)
+                           : ClassifyBytes(text.data() + base, count);
+    if (count < BLOCK_SIZE) {
+      // Past the end reads as spaces, which closes the last word.
+      masks.spaces |= ~uint64_t{0} << count;
+    }
+    if (first_control == string_view::npos && masks.controls != 0) {
+      first_control = base + CountTrailingZeros(masks.controls);
+    }
+    // Set bits mark the bytes where a word starts or ends.
+    const uint64_t word_bytes = ~masks.spaces;
+    uint64_t edges = word_bytes ^ (word_bytes << 1 | uint64_t{in_word});
+    for (; edges != 0; edges &= edges - 1) {
+      const size_t position = base + CountTrailingZeros(edges);
+      if (!in_word) {
+        word_begin = position;
+      } else {
+        // A control character is never a space, so the first one lies in
+        // the first word that ends after it.
+        if (first_invalid == string_view::npos && first_control < position) {
+          first_invalid = words.size();
+        }
+        words.push_back(text.substr(word_begin, position - word_begin));
+      }
+      in_word = !in_word;
+    }
+  }
+  if (in_word) {
+    if (first_invalid == string_view::npos &&
+        first_control != string_view::npos) {
+      first_invalid = words.size();
+    }
+    words.push_back(text.substr(word_begin));
+  }
+  return first_invalid == string_view::npos ? words.size() : first_invalid;
+}
+
+const char *GetTokenizerName() { return GetClassifier().name; }
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+// Appends the space-separated words of text to words and checks them for
+// control characters (bytes 0 to 31) in the same pass. Returns the index in
+// words of the first appended word that holds a control character, or
+// words.size() if none does. Blocks of 64 bytes are classified with SIMD
+// compares where the CPU supports them.
+size_t TokenizeWords(std::string_view text, std::vector<std::string_view> &words);
+
+// Name of the classification kernel picked for this CPU: "avx2", "sse2" or
+// "scalar".
+const char *GetTokenizerName();